@@ -1,6 +1,38 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+
+#define CHIP8_DISPLAY_WIDTH 64
+#define CHIP8_DISPLAY_HEIGHT 32
+
+// the SUPER-CHIP / XO-CHIP high resolution mode, and the XO-CHIP bitplanes
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_DISPLAY_PLANES 2
+#define CHIP8_DISPLAY_WORDS (CHIP8_HIRES_WIDTH / 64)
+
+// how many instructions are run per 60hz frame
+#define CHIP8_INSTRUCTIONS_PER_FRAME 11
+
+// how opcodes that differ between chip8 implementations behave, each profile runs on its own copy of the interpreter
+typedef enum Chip8Quirks {
+    CHIP8_QUIRKS_DEFAULT, // 8xy6/8xyE shift Vx, Fx55/Fx65 leave I alone, Bnnn adds V0 and sprites wrap around the screen
+    CHIP8_QUIRKS_COSMAC,  // the original VIP interpreter: shifts of Vy, I moves past the registers, VF reset by 8xy1/2/3, clipping
+    CHIP8_QUIRKS_CHIP48,  // the HP-48 port: shifts of Vx, I moves to the last register, Bxnn adds Vx, clipping
+    CHIP8_QUIRKS_SCHIP,   // SUPER-CHIP 1.1: like CHIP-48 but I is left alone, adds hires, scrolling and 16x16 sprites
+    CHIP8_QUIRKS_XOCHIP,  // XO-CHIP: shifts of Vy, I moves past the registers, sprites wrap, adds the SUPER-CHIP and XO-CHIP opcodes
+    CHIP8_QUIRKS_COUNT,
+} Chip8Quirks;
+
+// the screen as packed rows, planes[p][y][0] holds pixels 0-63 of row y with the leftmost pixel in the
+// most significant bit and planes[p][y][1] holds pixels 64-127, in low resolution only the first 32 rows
+// and the first word are used so plain chip8 keeps its one word per row
+typedef struct Chip8Display {
+    uint64_t planes[CHIP8_DISPLAY_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_DISPLAY_WORDS];
+    uint8_t hires;
+    uint8_t unused[7]; // no padding, so displays can be compared with memcmp
+} Chip8Display;
 
 typedef struct Chip8 {
     uint8_t memory[4096];
@@ -17,12 +49,81 @@ typedef struct Chip8 {
     uint16_t stack[16];
     uint8_t stack_pointer;
 
-    uint8_t display[64 * 32];
+    Chip8Display display;
+
+    // bit y is set when display row y changed since chip8_display_take_dirty was last called,
+    // not part of the emulated state so it is left out of snapshots and comparisons
+    uint64_t display_dirty;
+
+    // XO-CHIP: the bitplanes 00E0, Dxyn and the scrolls work on (bit 0 for plane 0), 1 for everything else
+    uint8_t plane_mask;
+
+    // SUPER-CHIP: the RPL user flags Fx75 and Fx85 save registers to
+    uint8_t flags[16];
+
+    // XO-CHIP: the 128 bit pattern the sound timer plays and its pitch (Fx3A), 64 is 4000 bits per second
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
 
     uint8_t keypad[16];
+
+    // state of the random number generator used by Cxkk, every chip8 has its own so runs are reproducible
+    uint32_t random_state;
+
+    // a Chip8Quirks, picked before or when the rom is loaded and kept by chip8_load_rom, not part of snapshots
+    uint8_t quirks;
+
+    // optional profiler (see chip8_profile.h), NULL when not profiling
+    struct Chip8Profile* profile;
+
+#ifdef CHIP8_TRACE
+    // optional instruction trace (see chip8_trace.h), NULL when not tracing
+    struct Chip8Trace* trace;
+#endif
 } Chip8;
 
 Chip8 chip8_create();
-void chip8_load_rom(Chip8* chip8, const char* file);
+
+// copies the whole state (sizeof(Chip8), 6296 bytes on 64 bit hosts), random state and quirks included, the clone gets no profile or trace
+// so it can be run ahead and thrown away without the runs showing up in them
+void chip8_clone(Chip8* clone, const Chip8* chip8);
+
+// resets the chip8 (keeping its random state) and loads the rom at 0x200, returns -1 if it can not be read or is too big
+int chip8_load_rom(Chip8* chip8, const char* file);
+
+// the same for a program already in memory
+int chip8_load_program(Chip8* chip8, const uint8_t* program, size_t size);
+void chip8_seed(Chip8* chip8, uint64_t seed);
 void chip8_update(Chip8* chip8);
+
+// runs `instructions` instructions on the interpreter for the chip8's quirks
+void chip8_run(Chip8* chip8, uint64_t instructions);
 void chip8_update_timers(Chip8* chip8);
+
+// runs one frames worth of instructions and then updates the timers
+void chip8_run_frame(Chip8* chip8);
+
+// "default", "cosmac", "chip48", "schip" or "xochip", returns -1 for unknown names
+int chip8_quirks_parse(const char* name, Chip8Quirks* quirks);
+const char* chip8_quirks_name(Chip8Quirks quirks);
+
+// 64 bit FNV-1a hash of the display, used to compare runs without a screen,
+// a low resolution display with nothing on the second plane hashes the same as it always has
+uint64_t chip8_display_hash(const Chip8* chip8);
+
+// the size of the display in its current mode, 64x32 or 128x64
+int chip8_display_width(const Chip8Display* display);
+int chip8_display_height(const Chip8Display* display);
+
+// the RGB332 colour of every combination of the two planes, off, plane 0, plane 1 and both
+#define CHIP8_DISPLAY_PALETTE {0x00, 0xFF, 0xE0, 0xFC}
+
+// expands the packed display into one RGB332 byte per pixel (see CHIP8_DISPLAY_PALETTE),
+// `pixels` has to hold chip8_display_width * chip8_display_height bytes
+void chip8_display_unpack(const Chip8* chip8, uint8_t* pixels);
+
+// the same for `row_count` rows from `first_row` on, the other rows of `pixels` are left alone
+void chip8_display_unpack_rows(const Chip8* chip8, int first_row, int row_count, uint8_t* pixels);
+
+// gets the range of rows changed since the last call and marks them clean, returns 0 if nothing changed
+int chip8_display_take_dirty(Chip8* chip8, int* first_row, int* row_count);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * the beep, generated on the emulation thread and played on the audio thread
+ *
+ * the ring hands samples from one writer thread to one reader thread without locks,
+ * the writer drops what does not fit and the reader can throw away the oldest samples
+ * so what it plays never lags far behind what was written
+ *
+ * the tone plays a 128 bit pattern (the XO-CHIP audio buffer, a square wave for plain
+ * chip8) at a number of pattern bits per second, every bit lasts a run of samples which
+ * is filled with vector stores rather than working out the bit sample by sample
+*/
+
+typedef struct Chip8AudioRing Chip8AudioRing;
+
+// `capacity` is rounded up to a power of two
+Chip8AudioRing* chip8_audio_ring_create(uint32_t capacity);
+void chip8_audio_ring_destroy(Chip8AudioRing* ring);
+
+// writer side, returns how many samples fit
+uint32_t chip8_audio_ring_write(Chip8AudioRing* ring, const float* samples, uint32_t count);
+
+// reader side, returns how many samples there were
+uint32_t chip8_audio_ring_read(Chip8AudioRing* ring, float* samples, uint32_t count);
+
+// reader side, drops the oldest samples so at most `keep` are left
+void chip8_audio_ring_trim(Chip8AudioRing* ring, uint32_t keep);
+
+#define CHIP8_TONE_PATTERN_BITS 128
+
+// the pattern plain chip8 beeps with, and how fast XO-CHIP plays patterns at its default pitch
+#define CHIP8_TONE_DEFAULT_PATTERN {0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0}
+#define CHIP8_TONE_DEFAULT_RATE 4000
+#define CHIP8_TONE_DEFAULT_PITCH 64
+
+typedef struct Chip8Tone {
+    float levels[CHIP8_TONE_PATTERN_BITS]; // +volume for set bits and -volume for clear ones
+    float volume;
+
+    // the whole pattern is 2^32 of phase, so the top 7 bits are the bit playing
+    uint32_t phase;
+    uint32_t step;
+    uint32_t sample_rate;
+} Chip8Tone;
+
+// the default pattern and rate at `volume` (0 to 1)
+Chip8Tone chip8_tone_create(uint32_t sample_rate, float volume);
+
+// `pattern` is 16 bytes, played most significant bit first
+void chip8_tone_set_pattern(Chip8Tone* tone, const uint8_t* pattern);
+void chip8_tone_set_rate(Chip8Tone* tone, uint32_t bits_per_second);
+
+// the rate for an XO-CHIP pitch (Fx3A), every 48 steps above CHIP8_TONE_DEFAULT_PITCH double it
+void chip8_tone_set_pitch(Chip8Tone* tone, uint8_t pitch);
+
+// continues the tone where the last call left it
+void chip8_tone_generate(Chip8Tone* tone, float* samples, uint32_t count);
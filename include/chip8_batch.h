@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * runs CHIP8_BATCH_LANES chip8s side by side with their registers, program
+ * counters, address registers and timers stored as vectors (one lane per chip8)
+ *
+ * every step the lanes sharing the lowest program counter run that instruction
+ * together with vector operations, lanes which took a different branch wait until
+ * the others catch up, instructions which touch memory, the keypad or the screen
+ * of only some lanes run one lane at a time
+ *
+ * the results are exactly the same as stepping each chip8 with chip8_update,
+ * running the same rom with different seeds or inputs keeps the lanes together most of the time
+ *
+ * needs gcc or clang vector extensions, chip8_batch_create returns NULL everywhere else
+*/
+
+#define CHIP8_BATCH_LANES 16
+
+typedef struct Chip8BatchStats {
+    uint64_t vector_steps;        // instructions run for several lanes at once
+    uint64_t vector_instructions; // lane instructions run by those steps
+    uint64_t scalar_instructions; // lane instructions run one lane at a time
+} Chip8BatchStats;
+
+typedef struct Chip8Batch Chip8Batch;
+
+// every lane starts without a program loaded and is skipped until chip8_batch_set fills it
+Chip8Batch* chip8_batch_create();
+void chip8_batch_destroy(Chip8Batch* batch);
+
+// copies a chip8 into / out of a lane, the trace and profile pointers are not kept
+// and the lanes always run with CHIP8_QUIRKS_DEFAULT
+void chip8_batch_set(Chip8Batch* batch, uint32_t lane, const Chip8* chip8);
+void chip8_batch_get(const Chip8Batch* batch, uint32_t lane, Chip8* chip8);
+
+// the keypad of a lane, can be changed between runs
+uint8_t* chip8_batch_keypad(Chip8Batch* batch, uint32_t lane);
+
+// runs the given number of instructions on every loaded lane
+void chip8_batch_run(Chip8Batch* batch, uint64_t instructions);
+void chip8_batch_update_timers(Chip8Batch* batch);
+
+// same as chip8_run_frame on every lane
+void chip8_batch_run_frame(Chip8Batch* batch);
+
+// differential testing, runs the batch next to copies of every lane stepped
+// with chip8_update and compares them afterwards, returns -1 at the first difference
+int chip8_batch_verify(Chip8Batch* batch, uint64_t instructions);
+
+Chip8BatchStats chip8_batch_stats(const Chip8Batch* batch);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * an alternative execution engine which decodes each instruction once into a
+ * table indexed by address and then dispatches through it (with computed goto
+ * when the compiler supports it)
+ *
+ * entries are decoded the first time they run, Fx55 and Fx33 invalidate the
+ * entries they write over so self modifying roms keep working
+*/
+
+typedef struct Chip8DecodeCache Chip8DecodeCache;
+
+Chip8DecodeCache* chip8_decode_cache_create();
+void chip8_decode_cache_destroy(Chip8DecodeCache* cache);
+
+// has to be called whenever memory changes outside of chip8_decode_cache_run (e.g. after chip8_load_rom)
+void chip8_decode_cache_invalidate_all(Chip8DecodeCache* cache);
+
+// runs the given number of instructions, same as calling chip8_update that many times
+void chip8_decode_cache_run(Chip8DecodeCache* cache, Chip8* chip8, uint64_t instructions);
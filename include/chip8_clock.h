@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "chip8_engine.h"
+
+/*
+ * decides how many instructions every 60hz frame gets, the timers tick once a frame
+ * no matter how fast the frames themselves are run
+ *
+ * the fixed model runs `instructions_per_second` / 60 instructions a frame, carrying
+ * the remainder over so rates that do not divide evenly still average out
+ *
+ * the cosmac model charges every instruction roughly what it took the original
+ * interpreter on the COSMAC VIP (see chip8_instruction_cycles) against the machine
+ * cycles the VIP had per frame, so drawing heavy code runs slower the way it did there
+*/
+
+// the default rate, CHIP8_INSTRUCTIONS_PER_FRAME every frame
+#define CHIP8_DEFAULT_INSTRUCTIONS_PER_SECOND (CHIP8_INSTRUCTIONS_PER_FRAME * 60)
+
+typedef enum Chip8Timing {
+    CHIP8_TIMING_FIXED,
+    CHIP8_TIMING_COSMAC,
+} Chip8Timing;
+
+typedef struct Chip8Clock {
+    Chip8Timing timing;
+    uint32_t instructions_per_second; // only used by the fixed model
+
+    // what is left of the current frame, a new frame starts when it runs out
+    uint8_t in_frame;
+    uint64_t instructions_left;     // fixed model
+    int64_t cycles_left;            // cosmac model, an instruction that overruns the frame is paid back by the next
+    uint32_t remainder;             // fixed model, instructions_per_second % 60 carried between frames
+} Chip8Clock;
+
+// `instructions_per_second` of 0 picks CHIP8_DEFAULT_INSTRUCTIONS_PER_SECOND
+Chip8Clock chip8_clock_create(Chip8Timing timing, uint32_t instructions_per_second);
+
+// runs up to `max_instructions` of the current frame, ticking the timers if the frame ends,
+// returns the number of instructions run
+uint64_t chip8_clock_run(Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8, uint64_t max_instructions);
+
+// runs the rest of the current frame, returns the number of instructions run
+uint64_t chip8_clock_run_frame(Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8);
+
+// the approximate cost of an instruction on the COSMAC VIP in machine cycles (8 clocks of the 1.76 MHz 1802),
+// including the interpreter's fetch and decode
+uint32_t chip8_instruction_cycles(uint16_t instruction);
+
+// "fixed" or "cosmac", returns -1 for unknown names
+int chip8_timing_parse(const char* name, Chip8Timing* timing);
+const char* chip8_timing_name(Chip8Timing timing);
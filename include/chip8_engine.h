@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "chip8_cache.h"
+#include "chip8_jit.h"
+
+// the execution engines, selectable at runtime so they can be compared against each other,
+// chip8s with quirks other than CHIP8_QUIRKS_DEFAULT always run on the switch interpreter
+typedef enum Chip8EngineType {
+    CHIP8_ENGINE_SWITCH, // chip8_run, the reference interpreter
+    CHIP8_ENGINE_CACHED, // pre-decoded instructions with threaded dispatch (chip8_cache.h)
+    CHIP8_ENGINE_JIT,    // basic blocks recompiled to x86-64 (chip8_jit.h)
+} Chip8EngineType;
+
+typedef struct Chip8Engine {
+    Chip8EngineType type;
+    Chip8DecodeCache* cache;
+    Chip8Jit* jit;
+
+    // skip the rest of the budget when the program is spinning in a loop that can not change
+    // anything before the next timer tick or key press (on by default, the result is the same either way)
+    uint8_t skip_idle;
+    uint64_t idle_instructions; // instructions skipped so far
+} Chip8Engine;
+
+Chip8Engine* chip8_engine_create(Chip8EngineType type);
+void chip8_engine_destroy(Chip8Engine* engine);
+
+// has to be called whenever memory changes outside of the engine (e.g. after chip8_load_rom)
+void chip8_engine_reset(Chip8Engine* engine);
+
+// runs the given number of instructions, the keypad and timers are not expected to change until it returns
+void chip8_engine_run(Chip8Engine* engine, Chip8* chip8, uint64_t instructions);
+
+// same as chip8_run_frame
+void chip8_engine_run_frame(Chip8Engine* engine, Chip8* chip8);
+
+// "switch", "cached" or "jit", returns -1 for unknown names
+int chip8_engine_parse(const char* name, Chip8EngineType* type);
+const char* chip8_engine_name(Chip8EngineType type);
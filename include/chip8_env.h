@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+#include "chip8_clock.h"
+#include "chip8_engine.h"
+
+/*
+ * an api for embedding the core in agent training, in the style of gym's vector environments:
+ * many chip8s running the same program, reset and stepped together with one call each
+ *
+ * actions are keypad bitmasks, bit k set holds down chip8 key k (0x0 to 0xF), they are put on the
+ * keypads before the first frame of a step and held through all of its frames
+ *
+ * observations are the machines' own displays, handed out as pointers into the environment with
+ * nothing copied, they stay valid until the environment is destroyed and change with every step,
+ * each one is the packed 1 bpp planes of Chip8Display (plane 0 row y pixels 0-63 are one word,
+ * leftmost pixel in the top bit), and all of them are chip8_env_stride bytes apart so a single
+ * strided view covers the whole batch
+ *
+ * every machine has its own engine and clock, the environment is single threaded, run one per thread
+ * to use more cores
+*/
+
+typedef struct Chip8Env Chip8Env;
+
+// `count` machines started from copies of `initial` (a chip8 with its program and quirks loaded),
+// call chip8_env_reset before the first step
+Chip8Env* chip8_env_create(const Chip8* initial, uint32_t count, Chip8EngineType engine_type);
+void chip8_env_destroy(Chip8Env* env);
+
+uint32_t chip8_env_count(const Chip8Env* env);
+
+// the clock every machine runs its frames with, a fixed CHIP8_DEFAULT_INSTRUCTIONS_PER_SECOND unless set,
+// takes effect at the next reset
+void chip8_env_set_clock(Chip8Env* env, Chip8Timing timing, uint32_t instructions_per_second);
+
+// puts every machine back to `initial`, machine i seeded with seed + i and no keys held
+void chip8_env_reset(Chip8Env* env, uint64_t seed);
+
+// the same for a single machine, for episodes that end at different times
+void chip8_env_reset_one(Chip8Env* env, uint32_t index, uint64_t seed);
+
+// holds actions[i] on machine i and runs `frames` frames on every machine
+void chip8_env_step(Chip8Env* env, const uint16_t* actions, uint32_t frames);
+
+// the state of a machine, for rewards read from memory or registers
+const Chip8* chip8_env_machine(const Chip8Env* env, uint32_t index);
+const Chip8Display* chip8_env_display(const Chip8Env* env, uint32_t index);
+
+// bytes from one machine's display to the next one's
+size_t chip8_env_stride(const Chip8Env* env);
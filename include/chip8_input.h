@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "chip8_clock.h"
+#include "chip8_engine.h"
+#include "chip8_recording.h"
+
+/*
+ * key presses from the thread that gets them to the one running the chip8, put on the keypad at the
+ * instruction that matches when they happened instead of all at once when the next frame starts
+ *
+ * the queue hands timestamped key changes from one writer thread to one reader thread without locks,
+ * the writer drops changes that do not fit
+ *
+ * a frame stands for the time from the end of the previous one, a change that happened some share into
+ * that time is applied the same share into the frame's instructions (going by how many the last frame ran),
+ * so changes keep their order and spacing and one frame of latency, and a press and release that both
+ * happened during one frame still reach the rom, a press is held for at least a frame's instructions
+ * so even roms that only look at the keypad once a frame see the shortest taps
+*/
+
+typedef struct Chip8Input Chip8Input;
+
+// `capacity` is rounded up to a power of two
+Chip8Input* chip8_input_create(uint32_t capacity);
+void chip8_input_destroy(Chip8Input* input);
+
+// writer side, `time` is in nanoseconds on the clock the frames end by and `key` is a keypad index,
+// returns -1 if the queue is full and the change was dropped
+int chip8_input_push(Chip8Input* input, uint64_t time, uint8_t key, uint8_t down);
+
+// reader side, runs a frame with every change from before `frame_end` applied where it falls in the frame,
+// with a recording the changes are added to it at `recorded_instructions` plus the instructions into the frame,
+// returns the number of instructions run
+uint64_t chip8_input_run_frame(Chip8Input* input, Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8, uint64_t frame_end,
+                               Chip8Recording* recording, uint64_t recorded_instructions);
+
+// reader side, applies every change from before `time` at once and puts the keys held on the keypad,
+// for when no frame is run (e.g. while rewinding) or the keypad was replaced
+void chip8_input_apply(Chip8Input* input, Chip8* chip8, uint64_t time);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * a dynamic recompiler which translates basic blocks into x86-64 machine code
+ *
+ * blocks end at jumps, calls, returns, skips and the instructions which
+ * write memory (Fx33, Fx55), they are cached by start address and the whole
+ * cache is dropped when a write lands on translated code
+ *
+ * only available on x86-64 hosts using the System V calling convention,
+ * chip8_jit_create returns NULL everywhere else
+*/
+
+typedef struct Chip8Jit Chip8Jit;
+
+Chip8Jit* chip8_jit_create();
+void chip8_jit_destroy(Chip8Jit* jit);
+
+// has to be called whenever memory changes outside of the jit (e.g. after chip8_load_rom)
+void chip8_jit_invalidate_all(Chip8Jit* jit);
+
+// runs the given number of instructions, same as calling chip8_update that many times
+void chip8_jit_run(Chip8Jit* jit, Chip8* chip8, uint64_t instructions);
+
+// differential testing, runs the jit next to a copy of the chip8 stepped with chip8_update
+// and compares the whole state after every block, returns -1 at the first difference
+int chip8_jit_verify(Chip8Jit* jit, Chip8* chip8, uint64_t instructions);
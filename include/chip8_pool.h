@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "chip8_engine.h"
+
+/*
+ * runs many independent chip8s on a work stealing thread pool
+ *
+ * every instance is split into chunks of frames, each worker runs chunks
+ * from its own queue and steals from the others when it runs dry
+*/
+
+#define CHIP8_POOL_CACHE_LINE 64
+
+// aligned to a cache line so workers never share lines between instances
+typedef struct Chip8PoolInstance {
+    _Alignas(CHIP8_POOL_CACHE_LINE) Chip8 chip8;
+
+    // every instance has its own engine, the cached engine keeps one decode cache per instance
+    Chip8Engine* engine;
+
+    uint64_t frames_left;
+
+    // totals over every chip8_pool_run call
+    uint64_t instructions;
+    double seconds;
+} Chip8PoolInstance;
+
+typedef struct Chip8Pool Chip8Pool;
+
+// threads = 0 uses one thread per core, the jit engine is not supported (its code buffer is per instance)
+Chip8Pool* chip8_pool_create(uint32_t instance_count, uint32_t thread_count, Chip8EngineType engine_type);
+void chip8_pool_destroy(Chip8Pool* pool);
+
+uint32_t chip8_pool_instance_count(const Chip8Pool* pool);
+uint32_t chip8_pool_thread_count(const Chip8Pool* pool);
+Chip8PoolInstance* chip8_pool_get(Chip8Pool* pool, uint32_t index);
+
+// copies `chip8` into every instance and seeds instance i with seed + i, an attached profile is not kept
+void chip8_pool_load(Chip8Pool* pool, const Chip8* chip8, uint64_t seed);
+
+// runs every instance for `frames` frames in chunks of `chunk_frames`, returns the wall clock seconds taken
+double chip8_pool_run(Chip8Pool* pool, uint64_t frames, uint64_t chunk_frames);
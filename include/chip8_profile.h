@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * a profiler attached to a chip8 at runtime, chip8_update feeds it every instruction
+ * when chip8->profile is set and costs a single pointer check when it is not
+ *
+ * it counts executions per instruction handler and per address, follows 2nnn / 00EE
+ * to build a calling context tree (every distinct call stack gets a node with its own
+ * counts) and can be given the host time of every emulated frame
+ *
+ * the results can be written as JSON or as collapsed stacks ("main;sub_0300 1234"
+ * per line) for flamegraph.pl, speedscope and the like
+*/
+
+// one entry per instruction_XXXX handler, and one for opcodes that do not decode to any of them
+typedef enum Chip8OpcodeClass {
+    CHIP8_OP_00E0, CHIP8_OP_00EE,
+    CHIP8_OP_1nnn, CHIP8_OP_2nnn, CHIP8_OP_3xkk, CHIP8_OP_4xkk, CHIP8_OP_5xy0, CHIP8_OP_6xkk, CHIP8_OP_7xkk,
+    CHIP8_OP_8xy0, CHIP8_OP_8xy1, CHIP8_OP_8xy2, CHIP8_OP_8xy3, CHIP8_OP_8xy4, CHIP8_OP_8xy5, CHIP8_OP_8xy6, CHIP8_OP_8xy7, CHIP8_OP_8xyE,
+    CHIP8_OP_9xy0, CHIP8_OP_Annn, CHIP8_OP_Bnnn, CHIP8_OP_Cxkk, CHIP8_OP_Dxyn, CHIP8_OP_Ex9E, CHIP8_OP_ExA1,
+    CHIP8_OP_Fx07, CHIP8_OP_Fx0A, CHIP8_OP_Fx15, CHIP8_OP_Fx18, CHIP8_OP_Fx1E, CHIP8_OP_Fx29, CHIP8_OP_Fx33, CHIP8_OP_Fx55, CHIP8_OP_Fx65,
+    // SUPER-CHIP and XO-CHIP, only handled by the interpreters for those quirks
+    CHIP8_OP_00Cn, CHIP8_OP_00Dn, CHIP8_OP_00FB, CHIP8_OP_00FC, CHIP8_OP_00FD, CHIP8_OP_00FE, CHIP8_OP_00FF, CHIP8_OP_5xy2, CHIP8_OP_5xy3,
+    CHIP8_OP_F000, CHIP8_OP_Fn01, CHIP8_OP_F002, CHIP8_OP_Fx30, CHIP8_OP_Fx3A, CHIP8_OP_Fx75, CHIP8_OP_Fx85,
+    CHIP8_OP_UNKNOWN,
+    CHIP8_OPCODE_CLASS_COUNT,
+} Chip8OpcodeClass;
+
+// one per distinct call stack, node 0 is the program itself
+typedef struct Chip8ProfileNode {
+    uint16_t address; // where the subroutine starts (the program start for node 0)
+    uint32_t parent;
+    uint64_t calls;
+    uint64_t instructions; // run inside this subroutine on this call stack, not counting its callees
+} Chip8ProfileNode;
+
+typedef struct Chip8Profile {
+    uint64_t instructions;
+    uint64_t opcode_counts[CHIP8_OPCODE_CLASS_COUNT];
+    uint64_t address_counts[4096];
+
+    // the calling context tree, with an open addressing table finding a node's child by address
+    Chip8ProfileNode* nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t* children; // node index + 1, 0 for empty slots
+    uint32_t current;   // the node of the subroutine running now
+    uint32_t overflow_depth; // calls deeper than `current` made once the tree was full
+
+    // host time per emulated frame, bucket i counts frames that took [2^i, 2^(i+1)) microseconds, bucket 0 the ones under 2
+    uint64_t frames;
+    double frame_seconds;
+    double max_frame_seconds;
+    uint64_t frame_buckets[32];
+} Chip8Profile;
+
+Chip8Profile* chip8_profile_create();
+void chip8_profile_destroy(Chip8Profile* profile);
+void chip8_profile_clear(Chip8Profile* profile);
+
+// called by chip8_update for 2nnn and 00EE
+void chip8_profile_call(Chip8Profile* profile, uint16_t address);
+void chip8_profile_return(Chip8Profile* profile);
+
+// records how long the host took to run one emulated frame
+void chip8_profile_add_frame(Chip8Profile* profile, double seconds);
+
+// the handler name, e.g. "Dxyn"
+const char* chip8_opcode_class_name(Chip8OpcodeClass opcode_class);
+
+// the memory is used to disassemble the hottest addresses
+int chip8_profile_save_json(const Chip8Profile* profile, const Chip8* chip8, const char* file);
+int chip8_profile_save_stacks(const Chip8Profile* profile, const char* file);
+
+static inline Chip8OpcodeClass chip8_opcode_class(uint16_t opcode) {
+    uint8_t byte = opcode & 0xFF;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) { return CHIP8_OP_00E0; }
+            if (opcode == 0x00EE) { return CHIP8_OP_00EE; }
+            if ((opcode & 0xFFF0) == 0x00C0) { return CHIP8_OP_00Cn; }
+            if ((opcode & 0xFFF0) == 0x00D0) { return CHIP8_OP_00Dn; }
+            if (opcode == 0x00FB) { return CHIP8_OP_00FB; }
+            if (opcode == 0x00FC) { return CHIP8_OP_00FC; }
+            if (opcode == 0x00FD) { return CHIP8_OP_00FD; }
+            if (opcode == 0x00FE) { return CHIP8_OP_00FE; }
+            if (opcode == 0x00FF) { return CHIP8_OP_00FF; }
+            return CHIP8_OP_UNKNOWN;
+        case 0x1: return CHIP8_OP_1nnn;
+        case 0x2: return CHIP8_OP_2nnn;
+        case 0x3: return CHIP8_OP_3xkk;
+        case 0x4: return CHIP8_OP_4xkk;
+        case 0x5:
+            if ((opcode & 0xF) == 0x2) { return CHIP8_OP_5xy2; }
+            if ((opcode & 0xF) == 0x3) { return CHIP8_OP_5xy3; }
+            return CHIP8_OP_5xy0;
+        case 0x6: return CHIP8_OP_6xkk;
+        case 0x7: return CHIP8_OP_7xkk;
+        case 0x8:
+            switch (opcode & 0xF) {
+                case 0x0: return CHIP8_OP_8xy0;
+                case 0x1: return CHIP8_OP_8xy1;
+                case 0x2: return CHIP8_OP_8xy2;
+                case 0x3: return CHIP8_OP_8xy3;
+                case 0x4: return CHIP8_OP_8xy4;
+                case 0x5: return CHIP8_OP_8xy5;
+                case 0x6: return CHIP8_OP_8xy6;
+                case 0x7: return CHIP8_OP_8xy7;
+                case 0xE: return CHIP8_OP_8xyE;
+            }
+            return CHIP8_OP_UNKNOWN;
+        case 0x9: return CHIP8_OP_9xy0;
+        case 0xA: return CHIP8_OP_Annn;
+        case 0xB: return CHIP8_OP_Bnnn;
+        case 0xC: return CHIP8_OP_Cxkk;
+        case 0xD: return CHIP8_OP_Dxyn;
+        case 0xE:
+            if (byte == 0x9E) { return CHIP8_OP_Ex9E; }
+            if (byte == 0xA1) { return CHIP8_OP_ExA1; }
+            return CHIP8_OP_UNKNOWN;
+        case 0xF:
+            if (opcode == 0xF000) { return CHIP8_OP_F000; }
+            if (opcode == 0xF002) { return CHIP8_OP_F002; }
+
+            switch (byte) {
+                case 0x01: return CHIP8_OP_Fn01;
+                case 0x07: return CHIP8_OP_Fx07;
+                case 0x0A: return CHIP8_OP_Fx0A;
+                case 0x15: return CHIP8_OP_Fx15;
+                case 0x18: return CHIP8_OP_Fx18;
+                case 0x1E: return CHIP8_OP_Fx1E;
+                case 0x29: return CHIP8_OP_Fx29;
+                case 0x30: return CHIP8_OP_Fx30;
+                case 0x33: return CHIP8_OP_Fx33;
+                case 0x3A: return CHIP8_OP_Fx3A;
+                case 0x55: return CHIP8_OP_Fx55;
+                case 0x65: return CHIP8_OP_Fx65;
+                case 0x75: return CHIP8_OP_Fx75;
+                case 0x85: return CHIP8_OP_Fx85;
+            }
+            return CHIP8_OP_UNKNOWN;
+    }
+
+    return CHIP8_OP_UNKNOWN;
+}
+
+// called by chip8_update after each instruction when a profile is attached
+static inline void chip8_profile_push(Chip8Profile* profile, uint16_t program_counter, uint16_t opcode) {
+    profile->instructions++;
+    profile->opcode_counts[chip8_opcode_class(opcode)]++;
+    profile->address_counts[program_counter & 0xFFF]++;
+    profile->nodes[profile->current].instructions++;
+
+    // the call itself belongs to the caller and the return to the callee
+    if ((opcode & 0xF000) == 0x2000) {
+        chip8_profile_call(profile, opcode & 0x0FFF);
+    } else if (opcode == 0x00EE) {
+        chip8_profile_return(profile);
+    }
+}
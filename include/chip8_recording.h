@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "chip8_engine.h"
+#include "chip8_clock.h"
+#include "chip8_rom.h"
+
+/*
+ * deterministic input recordings, everything needed to play a session again:
+ * the seed, a hash of the rom and every keypad change keyed by the number of
+ * instructions run before it, plus display hashes to check the replay against
+ *
+ * file: "C8IR", u32 version, u64 seed, u64 rom hash, u64 length in instructions,
+ *       u32 event count, u32 checkpoint count, u32 instructions per second, u32 timing (version 2 on), u32 quirks (version 3 on),
+ *       events:      varint instructions since the previous event, u8 key | down << 4
+ *       checkpoints: varint instructions since the previous checkpoint, u64 display hash
+*/
+
+typedef struct Chip8InputEvent {
+    uint64_t instruction; // takes effect before this instruction runs
+    uint8_t key;          // keypad index
+    uint8_t down;
+} Chip8InputEvent;
+
+typedef struct Chip8Checkpoint {
+    uint64_t instruction;
+    uint64_t display_hash; // chip8_display_hash once `instruction` instructions have run
+} Chip8Checkpoint;
+
+typedef struct Chip8Recording {
+    uint64_t seed;
+    uint64_t rom_hash;
+    uint64_t length;
+
+    // the clock the session ran with, frames have to end at the same instructions for the timers to match
+    Chip8Timing timing;
+    uint32_t instructions_per_second;
+    Chip8Quirks quirks;
+
+    Chip8InputEvent* events;
+    uint32_t event_count;
+    uint32_t event_capacity;
+
+    Chip8Checkpoint* checkpoints;
+    uint32_t checkpoint_count;
+    uint32_t checkpoint_capacity;
+} Chip8Recording;
+
+Chip8Recording* chip8_recording_create(uint64_t seed, uint64_t rom_hash);
+void chip8_recording_destroy(Chip8Recording* recording);
+
+// events and checkpoints have to be added in order, `length` is raised to cover them
+int chip8_recording_add_event(Chip8Recording* recording, uint64_t instruction, uint8_t key, uint8_t down);
+int chip8_recording_add_checkpoint(Chip8Recording* recording, uint64_t instruction, uint64_t display_hash);
+
+int chip8_recording_save(const Chip8Recording* recording, const char* file);
+Chip8Recording* chip8_recording_load(const char* file);
+
+// seeds a freshly created chip8, gives it the recorded quirks and loads the rom, returns -1 if the rom is not the one recorded
+int chip8_replay_start(const Chip8Recording* recording, Chip8* chip8, const char* rom);
+
+// feeds the recorded input back as fast as the engine runs, with the recorded clock, returns -1 at the first checkpoint that does not match
+int chip8_replay_run(const Chip8Recording* recording, Chip8* chip8, Chip8Engine* engine);
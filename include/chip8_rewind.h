@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+/*
+ * a rewind buffer holding one snapshot per frame in a fixed amount of memory
+ *
+ * every `keyframe_interval` frames a keyframe is stored, the frames in between
+ * are stored xored against their keyframe with the runs of zeros left out,
+ * so restoring any frame only decodes its keyframe and one delta
+ *
+ * when the memory is full the oldest frames are dropped
+*/
+
+typedef struct Chip8Rewind Chip8Rewind;
+
+// `memory_size` is the total size of the stored frames, it has to fit a few keyframes (see chip8_snapshot.h)
+Chip8Rewind* chip8_rewind_create(size_t memory_size, uint32_t keyframe_interval);
+void chip8_rewind_destroy(Chip8Rewind* rewind);
+void chip8_rewind_clear(Chip8Rewind* rewind);
+
+// stores the state as the newest frame
+void chip8_rewind_push(Chip8Rewind* rewind, const Chip8* chip8);
+
+// the number of frames held and the bytes they take up
+uint32_t chip8_rewind_size(const Chip8Rewind* rewind);
+size_t chip8_rewind_memory_used(const Chip8Rewind* rewind);
+
+// restores the frame `frames_back` frames before the newest one (0 is the newest), returns -1 if it is not held
+int chip8_rewind_restore(Chip8Rewind* rewind, uint32_t frames_back, Chip8* chip8);
+
+// drops the newest frames, used after rewinding so the next push continues from the restored frame
+void chip8_rewind_drop(Chip8Rewind* rewind, uint32_t frames);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+#include "chip8_clock.h"
+
+/*
+ * roms as bytes in memory rather than files, so hosts running the same roms over and over
+ * only read each of them once
+ *
+ * the cache maps paths to roms and keeps one copy per distinct content, the roms it hands
+ * out stay valid and unchanged until it is destroyed so any thread can load them into a chip8,
+ * files changed on disk after they were cached are not read again
+ *
+ * the database is a text file giving known roms (by content hash) the clock and quirks they want, one rom per line:
+ *
+ *     # hash            settings
+ *     1a2b3c4d5e6f7a8b  clock=700 timing=cosmac quirks=cosmac name=Space Invaders
+ *
+ * `name` takes the rest of the line, unknown settings are skipped
+*/
+
+#define CHIP8_MAX_ROM_SIZE (4096 - 0x200)
+
+typedef struct Chip8Rom {
+    uint64_t hash; // FNV-1a of the data
+    uint32_t size;
+    uint8_t data[CHIP8_MAX_ROM_SIZE];
+} Chip8Rom;
+
+uint64_t chip8_rom_hash_data(const uint8_t* data, size_t size);
+
+// FNV-1a of the rom file, 0 if it can not be read
+uint64_t chip8_rom_hash(const char* file);
+
+// reads a rom file with a single read, fails on files that do not fit into memory
+int chip8_rom_read(Chip8Rom* rom, const char* file);
+
+// resets the chip8 and copies the rom in, see chip8_load_rom
+int chip8_rom_load(Chip8* chip8, const Chip8Rom* rom);
+
+typedef struct Chip8RomCache Chip8RomCache;
+
+Chip8RomCache* chip8_rom_cache_create();
+void chip8_rom_cache_destroy(Chip8RomCache* cache);
+
+// the rom at `file`, read from disk the first time the path is asked for, NULL if it can not be read, thread safe
+const Chip8Rom* chip8_rom_cache_get(Chip8RomCache* cache, const char* file);
+
+// a rom already in the cache by its hash, NULL if there is none (any one of them if contents collide), thread safe
+const Chip8Rom* chip8_rom_cache_find(Chip8RomCache* cache, uint64_t hash);
+
+// how many files were actually read, and how many distinct roms they held
+uint32_t chip8_rom_cache_reads(Chip8RomCache* cache);
+uint32_t chip8_rom_cache_size(Chip8RomCache* cache);
+
+typedef struct Chip8RomProfile {
+    uint64_t hash;
+    char name[64];
+
+    // 0 / CHIP8_ROM_DEFAULT when the database does not say
+    uint32_t instructions_per_second;
+    int8_t timing; // a Chip8Timing or CHIP8_ROM_DEFAULT
+    int8_t quirks; // a Chip8Quirks or CHIP8_ROM_DEFAULT
+} Chip8RomProfile;
+
+#define CHIP8_ROM_DEFAULT -1
+
+typedef struct Chip8RomDatabase {
+    Chip8RomProfile* profiles; // sorted by hash
+    uint32_t count;
+} Chip8RomDatabase;
+
+Chip8RomDatabase* chip8_rom_database_load(const char* file);
+void chip8_rom_database_destroy(Chip8RomDatabase* database);
+
+// the profile of a rom, NULL if the database does not know it
+const Chip8RomProfile* chip8_rom_database_find(const Chip8RomDatabase* database, uint64_t hash);
+
+// the clock and quirks a rom should run with, each is only replaced where the profile has a value
+void chip8_rom_profile_apply(const Chip8RomProfile* profile, Chip8Timing* timing, uint32_t* instructions_per_second, Chip8Quirks* quirks);
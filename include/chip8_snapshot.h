@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+/*
+ * the whole state of a chip8 as a versioned little endian byte string,
+ * snapshots can be restored on any host
+ *
+ * header: "C8SS", u32 version
+ * state:  memory, program_loaded, registers, u16 program_counter, u16 address_register,
+ *         delay_timer, sound_timer, u16 stack[16], stack_pointer, u64 display[2][64][2] (plane by plane,
+ *         row by row), keypad, u32 random_state, hires, plane_mask, flags[16], audio_pattern[16], pitch
+ *
+ * version 1 snapshots (u64 display[32] and nothing past random_state) are restored into low resolution
+*/
+
+#define CHIP8_SNAPSHOT_SIZE (8 + 4096 + 1 + 16 + 2 + 2 + 1 + 1 + 16 * 2 + 1 + \
+                             CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * 8 + 16 + 4 + 1 + 1 + 16 + 16 + 1)
+
+// `buffer` has to hold CHIP8_SNAPSHOT_SIZE bytes
+void chip8_snapshot(const Chip8* chip8, uint8_t* buffer);
+
+// returns -1 without touching the chip8 if the buffer is not a snapshot of this or the previous version,
+// an attached trace is kept
+int chip8_restore(Chip8* chip8, const uint8_t* buffer, size_t size);
+
+int chip8_snapshot_save(const Chip8* chip8, const char* file);
+int chip8_snapshot_load(Chip8* chip8, const char* file);
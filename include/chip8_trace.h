@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+// value of changed_register when the instruction did not write a register
+#define CHIP8_TRACE_NO_REGISTER 0xFF
+
+// one executed instruction, kept small so tracing stays cheap
+typedef struct Chip8TraceRecord {
+    uint16_t program_counter;  // address the instruction was fetched from
+    uint16_t opcode;
+    uint16_t address_register; // I after the instruction ran
+    uint8_t changed_register;  // register written by the instruction or CHIP8_TRACE_NO_REGISTER
+    uint8_t value;             // value of the changed register after the instruction ran
+} Chip8TraceRecord;
+
+// ring buffer holding the most recent records
+typedef struct Chip8Trace {
+    Chip8TraceRecord* records;
+    uint32_t capacity; // always a power of two
+    uint64_t count;    // total records pushed, the ring keeps the last `capacity` of them
+} Chip8Trace;
+
+// capacity is rounded up to a power of two
+Chip8Trace* chip8_trace_create(uint32_t capacity);
+void chip8_trace_destroy(Chip8Trace* trace);
+void chip8_trace_clear(Chip8Trace* trace);
+
+// the number of records currently held and access to them oldest first
+uint32_t chip8_trace_size(const Chip8Trace* trace);
+const Chip8TraceRecord* chip8_trace_get(const Chip8Trace* trace, uint32_t index);
+
+// binary trace files, the records are stored oldest first
+int chip8_trace_save(const Chip8Trace* trace, const char* file);
+Chip8Trace* chip8_trace_load(const char* file);
+
+// turns an opcode into its mnemonic, e.g. "LD V1, 2A"
+void chip8_disassemble(uint16_t opcode, char* buffer, size_t size);
+
+// turns a record into a line of text, e.g. "0200 - LD V1, 2A"
+void chip8_trace_format(const Chip8TraceRecord* record, char* buffer, size_t size);
+
+// the register an opcode writes, or CHIP8_TRACE_NO_REGISTER
+static inline uint8_t chip8_trace_written_register(uint16_t opcode) {
+    uint8_t Vx = (opcode >> 8) & 0x0F;
+
+    switch (opcode >> 12) {
+        case 0x6:
+        case 0x7:
+        case 0x8:
+        case 0xC: return Vx;
+        case 0xD: return 0xF;
+        case 0xF:
+            switch (opcode & 0x00FF) {
+                case 0x07:
+                case 0x0A:
+                case 0x65: return Vx;
+            }
+            break;
+    }
+
+    return CHIP8_TRACE_NO_REGISTER;
+}
+
+// called by chip8_update after each instruction when a trace is attached
+static inline void chip8_trace_push(Chip8Trace* trace, const Chip8* chip8, uint16_t program_counter, uint16_t opcode) {
+    Chip8TraceRecord* record = &trace->records[trace->count & (trace->capacity - 1)];
+    trace->count++;
+
+    record->program_counter = program_counter;
+    record->opcode = opcode;
+    record->address_register = chip8->address_register;
+    record->changed_register = chip8_trace_written_register(opcode);
+    record->value = (record->changed_register != CHIP8_TRACE_NO_REGISTER) ? chip8->registers[record->changed_register] : 0;
+}
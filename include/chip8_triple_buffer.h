@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * hands finished frames from the emulation thread to the render thread without locks
+ *
+ * the writer always has a slot of its own to fill and the reader always has the
+ * slot it is showing, publishing swaps the writer's slot with the shared one and
+ * reading swaps the shared one with the reader's, so neither side ever waits and
+ * the reader only ever sees the newest frame (frames it was too slow for are skipped)
+ *
+ * one writer thread and one reader thread
+*/
+
+typedef struct Chip8Frame {
+    Chip8Display display;
+    uint64_t number; // frames emulated before this one was published
+} Chip8Frame;
+
+typedef struct Chip8TripleBuffer Chip8TripleBuffer;
+
+Chip8TripleBuffer* chip8_triple_buffer_create();
+void chip8_triple_buffer_destroy(Chip8TripleBuffer* buffer);
+
+// the writer's slot, fill it and then publish it
+Chip8Frame* chip8_triple_buffer_write_slot(Chip8TripleBuffer* buffer);
+void chip8_triple_buffer_publish(Chip8TripleBuffer* buffer);
+
+// the newest published frame, NULL if nothing was published since the last call,
+// the frame stays valid until the next call
+const Chip8Frame* chip8_triple_buffer_read(Chip8TripleBuffer* buffer);
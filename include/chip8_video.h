@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * records the display as a stream of frames, for capturing gameplay or the output of regression runs
+ *
+ * header: "C8FV", u32 version
+ * chunks: varint size, varint stored size, then the chunk as is when both are the same or LZ77 compressed
+ *         with matches reaching back into the chunk before (see chip8_video.c), chunks hold whole frames
+ * frames: varint (frames since the previous one << 1 | keyframe), then (unchanged bytes, changed bytes,
+ *         changed bytes xored with the reference) varint tokens until all CHIP8_VIDEO_FRAME_SIZE bytes are covered,
+ *         the reference is the previous frame, or a blank one for keyframes
+ *
+ * a frame is the hires flag followed by both planes as 1 bpp, 64 rows of 16 bytes each with the leftmost
+ * pixel in the top bit of the first byte, a low resolution frame only uses the first 8 bytes of the first
+ * 32 rows so its keyframes stay about as small as the screen
+ *
+ * frame numbers count emulated 60hz frames, frames are only added when the display changed so a still
+ * screen costs nothing, a keyframe is written every CHIP8_VIDEO_KEYFRAME_INTERVAL frames and whenever
+ * the change would take more space than the frame on its own
+ *
+ * the writer encodes on the calling thread into chunks that a background thread compresses and writes to disk,
+ * adding a frame never waits for the disk, when every chunk is still waiting to be written the frame
+ * is dropped instead and the next one is encoded against the last one kept
+ *
+ * headless runs can be far faster than the disk and would rather wait than lose frames, they
+ * create the writer with `wait_for_disk`
+*/
+
+#define CHIP8_VIDEO_FRAME_SIZE (1 + CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_HIRES_WIDTH / 8)
+#define CHIP8_VIDEO_KEYFRAME_INTERVAL 600
+
+typedef struct Chip8VideoWriter Chip8VideoWriter;
+
+Chip8VideoWriter* chip8_video_writer_create(const char* file, int wait_for_disk);
+
+// `frame` is the number of the emulated frame that showed `display`, it must not go backwards,
+// returns -1 if the frame had to be dropped
+int chip8_video_writer_add(Chip8VideoWriter* writer, const Chip8Display* display, uint64_t frame);
+
+// frames added so far and how many of them were dropped
+uint64_t chip8_video_writer_frames(const Chip8VideoWriter* writer);
+uint64_t chip8_video_writer_dropped(const Chip8VideoWriter* writer);
+
+// writes what is left and closes the file, returns -1 if anything could not be written
+int chip8_video_writer_finish(Chip8VideoWriter* writer);
+
+typedef struct Chip8VideoReader Chip8VideoReader;
+
+Chip8VideoReader* chip8_video_reader_open(const char* file);
+void chip8_video_reader_close(Chip8VideoReader* reader);
+
+// the next frame and its number, returns 1 for a frame, 0 at the end and -1 if the file is damaged
+int chip8_video_reader_next(Chip8VideoReader* reader, Chip8Display* display, uint64_t* frame);
@@ -3,459 +3,316 @@
 */
 
 #include "chip8.h"
+#include "chip8_trace.h"
+#include "chip8_profile.h"
+#include "chip8_rom.h"
+#include "chip8_audio.h"
+#include "chip8_instructions.h"
 
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
-static void instruction_00E0(Chip8* chip8);
-static void instruction_00EE(Chip8* chip8);
-static void instruction_1nnn(Chip8* chip8, uint16_t location);
-static void instruction_2nnn(Chip8* chip8, uint16_t location);
-static void instruction_3xkk(Chip8* chip8, uint8_t Vx, uint8_t value);
-static void instruction_4xkk(Chip8* chip8, uint8_t Vx, uint8_t value);
-static void instruction_5xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_6xkk(Chip8* chip8, uint8_t Vx, uint8_t value);
-static void instruction_7xkk(Chip8* chip8, uint8_t Vx, uint8_t value);
-static void instruction_8xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy1(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy2(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy3(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy4(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy5(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy6(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xy7(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_8xyE(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_9xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy);
-static void instruction_Annn(Chip8* chip8, uint16_t location);
-static void instruction_Bnnn(Chip8* chip8, uint16_t location);
-static void instruction_Cxkk(Chip8* chip8, uint8_t Vx, uint8_t value);
-static void instruction_Dxyn(Chip8* chip8, uint8_t Vx, uint8_t Vy, uint8_t size);
-static void instruction_Ex9E(Chip8* chip8, uint8_t Vx);
-static void instruction_ExA1(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx07(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx0A(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx15(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx18(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx1E(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx29(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx33(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx55(Chip8* chip8, uint8_t Vx);
-static void instruction_Fx65(Chip8* chip8, uint8_t Vx);
+static const uint8_t font[5 * 16] = {0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
+                                     0x20, 0x60, 0x20, 0x20, 0x70,  // 1
+                                     0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
+                                     0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
+                                     0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
+                                     0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
+                                     0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
+                                     0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
+                                     0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
+                                     0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
+                                     0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
+                                     0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
+                                     0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
+                                     0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
+                                     0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
+                                     0xF0, 0x80, 0xF0, 0x80, 0x80}; // F
+
+// the SUPER-CHIP digits Fx30 points at, with XO-CHIP's A to F
+static const uint8_t big_font[10 * 16] = {0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C,  // 0
+                                          0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C,  // 1
+                                          0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF,  // 2
+                                          0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C,  // 3
+                                          0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06,  // 4
+                                          0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C,  // 5
+                                          0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C,  // 6
+                                          0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60,  // 7
+                                          0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C,  // 8
+                                          0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C,  // 9
+                                          0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3,  // A
+                                          0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC,  // B
+                                          0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C,  // C
+                                          0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,  // D
+                                          0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF,  // E
+                                          0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0}; // F
+
+// the power on state, without a seed
+static void clear(Chip8* chip8) {
+    memset(chip8, 0, sizeof(Chip8));
+
+    // load fonts into memory
+    memcpy(chip8->memory, font, sizeof(font));
+    memcpy(&chip8->memory[BIG_FONT_ADDRESS], big_font, sizeof(big_font));
+
+    // nothing has been drawn yet
+    chip8->display_dirty = UINT64_MAX;
+
+    // XO-CHIP draws on the first plane and beeps like plain chip8 until told otherwise
+    static const uint8_t default_pattern[] = CHIP8_TONE_DEFAULT_PATTERN;
+    chip8->plane_mask = 1;
+    memcpy(chip8->audio_pattern, default_pattern, sizeof(chip8->audio_pattern));
+    chip8->pitch = CHIP8_TONE_DEFAULT_PITCH;
+}
 
 Chip8 chip8_create() {
-    Chip8 chip8 = {0};
-
-    uint8_t font[5 * 16] = {0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
-                                 0x20, 0x60, 0x20, 0x20, 0x70,  // 1
-                                 0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
-                                 0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
-                                 0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
-                                 0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
-                                 0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
-                                 0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
-                                 0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
-                                 0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
-                                 0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
-                                 0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
-                                 0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
-                                 0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
-                                 0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
-                                 0xF0, 0x80, 0xF0, 0x80, 0x80}; // F
-
-    // load font into memory
-    for (uint8_t i = 0; i < (uint8_t) sizeof(font); i++) {
-        chip8.memory[i] = font[i];
-    }
+    Chip8 chip8;
+    clear(&chip8);
+    chip8_seed(&chip8, 0);
 
     return chip8;
 }
 
-void chip8_load_rom(Chip8* chip8, const char* file) {
-    // reset the chip8
-    *chip8 = chip8_create();
-
-    FILE* rom_file = fopen(file, "rb");
-    if (!rom_file) {
-        printf("ERROR: Failed to open rom file!\n");
-        return;
+void chip8_clone(Chip8* clone, const Chip8* chip8) {
+    // the state is one flat struct, so this is a single copy of 6296 bytes on 64 bit hosts (8 more with
+    // CHIP8_TRACE), 4 KB of memory and 2 KB of display, which is kept at its hires size with both planes
+    // even for profiles that never use them so every engine can index it the same way
+    *clone = *chip8;
+    clone->profile = NULL;
+#ifdef CHIP8_TRACE
+    clone->trace = NULL;
+#endif
+}
+
+// resets the chip8 in place, keeping the random state, the quirks and an attached trace or profile
+static void reset(Chip8* chip8) {
+    uint32_t random_state = chip8->random_state;
+    uint8_t quirks = chip8->quirks;
+    Chip8Profile* profile = chip8->profile;
+#ifdef CHIP8_TRACE
+    Chip8Trace* trace = chip8->trace;
+#endif
+    clear(chip8);
+    chip8->random_state = random_state;
+    chip8->quirks = quirks;
+    chip8->profile = profile;
+#ifdef CHIP8_TRACE
+    chip8->trace = trace;
+#endif
+}
+
+int chip8_load_rom(Chip8* chip8, const char* file) {
+    // a rom that can not be read still resets the chip8, it is left with nothing loaded
+    Chip8Rom rom;
+    if (chip8_rom_read(&rom, file) != 0) {
+        reset(chip8);
+        return -1;
     }
 
-    // load rom into memory starting at 0x200 (512)
-    int current_byte = fgetc(rom_file);
-    int index = 0x200;
-    while (current_byte != EOF) {
-        chip8->memory[index++] = (uint8_t) current_byte;
+    return chip8_rom_load(chip8, &rom);
+}
 
-        current_byte = fgetc(rom_file);
+int chip8_load_program(Chip8* chip8, const uint8_t* program, size_t size) {
+    if (size > sizeof(chip8->memory) - 0x200) {
+        printf("ERROR: Program does not fit into memory!\n");
+        return -1;
     }
 
-    // set program counter to start of program
-    chip8->program_counter = 0x200;
-
-    fclose(rom_file);
-    rom_file = NULL;
+    reset(chip8);
 
+    memcpy(&chip8->memory[0x200], program, size);
+    chip8->program_counter = 0x200;
     chip8->program_loaded = 1;
+
+    return 0;
 }
 
-// fetch -> decode -> execute
-uint16_t fetch_instruction(Chip8* chip8) {
-    uint16_t instruction = (chip8->memory[chip8->program_counter] << 8) | chip8->memory[chip8->program_counter + 1];
-    chip8->program_counter += 2;
+void chip8_seed(Chip8* chip8, uint64_t seed) {
+    // splitmix64 so that nearby seeds give unrelated states
+    seed += 0x9E3779B97F4A7C15;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EB;
+    seed ^= seed >> 31;
 
-    return instruction;
+    // xorshift can never leave a zero state
+    chip8->random_state = (uint32_t) seed ? (uint32_t) seed : 0x6D2B79F5;
 }
 
-void chip8_update(Chip8* chip8) {
+// fetch -> decode -> execute
+static CHIP8_ALWAYS_INLINE void update(Chip8* chip8, uint32_t quirks) {
     if (chip8->program_loaded) {
+        uint16_t program_counter = chip8->program_counter;
         uint16_t instruction = fetch_instruction(chip8);
-        printf("%04x - ", chip8->program_counter);
-
-        uint16_t addr = instruction & 0x0FFF;
-        uint8_t Vx = (instruction >> 8) & 0x0F;
-        uint8_t Vy = (instruction >> 4) & 0x0F;
-        uint8_t byte = instruction & 0x00FF;
-        uint8_t nibble = instruction & 0x000F;
-
-        switch ((instruction >> 12) & 0xF) {
-            case 0x0:
-                switch (byte) {
-                    case 0xE0: instruction_00E0(chip8); break;
-                    case 0xEE: instruction_00EE(chip8); break;
-                }
-                break;
-            case 0x1: instruction_1nnn(chip8, addr); break;
-            case 0x2: instruction_2nnn(chip8, addr); break;
-            case 0x3: instruction_3xkk(chip8, Vx, byte); break;
-            case 0x4: instruction_4xkk(chip8, Vx, byte); break;
-            case 0x5: instruction_5xy0(chip8, Vx, Vy); break;
-            case 0x6: instruction_6xkk(chip8, Vx, byte); break;
-            case 0x7: instruction_7xkk(chip8, Vx, byte); break;
-            case 0x8:
-                switch (nibble) {
-                    case 0x0: instruction_8xy0(chip8, Vx, Vy); break;
-                    case 0x1: instruction_8xy1(chip8, Vx, Vy); break;
-                    case 0x2: instruction_8xy2(chip8, Vx, Vy); break;
-                    case 0x3: instruction_8xy3(chip8, Vx, Vy); break;
-                    case 0x4: instruction_8xy4(chip8, Vx, Vy); break;
-                    case 0x5: instruction_8xy5(chip8, Vx, Vy); break;
-                    case 0x6: instruction_8xy6(chip8, Vx, Vy); break;
-                    case 0x7: instruction_8xy7(chip8, Vx, Vy); break;
-                    case 0xE: instruction_8xyE(chip8, Vx, Vy); break;
-                }
-                break;
-            case 0x9: instruction_9xy0(chip8, Vx, Vy); break;
-            case 0xA: instruction_Annn(chip8, addr); break;
-            case 0xB: instruction_Bnnn(chip8, addr); break;
-            case 0xC: instruction_Cxkk(chip8, Vx, byte); break;
-            case 0xD: instruction_Dxyn(chip8, Vx, Vy, nibble); break;
-            case 0xE:
-                switch (byte) {
-                    case 0x9E: instruction_Ex9E(chip8, Vx); break;
-                    case 0xA1: instruction_ExA1(chip8, Vx); break;
-                }
-                break;
-            case 0xF:
-                switch (byte) {
-                    case 0x07: instruction_Fx07(chip8, Vx); break;
-                    case 0x0A: instruction_Fx0A(chip8, Vx); break;
-                    case 0x15: instruction_Fx15(chip8, Vx); break;
-                    case 0x18: instruction_Fx18(chip8, Vx); break;
-                    case 0x1E: instruction_Fx1E(chip8, Vx); break;
-                    case 0x29: instruction_Fx29(chip8, Vx); break;
-                    case 0x33: instruction_Fx33(chip8, Vx); break;
-                    case 0x55: instruction_Fx55(chip8, Vx); break;
-                    case 0x65: instruction_Fx65(chip8, Vx); break;
-                }
-                break;
-        }
-    }
-}
-
-// this function assumes it will be called 60 times per second
-void chip8_update_timers(Chip8* chip8) {
-    if (chip8->delay_timer > 0) { chip8->delay_timer--; }
-    if (chip8->sound_timer > 0) { chip8->sound_timer--; }
-}
-
-static uint8_t get_keypad_value(int index) {
-    uint8_t value;
-
-    switch (index) {
-        case 0:  value = 0x1; break;
-        case 1:  value = 0x2; break;
-        case 2:  value = 0x3; break;
-        case 3:  value = 0xC; break;
-
-        case 4:  value = 0x4; break;
-        case 5:  value = 0x5; break;
-        case 6:  value = 0x6; break;
-        case 7:  value = 0xD; break;
-
-        case 8:  value = 0x7; break;
-        case 9:  value = 0x8; break;
-        case 10: value = 0x9; break;
-        case 11: value = 0xE; break;
 
-        case 12: value = 0xA; break;
-        case 13: value = 0x0; break;
-        case 14: value = 0xB; break;
-        case 15: value = 0xF; break;
+        chip8_execute_quirks(chip8, instruction, quirks);
 
-        default: value = 0x0; break;
+        if (chip8->profile) { chip8_profile_push(chip8->profile, program_counter, instruction); }
+#ifdef CHIP8_TRACE
+        if (chip8->trace) { chip8_trace_push(chip8->trace, chip8, program_counter, instruction); }
+#endif
     }
-
-    return value;
 }
 
-static uint8_t get_keypad_index(uint8_t value) {
-    uint8_t index;
-
-    switch (value) {
-        case 0x1: index = 0;  break;
-        case 0x2: index = 1;  break;
-        case 0x3: index = 2;  break;
-        case 0xC: index = 3;  break;
-
-        case 0x4: index = 4;  break;
-        case 0x5: index = 5;  break;
-        case 0x6: index = 6;  break;
-        case 0xD: index = 7;  break;
-
-        case 0x7: index = 8;  break;
-        case 0x8: index = 9;  break;
-        case 0x9: index = 10; break;
-        case 0xE: index = 11; break;
-
-        case 0xA: index = 12; break;
-        case 0x0: index = 13; break;
-        case 0xB: index = 14; break;
-        case 0xF: index = 15; break;
-
-        default:  index = 0; break;
+// a single step and a loop for every quirk profile, each with the profile's behaviour compiled in
+#define DEFINE_INTERPRETER(name, quirks) \
+    static void update_##name(Chip8* chip8) { update(chip8, quirks); } \
+    static void run_##name(Chip8* chip8, uint64_t instructions) { \
+        for (uint64_t i = 0; i < instructions; i++) { update(chip8, quirks); } \
     }
 
-    return index;
-}
-
-static void instruction_00E0(Chip8* chip8) {
-    printf("CLS\n");
-    memset(chip8->display, 0, (64 * 32) * sizeof(uint8_t));
-}
-
-static void instruction_00EE(Chip8* chip8) {
-    printf("RTE\n");
-    chip8->stack_pointer -= 1;
-    chip8->program_counter = chip8->stack[chip8->stack_pointer];
-}
+DEFINE_INTERPRETER(default, QUIRKS_DEFAULT)
+DEFINE_INTERPRETER(cosmac, QUIRKS_COSMAC)
+DEFINE_INTERPRETER(chip48, QUIRKS_CHIP48)
+DEFINE_INTERPRETER(schip, QUIRKS_SCHIP)
+DEFINE_INTERPRETER(xochip, QUIRKS_XOCHIP)
+
+static const struct {
+    const char* name;
+    void (*update)(Chip8* chip8);
+    void (*run)(Chip8* chip8, uint64_t instructions);
+} interpreters[CHIP8_QUIRKS_COUNT] = {
+    [CHIP8_QUIRKS_DEFAULT] = {"default", update_default, run_default},
+    [CHIP8_QUIRKS_COSMAC] = {"cosmac", update_cosmac, run_cosmac},
+    [CHIP8_QUIRKS_CHIP48] = {"chip48", update_chip48, run_chip48},
+    [CHIP8_QUIRKS_SCHIP] = {"schip", update_schip, run_schip},
+    [CHIP8_QUIRKS_XOCHIP] = {"xochip", update_xochip, run_xochip},
+};
 
-static void instruction_1nnn(Chip8* chip8, uint16_t location) {
-    printf("JP %03X\n", location);
-    chip8->program_counter = location;
-}
-
-static void instruction_2nnn(Chip8* chip8, uint16_t location) {
-    printf("CALL %03X\n", location);
-    chip8->stack[chip8->stack_pointer++] = chip8->program_counter;
-    chip8->program_counter = location;
-}
-
-static void instruction_3xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
-    printf("SE V%X, %02X\n", Vx, value);
-    if (chip8->registers[Vx] == value) {
-        chip8->program_counter += 2;
-    }
+void chip8_update(Chip8* chip8) {
+    interpreters[chip8->quirks].update(chip8);
 }
 
-static void instruction_4xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
-    printf("SNE V%X, %02X\n", Vx, value);
-    if (chip8->registers[Vx] != value) {
-        chip8->program_counter += 2;
-    }
+void chip8_run(Chip8* chip8, uint64_t instructions) {
+    interpreters[chip8->quirks].run(chip8, instructions);
 }
 
-static void instruction_5xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SNE V%X, V%X\n", Vx, Vy);
-    if (chip8->registers[Vx] == chip8->registers[Vy]) {
-        chip8->program_counter += 2;
+int chip8_quirks_parse(const char* name, Chip8Quirks* quirks) {
+    for (int i = 0; i < CHIP8_QUIRKS_COUNT; i++) {
+        if (strcmp(name, interpreters[i].name) == 0) {
+            *quirks = (Chip8Quirks) i;
+            return 0;
+        }
     }
-}
 
-static void instruction_6xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
-    printf("LD V%X, %02X\n", Vx, value);
-    chip8->registers[Vx] = value;
+    return -1;
 }
 
-static void instruction_7xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
-    printf("ADD V%X, %02X\n", Vx, value);
-    chip8->registers[Vx] += value;
+const char* chip8_quirks_name(Chip8Quirks quirks) {
+    return interpreters[quirks].name;
 }
 
-static void instruction_8xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("LD V%X, V%X\n", Vx, Vy);
-    chip8->registers[Vx] = chip8->registers[Vy];
+// this function assumes it will be called 60 times per second
+void chip8_update_timers(Chip8* chip8) {
+    if (chip8->delay_timer > 0) { chip8->delay_timer--; }
+    if (chip8->sound_timer > 0) { chip8->sound_timer--; }
 }
 
-static void instruction_8xy1(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("OR V%X, V%X\n", Vx, Vy);
-    chip8->registers[Vx] |= chip8->registers[Vy];
-}
+void chip8_run_frame(Chip8* chip8) {
+    chip8_run(chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
 
-static void instruction_8xy2(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("AND V%X, V%X\n", Vx, Vy);
-    chip8->registers[Vx] &= chip8->registers[Vy];
+    chip8_update_timers(chip8);
 }
 
-static void instruction_8xy3(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("XOR V%X, V%X\n", Vx, Vy);
-    chip8->registers[Vx] ^= chip8->registers[Vy];
+int chip8_display_width(const Chip8Display* display) {
+    return display->hires ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH;
 }
 
-static void instruction_8xy4(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("ADD V%X, V%X\n", Vx, Vy);
-
-    uint16_t sum = chip8->registers[Vx] + chip8->registers[Vy];
-    chip8->registers[0xF] = (sum > 0xFF) ? 1 : 0;
-    chip8->registers[Vx] = (sum & 0x00FF);
+int chip8_display_height(const Chip8Display* display) {
+    return display->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
 }
 
-static void instruction_8xy5(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SUB V%X, V%X\n", Vx, Vy);
+static int plane_is_empty(const Chip8Display* display, int plane) {
+    for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+        if (display->planes[plane][y][0] | display->planes[plane][y][1]) { return 0; }
+    }
 
-    chip8->registers[0xF] = (chip8->registers[Vx] > chip8->registers[Vy]) ? 1 : 0;
-    chip8->registers[Vx] -= chip8->registers[Vy];
+    return 1;
 }
 
-static void instruction_8xy6(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SHR V%X, V%X\n", Vx, Vy);
+uint64_t chip8_display_hash(const Chip8* chip8) {
+    const Chip8Display* display = &chip8->display;
+    int height = chip8_display_height(display);
+    int words = chip8_display_width(display) / 64;
+    uint64_t hash = 0xCBF29CE484222325;
 
-    chip8->registers[0xF] = (chip8->registers[Vx] & 1);
-    chip8->registers[Vx] >>= 1;
-}
+    // byte by byte from the leftmost pixels, so the hash does not depend on the host's endianness,
+    // the second plane only counts once something is on it so plain chip8 keeps its old hashes
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (plane > 0 && plane_is_empty(display, plane)) { break; }
 
-static void instruction_8xy7(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SUBN V%X, V%X\n", Vx, Vy);
+        for (int y = 0; y < height; y++) {
+            for (int word = 0; word < words; word++) {
+                for (int shift = 56; shift >= 0; shift -= 8) {
+                    hash ^= (display->planes[plane][y][word] >> shift) & 0xFF;
+                    hash *= 0x100000001B3;
+                }
+            }
+        }
+    }
 
-    chip8->registers[0xF] = (chip8->registers[Vy] > chip8->registers[Vx]) ? 1 : 0;
-    chip8->registers[Vx] = chip8->registers[Vy] - chip8->registers[Vx];
+    return hash;
 }
 
-static void instruction_8xyE(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SHL V%X, V%X\n", Vx, Vy);
+// spreads the 8 bits of `bits` (leftmost pixel first) over the 8 bytes of a word, 0xFF for every set bit
+static inline uint64_t expand_pixels(uint8_t bits) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint64_t lanes = ((uint64_t) bits * 0x0101010101010101) & 0x8040201008040201;
+#else
+    uint64_t lanes = ((uint64_t) bits * 0x0101010101010101) & 0x0102040810204080;
+#endif
 
-    chip8->registers[0xF] = (chip8->registers[Vx] & 0x80) ? 1 : 0;
-    chip8->registers[Vx] <<= 1;
-}
+    // every lane holds either 0 or a single bit, adding 0x7F sets the top bit of the non zero ones
+    lanes = ((lanes + 0x7F7F7F7F7F7F7F7F) & 0x8080808080808080) >> 7;
 
-static void instruction_9xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
-    printf("SNE V%X, V%X\n", Vx, Vy);
-    if (chip8->registers[Vx] != chip8->registers[Vy]) {
-        chip8->program_counter += 2;
-    }
+    return lanes * 0xFF;
 }
 
-static void instruction_Annn(Chip8* chip8, uint16_t location) {
-    printf("LD I, %03X\n", location);
-    chip8->address_register = location;
+void chip8_display_unpack(const Chip8* chip8, uint8_t* pixels) {
+    chip8_display_unpack_rows(chip8, 0, chip8_display_height(&chip8->display), pixels);
 }
 
-static void instruction_Bnnn(Chip8* chip8, uint16_t location) {
-    printf("JP V0, %03X\n", location);
-    chip8->program_counter = location + chip8->registers[0];
-}
+void chip8_display_unpack_rows(const Chip8* chip8, int first_row, int row_count, uint8_t* pixels) {
+    static const uint8_t palette[4] = CHIP8_DISPLAY_PALETTE;
 
-static void instruction_Cxkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
-    printf("RND V%X, %02X\n", Vx, value);
-    chip8->registers[Vx] = (rand() % (255 - 1)) & value;
-}
+    const Chip8Display* display = &chip8->display;
+    int width = chip8_display_width(display);
 
-static void instruction_Dxyn(Chip8* chip8, uint8_t Vx, uint8_t Vy, uint8_t size) {
-    printf("DRW V%X, V%X, %X\n", Vx, Vy, size);
+    // every pixel is in exactly one of the three masks, so each colour is picked with an and
+    uint64_t first_colour = (uint64_t) palette[1] * 0x0101010101010101;
+    uint64_t second_colour = (uint64_t) palette[2] * 0x0101010101010101;
+    uint64_t both_colour = (uint64_t) palette[3] * 0x0101010101010101;
 
-    uint8_t x_position = chip8->registers[Vx] % 64;
-    uint8_t y_position = chip8->registers[Vy] % 32;
+    for (int y = first_row; y < first_row + row_count; y++) {
+        for (int x = 0; x < width / 8; x++) {
+            int shift = 56 - (x % 8) * 8;
+            uint8_t first = (display->planes[0][y][x / 8] >> shift) & 0xFF;
+            uint8_t second = (display->planes[1][y][x / 8] >> shift) & 0xFF;
 
-    for (uint8_t y = 0; y < size; y++) {
-        for (uint8_t x = 0; x < 8; x++) {
-            uint16_t index = (y_position + y) * 64 + (x_position + x);
-
-            if ((chip8->memory[chip8->address_register + y] >> (7 - x)) & 1) {
-                chip8->registers[0xF] = (chip8->display[index]) ? 1 : 0;
-                chip8->display[index] ^= 0xFF;
-            }
+            uint64_t expanded = (expand_pixels(first & ~second) & first_colour) | (expand_pixels(second & ~first) & second_colour) |
+                                (expand_pixels(first & second) & both_colour);
+            memcpy(&pixels[y * width + x * 8], &expanded, sizeof(expanded));
         }
     }
 }
 
-static void instruction_Ex9E(Chip8* chip8, uint8_t Vx) {
-    printf("SKP V%X\n", Vx);
-    if (chip8->keypad[get_keypad_index(chip8->registers[Vx])]) {
-        chip8->program_counter += 2;
+int chip8_display_take_dirty(Chip8* chip8, int* first_row, int* row_count) {
+    uint64_t dirty = chip8->display_dirty & display_rows(&chip8->display);
+    if (!dirty) {
+        chip8->display_dirty = 0;
+        return 0;
     }
-}
 
-static void instruction_ExA1(Chip8* chip8, uint8_t Vx) {
-    printf("SKNP V%X\n", Vx);
-    if (!chip8->keypad[get_keypad_index(chip8->registers[Vx])]) {
-        chip8->program_counter += 2;
-    }
-}
+    int first = 0;
+    while (!(dirty & (1ull << first))) { first++; }
 
-static void instruction_Fx07(Chip8* chip8, uint8_t Vx) {
-    printf("LD V%X, DT\n", Vx);
-    chip8->registers[Vx] = chip8->delay_timer;
-}
+    int last = chip8_display_height(&chip8->display) - 1;
+    while (!(dirty & (1ull << last))) { last--; }
 
-static void instruction_Fx0A(Chip8* chip8, uint8_t Vx) {
-    printf("LD V%X\n", Vx);
-    for (uint8_t i = 0; i < 16; i++) {
-        if (chip8->keypad[i] == 1) {
-            chip8->registers[Vx] = get_keypad_value(i);
-            return;
-        }
-    }
-    chip8->program_counter -= 2;
-}
-
-static void instruction_Fx15(Chip8* chip8, uint8_t Vx) {
-    printf("LD DT, V%X\n", Vx);
-    chip8->delay_timer = chip8->registers[Vx];
-}
-
-static void instruction_Fx18(Chip8* chip8, uint8_t Vx) {
-    printf("LD ST, V%X\n", Vx);
-    chip8->sound_timer = chip8->registers[Vx];
-}
+    *first_row = first;
+    *row_count = last - first + 1;
+    chip8->display_dirty = 0;
 
-static void instruction_Fx1E(Chip8* chip8, uint8_t Vx) {
-    printf("ADD I, V%X\n", Vx);
-    chip8->address_register += chip8->registers[Vx];
-}
-
-static void instruction_Fx29(Chip8* chip8, uint8_t Vx) {
-    printf("LD F, V%X\n", Vx);
-    chip8->address_register = chip8->registers[Vx] * 5;
-}
-
-static void instruction_Fx33(Chip8* chip8, uint8_t Vx) {
-    printf("LD B, V%X\n", Vx);
-    chip8->memory[chip8->address_register] = chip8->registers[Vx] / 100;
-    chip8->memory[chip8->address_register + 1] = (chip8->registers[Vx] / 10) % 10;
-    chip8->memory[chip8->address_register + 2] = chip8->registers[Vx] % 10;
-}
-
-static void instruction_Fx55(Chip8* chip8, uint8_t Vx) {
-    printf("LD I, V%X\n", Vx);
-    for (int i = 0; i <= Vx; i++) {
-        chip8->memory[chip8->address_register + i] = chip8->registers[i];
-    }
-}
-
-static void instruction_Fx65(Chip8* chip8, uint8_t Vx) {
-    printf("LD V%X, I\n", Vx);
-    for (int i = 0; i <= Vx; i++) {
-        chip8->registers[i] = chip8->memory[chip8->address_register + i];
-    }
+    return 1;
 }
@@ -0,0 +1,158 @@
+#include "chip8_audio.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+struct Chip8AudioRing {
+    // positions only ever grow, wrapping at 2^32, and are masked into `samples`
+    _Alignas(64) atomic_uint write; // only stored by the writer
+    uint32_t cached_read;           // the writer's last look at `read`, so it only loads it when the ring seems full
+
+    _Alignas(64) atomic_uint read;  // only stored by the reader
+    uint32_t cached_write;          // the reader's last look at `write`
+
+    _Alignas(64) uint32_t mask;
+    float* samples;
+};
+
+// how many of `count` samples starting at `position` fit before the end of the ring, the rest wraps to the start
+static uint32_t first_piece(const Chip8AudioRing* ring, uint32_t position, uint32_t count) {
+    uint32_t until_end = ring->mask + 1 - (position & ring->mask);
+    return (count < until_end) ? count : until_end;
+}
+
+Chip8AudioRing* chip8_audio_ring_create(uint32_t capacity) {
+    uint32_t size = 1;
+    while (size < capacity) { size <<= 1; }
+
+    Chip8AudioRing* ring = aligned_alloc(64, sizeof(Chip8AudioRing));
+    float* samples = malloc(size * sizeof(float));
+    if (!ring || !samples) {
+        printf("ERROR: Failed to allocate audio ring!\n");
+        free(ring);
+        free(samples);
+        return NULL;
+    }
+
+    atomic_init(&ring->write, 0);
+    ring->cached_read = 0;
+    atomic_init(&ring->read, 0);
+    ring->cached_write = 0;
+    ring->mask = size - 1;
+    ring->samples = samples;
+
+    return ring;
+}
+
+void chip8_audio_ring_destroy(Chip8AudioRing* ring) {
+    if (!ring) { return; }
+
+    free(ring->samples);
+    free(ring);
+}
+
+uint32_t chip8_audio_ring_write(Chip8AudioRing* ring, const float* samples, uint32_t count) {
+    uint32_t write = atomic_load_explicit(&ring->write, memory_order_relaxed);
+    uint32_t capacity = ring->mask + 1;
+
+    // acquire so the reader is done with the samples it handed back
+    if (capacity - (write - ring->cached_read) < count) {
+        ring->cached_read = atomic_load_explicit(&ring->read, memory_order_acquire);
+    }
+
+    uint32_t space = capacity - (write - ring->cached_read);
+    if (count > space) { count = space; }
+
+    uint32_t first = first_piece(ring, write, count);
+    memcpy(&ring->samples[write & ring->mask], samples, first * sizeof(float));
+    memcpy(ring->samples, &samples[first], (count - first) * sizeof(float));
+
+    // release so the samples are written before the reader can see them
+    atomic_store_explicit(&ring->write, write + count, memory_order_release);
+    return count;
+}
+
+uint32_t chip8_audio_ring_read(Chip8AudioRing* ring, float* samples, uint32_t count) {
+    uint32_t read = atomic_load_explicit(&ring->read, memory_order_relaxed);
+
+    if (ring->cached_write - read < count) {
+        ring->cached_write = atomic_load_explicit(&ring->write, memory_order_acquire);
+    }
+
+    uint32_t available = ring->cached_write - read;
+    if (count > available) { count = available; }
+
+    uint32_t first = first_piece(ring, read, count);
+    memcpy(samples, &ring->samples[read & ring->mask], first * sizeof(float));
+    memcpy(&samples[first], ring->samples, (count - first) * sizeof(float));
+
+    atomic_store_explicit(&ring->read, read + count, memory_order_release);
+    return count;
+}
+
+void chip8_audio_ring_trim(Chip8AudioRing* ring, uint32_t keep) {
+    uint32_t read = atomic_load_explicit(&ring->read, memory_order_relaxed);
+    ring->cached_write = atomic_load_explicit(&ring->write, memory_order_acquire);
+
+    uint32_t available = ring->cached_write - read;
+    if (available <= keep) { return; }
+
+    atomic_store_explicit(&ring->read, read + (available - keep), memory_order_release);
+}
+
+Chip8Tone chip8_tone_create(uint32_t sample_rate, float volume) {
+    static const uint8_t default_pattern[] = CHIP8_TONE_DEFAULT_PATTERN;
+
+    Chip8Tone tone = {.volume = volume, .sample_rate = sample_rate};
+    chip8_tone_set_pattern(&tone, default_pattern);
+    chip8_tone_set_rate(&tone, CHIP8_TONE_DEFAULT_RATE);
+
+    return tone;
+}
+
+void chip8_tone_set_pattern(Chip8Tone* tone, const uint8_t* pattern) {
+    for (int i = 0; i < CHIP8_TONE_PATTERN_BITS; i++) {
+        tone->levels[i] = ((pattern[i >> 3] >> (7 - (i & 7))) & 1) ? tone->volume : -tone->volume;
+    }
+}
+
+void chip8_tone_set_rate(Chip8Tone* tone, uint32_t bits_per_second) {
+    // phase per sample is bits_per_second / sample_rate of a 2^25 phase bit
+    tone->step = (uint32_t) (((uint64_t) bits_per_second << 25) / tone->sample_rate);
+}
+
+void chip8_tone_set_pitch(Chip8Tone* tone, uint8_t pitch) {
+    double rate = CHIP8_TONE_DEFAULT_RATE * exp2((pitch - CHIP8_TONE_DEFAULT_PITCH) / 48.0);
+    chip8_tone_set_rate(tone, (uint32_t) (rate + 0.5));
+}
+
+void chip8_tone_generate(Chip8Tone* tone, float* samples, uint32_t count) {
+    // the restrict run pointer lets the compiler fill every run with vector stores
+    uint32_t phase = tone->phase;
+    uint32_t step = tone->step ? tone->step : 1;
+
+    uint32_t i = 0;
+    while (i < count) {
+        uint32_t bit = phase >> 25;
+
+        // samples until the phase reaches the next bit, wrapping back to bit 0 after the last one
+        uint32_t until_next = ((bit + 1) << 25) - phase;
+        uint32_t run = until_next / step + (until_next % step != 0);
+        if (run > count - i) { run = count - i; }
+
+        float level = tone->levels[bit];
+        float* restrict output = &samples[i];
+        for (uint32_t j = 0; j < run; j++) {
+            output[j] = level;
+        }
+
+        i += run;
+        phase += run * step;
+    }
+
+    tone->phase = phase;
+}
@@ -0,0 +1,541 @@
+#include "chip8_batch.h"
+#include "chip8_instructions.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_BATCH_SUPPORTED
+#endif
+
+#ifdef CHIP8_BATCH_SUPPORTED
+
+#define LANES CHIP8_BATCH_LANES
+#define MEMORY_SIZE sizeof(((Chip8*) 0)->memory)
+
+// one element per lane, comparisons give masks with every bit of a lane set or clear
+typedef uint8_t Lanes8 __attribute__((vector_size(LANES)));
+typedef int8_t Mask8 __attribute__((vector_size(LANES)));
+typedef uint16_t Lanes16 __attribute__((vector_size(LANES * 2)));
+typedef int16_t Mask16 __attribute__((vector_size(LANES * 2)));
+
+#define SELECT8(mask, value, otherwise) (((Lanes8) (mask) & (value)) | (~(Lanes8) (mask) & (otherwise)))
+#define SELECT16(mask, value, otherwise) (((Lanes16) (mask) & (value)) | (~(Lanes16) (mask) & (otherwise)))
+
+// 16 bit lanes are wider than sse2 registers and gcc compares those one lane at a time,
+// so these comparisons are built from arithmetic, which it does split into halves
+#define NONZERO16(value) (((Lanes16) (value) | -(Lanes16) (value)) >> 15)
+#define EQUAL_MASK16(a, b) ((Mask16) (NONZERO16((a) ^ (b)) - 1))
+#define NONZERO_MASK16(value) ((Mask16) -NONZERO16(value))
+
+struct Chip8Batch {
+    // the per lane state which is only ever used one lane at a time (memory, stack, screen, keypad, random state),
+    // their registers, program counter, address register and timers are only up to date around scalar steps
+    Chip8 lanes[LANES];
+
+    Lanes8 registers[16];
+    Lanes16 program_counter;
+    Lanes16 address_register;
+    Lanes8 delay_timer;
+    Lanes8 sound_timer;
+
+    // the instruction budget of every lane, 16 bit so it stays in the same registers as the program counters
+    Mask16 loaded;
+    Lanes16 remaining;
+
+    // instructions are fetched from the first loaded lane, unless lanes disagree about those bytes
+    uint32_t fetch_lane;
+    uint8_t memory_differs[MEMORY_SIZE];
+    uint32_t differing_bytes;
+
+    Chip8BatchStats stats;
+};
+
+// masks are passed by pointer, vector arguments wider than the enabled instruction set change the abi
+static int any_lane(const Mask16* mask) {
+    uint64_t words[sizeof(*mask) / sizeof(uint64_t)];
+    memcpy(words, mask, sizeof(*mask));
+
+    uint64_t any = 0;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        any |= words[i];
+    }
+
+    return any != 0;
+}
+
+static void update_memory_differs(Chip8Batch* batch, uint16_t address) {
+    uint8_t value = batch->lanes[batch->fetch_lane].memory[address];
+
+    uint8_t differs = 0;
+    for (uint32_t lane = 0; lane < LANES; lane++) {
+        if (batch->loaded[lane] && batch->lanes[lane].memory[address] != value) { differs = 1; }
+    }
+
+    batch->differing_bytes += differs - batch->memory_differs[address];
+    batch->memory_differs[address] = differs;
+}
+
+static void update_loaded(Chip8Batch* batch) {
+    batch->fetch_lane = 0;
+    for (uint32_t lane = 0; lane < LANES; lane++) {
+        batch->loaded[lane] = batch->lanes[lane].program_loaded ? -1 : 0;
+    }
+
+    for (uint32_t lane = LANES; lane > 0; lane--) {
+        if (batch->loaded[lane - 1]) { batch->fetch_lane = lane - 1; }
+    }
+
+    for (uint16_t address = 0; address < MEMORY_SIZE; address++) {
+        update_memory_differs(batch, address);
+    }
+}
+
+// the vector registers are the real ones, a lane's Chip8 only gets them for scalar steps
+static void copy_registers_to_lane(const Chip8Batch* batch, uint32_t lane, Chip8* chip8) {
+    for (int i = 0; i < 16; i++) {
+        chip8->registers[i] = batch->registers[i][lane];
+    }
+
+    chip8->program_counter = batch->program_counter[lane];
+    chip8->address_register = batch->address_register[lane];
+    chip8->delay_timer = batch->delay_timer[lane];
+    chip8->sound_timer = batch->sound_timer[lane];
+}
+
+static void copy_registers_from_lane(Chip8Batch* batch, uint32_t lane, const Chip8* chip8) {
+    for (int i = 0; i < 16; i++) {
+        batch->registers[i][lane] = chip8->registers[i];
+    }
+
+    batch->program_counter[lane] = chip8->program_counter;
+    batch->address_register[lane] = chip8->address_register;
+    batch->delay_timer[lane] = chip8->delay_timer;
+    batch->sound_timer[lane] = chip8->sound_timer;
+}
+
+Chip8Batch* chip8_batch_create() {
+    // the vector members need more alignment than malloc gives
+    size_t size = (sizeof(Chip8Batch) + 63) & ~(size_t) 63;
+    Chip8Batch* batch = aligned_alloc(64, size);
+    if (!batch) {
+        printf("ERROR: Failed to allocate batch!\n");
+        return NULL;
+    }
+
+    memset(batch, 0, size);
+
+    return batch;
+}
+
+void chip8_batch_destroy(Chip8Batch* batch) {
+    free(batch);
+}
+
+void chip8_batch_set(Chip8Batch* batch, uint32_t lane, const Chip8* chip8) {
+    batch->lanes[lane] = *chip8;
+    batch->lanes[lane].profile = NULL;
+    batch->lanes[lane].quirks = CHIP8_QUIRKS_DEFAULT;
+#ifdef CHIP8_TRACE
+    batch->lanes[lane].trace = NULL;
+#endif
+
+    copy_registers_from_lane(batch, lane, chip8);
+    update_loaded(batch);
+}
+
+void chip8_batch_get(const Chip8Batch* batch, uint32_t lane, Chip8* chip8) {
+    *chip8 = batch->lanes[lane];
+    copy_registers_to_lane(batch, lane, chip8);
+}
+
+uint8_t* chip8_batch_keypad(Chip8Batch* batch, uint32_t lane) {
+    return batch->lanes[lane].keypad;
+}
+
+// runs one instruction on one lane with the reference interpreter
+static void step_lane(Chip8Batch* batch, uint32_t lane) {
+    Chip8* chip8 = &batch->lanes[lane];
+    copy_registers_to_lane(batch, lane, chip8);
+
+    uint16_t program_counter = chip8->program_counter;
+    uint16_t instruction = (chip8->memory[program_counter & MEMORY_MASK] << 8) | chip8->memory[(program_counter + 1) & MEMORY_MASK];
+
+    // the writes the reference interpreter makes, Fx33 and Fx55 are the only instructions that write memory
+    uint16_t written_address = chip8->address_register;
+    uint16_t written_size = 0;
+    if ((instruction & 0xF0FF) == 0xF033) { written_size = 3; }
+    if ((instruction & 0xF0FF) == 0xF055) { written_size = ((instruction >> 8) & 0x0F) + 1; }
+
+    chip8_update(chip8);
+
+    copy_registers_from_lane(batch, lane, chip8);
+    batch->remaining[lane]--;
+    batch->stats.scalar_instructions++;
+
+    for (uint16_t i = 0; i < written_size; i++) {
+        update_memory_differs(batch, (written_address + i) & MEMORY_MASK);
+    }
+}
+
+static void step_lanes(Chip8Batch* batch, const Mask16* mask) {
+    for (uint32_t lane = 0; lane < LANES; lane++) {
+        if ((*mask)[lane]) { step_lane(batch, lane); }
+    }
+}
+
+// runs the instruction at `program_counter` on every lane in `mask`, which all have that program counter
+static void step(Chip8Batch* batch, uint16_t program_counter, const Mask16* lanes_mask) {
+    Mask16 mask = *lanes_mask;
+
+    if (program_counter >= MEMORY_SIZE - 1 ||
+        (batch->differing_bytes && (batch->memory_differs[program_counter] || batch->memory_differs[program_counter + 1]))) {
+        step_lanes(batch, &mask);
+        return;
+    }
+
+    const uint8_t* memory = batch->lanes[batch->fetch_lane].memory;
+    uint16_t instruction = (memory[program_counter] << 8) | memory[program_counter + 1];
+
+    uint16_t addr = instruction & 0x0FFF;
+    uint8_t Vx = (instruction >> 8) & 0x0F;
+    uint8_t Vy = (instruction >> 4) & 0x0F;
+    uint8_t byte = instruction & 0x00FF;
+    uint8_t nibble = instruction & 0x000F;
+
+    Mask8 mask8 = __builtin_convertvector(mask, Mask8);
+    Lanes8* registers = batch->registers;
+    Mask8 condition;
+
+    // the same order of reads and writes as the handlers in chip8_instructions.h, so Vx = VF behaves the same
+    switch ((instruction >> 12) & 0xF) {
+        case 0x0:
+            switch (byte) {
+                case 0xE0:
+                    for (uint32_t lane = 0; lane < LANES; lane++) {
+                        if (mask[lane]) { instruction_00E0(&batch->lanes[lane]); }
+                    }
+                    break;
+                case 0xEE:
+                    for (uint32_t lane = 0; lane < LANES; lane++) {
+                        if (!mask[lane]) { continue; }
+
+                        Chip8* chip8 = &batch->lanes[lane];
+                        chip8->stack_pointer -= 1;
+                        batch->program_counter[lane] = chip8->stack[chip8->stack_pointer] - 2;
+                    }
+                    break;
+            }
+            break;
+        case 0x1:
+            batch->program_counter = SELECT16(mask, (uint16_t) (addr - 2), batch->program_counter);
+            break;
+        case 0x2:
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                if (!mask[lane]) { continue; }
+
+                Chip8* chip8 = &batch->lanes[lane];
+                chip8->stack[chip8->stack_pointer++] = program_counter + 2;
+            }
+            batch->program_counter = SELECT16(mask, (uint16_t) (addr - 2), batch->program_counter);
+            break;
+        case 0x3:
+            condition = (Mask8) (registers[Vx] == byte) & mask8;
+            batch->program_counter += (Lanes16) __builtin_convertvector(condition, Mask16) & 2;
+            break;
+        case 0x4:
+            condition = (Mask8) (registers[Vx] != byte) & mask8;
+            batch->program_counter += (Lanes16) __builtin_convertvector(condition, Mask16) & 2;
+            break;
+        case 0x5:
+            condition = (Mask8) (registers[Vx] == registers[Vy]) & mask8;
+            batch->program_counter += (Lanes16) __builtin_convertvector(condition, Mask16) & 2;
+            break;
+        case 0x6:
+            registers[Vx] = SELECT8(mask8, byte, registers[Vx]);
+            break;
+        case 0x7:
+            registers[Vx] += (Lanes8) mask8 & byte;
+            break;
+        case 0x8:
+            switch (nibble) {
+                case 0x0: registers[Vx] = SELECT8(mask8, registers[Vy], registers[Vx]); break;
+                case 0x1: registers[Vx] = SELECT8(mask8, registers[Vx] | registers[Vy], registers[Vx]); break;
+                case 0x2: registers[Vx] = SELECT8(mask8, registers[Vx] & registers[Vy], registers[Vx]); break;
+                case 0x3: registers[Vx] = SELECT8(mask8, registers[Vx] ^ registers[Vy], registers[Vx]); break;
+                case 0x4: {
+                    Lanes8 sum = registers[Vx] + registers[Vy];
+                    Lanes8 carry = (Lanes8) (sum < registers[Vx]) & 1;
+                    registers[0xF] = SELECT8(mask8, carry, registers[0xF]);
+                    registers[Vx] = SELECT8(mask8, sum, registers[Vx]);
+                    break;
+                }
+                case 0x5:
+                    registers[0xF] = SELECT8(mask8, (Lanes8) (registers[Vx] > registers[Vy]) & 1, registers[0xF]);
+                    registers[Vx] = SELECT8(mask8, registers[Vx] - registers[Vy], registers[Vx]);
+                    break;
+                case 0x6:
+                    registers[0xF] = SELECT8(mask8, registers[Vx] & 1, registers[0xF]);
+                    registers[Vx] = SELECT8(mask8, registers[Vx] >> 1, registers[Vx]);
+                    break;
+                case 0x7:
+                    registers[0xF] = SELECT8(mask8, (Lanes8) (registers[Vy] > registers[Vx]) & 1, registers[0xF]);
+                    registers[Vx] = SELECT8(mask8, registers[Vy] - registers[Vx], registers[Vx]);
+                    break;
+                case 0xE:
+                    registers[0xF] = SELECT8(mask8, registers[Vx] >> 7, registers[0xF]);
+                    registers[Vx] = SELECT8(mask8, registers[Vx] << 1, registers[Vx]);
+                    break;
+            }
+            break;
+        case 0x9:
+            condition = (Mask8) (registers[Vx] != registers[Vy]) & mask8;
+            batch->program_counter += (Lanes16) __builtin_convertvector(condition, Mask16) & 2;
+            break;
+        case 0xA:
+            batch->address_register = SELECT16(mask, addr, batch->address_register);
+            break;
+        case 0xB: {
+            Lanes16 target = __builtin_convertvector(registers[0], Lanes16) + (uint16_t) (addr - 2);
+            batch->program_counter = SELECT16(mask, target, batch->program_counter);
+            break;
+        }
+        case 0xC:
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                if (mask[lane]) { registers[Vx][lane] = (chip8_random(&batch->lanes[lane]) % (255 - 1)) & byte; }
+            }
+            break;
+        case 0xD:
+            // sprites reaching past the end of memory wrap around to its start, leave those to the interpreter
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                if (!mask[lane]) { continue; }
+
+                if (batch->address_register[lane] + nibble > MEMORY_SIZE) {
+                    step_lane(batch, lane);
+                    mask[lane] = 0;
+                    continue;
+                }
+
+                registers[0xF][lane] = draw_sprite(&batch->lanes[lane], registers[Vx][lane], registers[Vy][lane],
+                                                   batch->address_register[lane], nibble, 0);
+            }
+            mask8 = __builtin_convertvector(mask, Mask8);
+            break;
+        case 0xE:
+            switch (byte) {
+                case 0x9E:
+                case 0xA1:
+                    for (uint32_t lane = 0; lane < LANES; lane++) {
+                        if (!mask[lane]) { continue; }
+
+                        uint8_t pressed = batch->lanes[lane].keypad[get_keypad_index(registers[Vx][lane])] != 0;
+                        if (pressed == (byte == 0x9E)) { batch->program_counter[lane] += 2; }
+                    }
+                    break;
+            }
+            break;
+        case 0xF:
+            switch (byte) {
+                case 0x07: registers[Vx] = SELECT8(mask8, batch->delay_timer, registers[Vx]); break;
+                case 0x15: batch->delay_timer = SELECT8(mask8, registers[Vx], batch->delay_timer); break;
+                case 0x18: batch->sound_timer = SELECT8(mask8, registers[Vx], batch->sound_timer); break;
+                case 0x1E:
+                    batch->address_register += (Lanes16) mask & __builtin_convertvector(registers[Vx], Lanes16);
+                    break;
+                case 0x29: {
+                    Lanes16 address = __builtin_convertvector(registers[Vx], Lanes16) * 5;
+                    batch->address_register = SELECT16(mask, address, batch->address_register);
+                    break;
+                }
+
+                case 0x0A:
+                    step_lanes(batch, &mask);
+                    return;
+
+                // accesses past the end of memory wrap around to its start, leave those to the interpreter
+                case 0x33:
+                case 0x55:
+                case 0x65: {
+                    uint16_t size = (byte == 0x33) ? 3 : Vx + 1;
+                    for (uint32_t lane = 0; lane < LANES; lane++) {
+                        if (!mask[lane]) { continue; }
+
+                        uint16_t address = batch->address_register[lane];
+                        if (address + size > MEMORY_SIZE) {
+                            step_lane(batch, lane);
+                            mask[lane] = 0;
+                            continue;
+                        }
+
+                        uint8_t* memory = batch->lanes[lane].memory;
+                        if (byte == 0x33) {
+                            uint8_t value = registers[Vx][lane];
+                            memory[address] = value / 100;
+                            memory[address + 1] = (value / 10) % 10;
+                            memory[address + 2] = value % 10;
+                        } else if (byte == 0x55) {
+                            for (int i = 0; i <= Vx; i++) {
+                                memory[address + i] = registers[i][lane];
+                            }
+                        } else {
+                            for (int i = 0; i <= Vx; i++) {
+                                registers[i][lane] = memory[address + i];
+                            }
+                        }
+                    }
+
+                    // the lanes usually write to the same address, which only has to be compared once
+                    if (byte != 0x65) {
+                        int32_t compared_address = -1;
+                        for (uint32_t lane = 0; lane < LANES; lane++) {
+                            if (!mask[lane] || batch->address_register[lane] == compared_address) { continue; }
+
+                            compared_address = batch->address_register[lane];
+                            for (uint16_t i = 0; i < size; i++) {
+                                update_memory_differs(batch, compared_address + i);
+                            }
+                        }
+                    }
+
+                    mask8 = __builtin_convertvector(mask, Mask8);
+                    break;
+                }
+            }
+            break;
+    }
+
+    // every handler above left the fetch to here, jumps subtracted 2 to make up for it
+    batch->program_counter += (Lanes16) mask & 2;
+    batch->remaining += (Lanes16) mask;
+
+    uint64_t words[sizeof(mask8) / sizeof(uint64_t)];
+    memcpy(words, &mask8, sizeof(mask8));
+
+    batch->stats.vector_steps++;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        batch->stats.vector_instructions += __builtin_popcountll(words[i] & 0x0101010101010101);
+    }
+}
+
+static void run(Chip8Batch* batch, uint16_t instructions) {
+    batch->remaining = (Lanes16) batch->loaded & instructions;
+
+    while (1) {
+        Mask16 active = NONZERO_MASK16(batch->remaining);
+        if (!any_lane(&active)) { break; }
+
+        // usually every lane is at the same place
+        uint16_t program_counter = batch->program_counter[0];
+        Mask16 elsewhere = ~EQUAL_MASK16(batch->program_counter, program_counter) & active;
+
+        // otherwise the lowest program counter goes first, lanes which skipped ahead wait there for the others
+        if (any_lane(&elsewhere)) {
+            Lanes16 candidates = batch->program_counter | ~(Lanes16) active;
+            program_counter = 0xFFFF;
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                program_counter = (candidates[lane] < program_counter) ? candidates[lane] : program_counter;
+            }
+        }
+
+        Mask16 mask = EQUAL_MASK16(batch->program_counter, program_counter) & active;
+        step(batch, program_counter, &mask);
+    }
+}
+
+void chip8_batch_run(Chip8Batch* batch, uint64_t instructions) {
+    while (instructions > 0) {
+        uint16_t chunk = (instructions > UINT16_MAX) ? UINT16_MAX : (uint16_t) instructions;
+        run(batch, chunk);
+        instructions -= chunk;
+    }
+}
+
+void chip8_batch_update_timers(Chip8Batch* batch) {
+    batch->delay_timer -= (Lanes8) (batch->delay_timer != 0) & 1;
+    batch->sound_timer -= (Lanes8) (batch->sound_timer != 0) & 1;
+}
+
+void chip8_batch_run_frame(Chip8Batch* batch) {
+    chip8_batch_run(batch, CHIP8_INSTRUCTIONS_PER_FRAME);
+    chip8_batch_update_timers(batch);
+}
+
+#define COMPARE_FIELD(name) \
+    if (memcmp(&batch_state->name, &reference->name, sizeof(reference->name)) != 0) { \
+        printf("ERROR: batch lane %u and interpreter disagree on " #name "!\n", lane); \
+        return -1; \
+    }
+
+static int compare_state(const Chip8* batch_state, const Chip8* reference, uint32_t lane) {
+    COMPARE_FIELD(memory);
+    COMPARE_FIELD(program_loaded);
+    COMPARE_FIELD(registers);
+    COMPARE_FIELD(program_counter);
+    COMPARE_FIELD(address_register);
+    COMPARE_FIELD(delay_timer);
+    COMPARE_FIELD(sound_timer);
+    COMPARE_FIELD(stack);
+    COMPARE_FIELD(stack_pointer);
+    COMPARE_FIELD(display);
+    COMPARE_FIELD(keypad);
+    COMPARE_FIELD(random_state);
+
+    return 0;
+}
+
+int chip8_batch_verify(Chip8Batch* batch, uint64_t instructions) {
+    Chip8* references = malloc(LANES * sizeof(Chip8));
+    Chip8* batch_state = malloc(sizeof(Chip8));
+    if (!references || !batch_state) {
+        printf("ERROR: Failed to allocate batch references!\n");
+        free(references);
+        free(batch_state);
+        return -1;
+    }
+
+    for (uint32_t lane = 0; lane < LANES; lane++) {
+        chip8_batch_get(batch, lane, &references[lane]);
+    }
+
+    chip8_batch_run(batch, instructions);
+
+    int result = 0;
+    for (uint32_t lane = 0; lane < LANES && result == 0; lane++) {
+        for (uint64_t i = 0; i < instructions; i++) {
+            chip8_update(&references[lane]);
+        }
+
+        chip8_batch_get(batch, lane, batch_state);
+        result = compare_state(batch_state, &references[lane], lane);
+    }
+
+    free(references);
+    free(batch_state);
+
+    return result;
+}
+
+Chip8BatchStats chip8_batch_stats(const Chip8Batch* batch) {
+    return batch->stats;
+}
+
+#else
+
+Chip8Batch* chip8_batch_create() {
+    printf("ERROR: The batch interpreter needs gcc or clang vector extensions!\n");
+    return NULL;
+}
+
+void chip8_batch_destroy(Chip8Batch* batch) {}
+void chip8_batch_set(Chip8Batch* batch, uint32_t lane, const Chip8* chip8) {}
+void chip8_batch_get(const Chip8Batch* batch, uint32_t lane, Chip8* chip8) {}
+uint8_t* chip8_batch_keypad(Chip8Batch* batch, uint32_t lane) { return NULL; }
+void chip8_batch_run(Chip8Batch* batch, uint64_t instructions) {}
+void chip8_batch_update_timers(Chip8Batch* batch) {}
+void chip8_batch_run_frame(Chip8Batch* batch) {}
+int chip8_batch_verify(Chip8Batch* batch, uint64_t instructions) { return -1; }
+Chip8BatchStats chip8_batch_stats(const Chip8Batch* batch) { return (Chip8BatchStats) {0}; }
+
+#endif
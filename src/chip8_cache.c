@@ -0,0 +1,273 @@
+#include "chip8_cache.h"
+#include "chip8_instructions.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// computed goto lets every handler jump straight to the next one
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO
+#endif
+
+// one entry per even address, instructions at odd addresses are decoded on the fly
+#define CACHE_ENTRIES (sizeof(((Chip8*) 0)->memory) / 2)
+
+enum {
+    OPERATION_DECODE,
+    OPERATION_UNKNOWN,
+    OPERATION_00E0,
+    OPERATION_00EE,
+    OPERATION_1nnn,
+    OPERATION_2nnn,
+    OPERATION_3xkk,
+    OPERATION_4xkk,
+    OPERATION_5xy0,
+    OPERATION_6xkk,
+    OPERATION_7xkk,
+    OPERATION_8xy0,
+    OPERATION_8xy1,
+    OPERATION_8xy2,
+    OPERATION_8xy3,
+    OPERATION_8xy4,
+    OPERATION_8xy5,
+    OPERATION_8xy6,
+    OPERATION_8xy7,
+    OPERATION_8xyE,
+    OPERATION_9xy0,
+    OPERATION_Annn,
+    OPERATION_Bnnn,
+    OPERATION_Cxkk,
+    OPERATION_Dxyn,
+    OPERATION_Ex9E,
+    OPERATION_ExA1,
+    OPERATION_Fx07,
+    OPERATION_Fx0A,
+    OPERATION_Fx15,
+    OPERATION_Fx18,
+    OPERATION_Fx1E,
+    OPERATION_Fx29,
+    OPERATION_Fx33,
+    OPERATION_Fx55,
+    OPERATION_Fx65,
+    OPERATION_COUNT
+};
+
+typedef struct DecodedInstruction {
+    uint8_t operation;
+    uint8_t Vx;
+    uint8_t Vy;
+    uint8_t byte; // kk, or n for Dxyn
+    uint16_t addr;
+} DecodedInstruction;
+
+struct Chip8DecodeCache {
+    DecodedInstruction entries[CACHE_ENTRIES];
+};
+
+Chip8DecodeCache* chip8_decode_cache_create() {
+    Chip8DecodeCache* cache = malloc(sizeof(Chip8DecodeCache));
+    if (!cache) {
+        printf("ERROR: Failed to allocate decode cache!\n");
+        return NULL;
+    }
+
+    chip8_decode_cache_invalidate_all(cache);
+
+    return cache;
+}
+
+void chip8_decode_cache_destroy(Chip8DecodeCache* cache) {
+    free(cache);
+}
+
+void chip8_decode_cache_invalidate_all(Chip8DecodeCache* cache) {
+    for (size_t i = 0; i < CACHE_ENTRIES; i++) {
+        cache->entries[i].operation = OPERATION_DECODE;
+    }
+}
+
+static void invalidate_range(Chip8DecodeCache* cache, uint16_t address, uint16_t size) {
+    for (uint16_t i = 0; i < size; i++) {
+        cache->entries[((address + i) & MEMORY_MASK) / 2].operation = OPERATION_DECODE;
+    }
+}
+
+static void decode(DecodedInstruction* entry, uint16_t instruction) {
+    uint8_t byte = instruction & 0x00FF;
+    uint8_t operation = OPERATION_UNKNOWN;
+
+    switch ((instruction >> 12) & 0xF) {
+        case 0x0:
+            switch (byte) {
+                case 0xE0: operation = OPERATION_00E0; break;
+                case 0xEE: operation = OPERATION_00EE; break;
+            }
+            break;
+        case 0x1: operation = OPERATION_1nnn; break;
+        case 0x2: operation = OPERATION_2nnn; break;
+        case 0x3: operation = OPERATION_3xkk; break;
+        case 0x4: operation = OPERATION_4xkk; break;
+        case 0x5: operation = OPERATION_5xy0; break;
+        case 0x6: operation = OPERATION_6xkk; break;
+        case 0x7: operation = OPERATION_7xkk; break;
+        case 0x8:
+            switch (instruction & 0x000F) {
+                case 0x0: operation = OPERATION_8xy0; break;
+                case 0x1: operation = OPERATION_8xy1; break;
+                case 0x2: operation = OPERATION_8xy2; break;
+                case 0x3: operation = OPERATION_8xy3; break;
+                case 0x4: operation = OPERATION_8xy4; break;
+                case 0x5: operation = OPERATION_8xy5; break;
+                case 0x6: operation = OPERATION_8xy6; break;
+                case 0x7: operation = OPERATION_8xy7; break;
+                case 0xE: operation = OPERATION_8xyE; break;
+            }
+            break;
+        case 0x9: operation = OPERATION_9xy0; break;
+        case 0xA: operation = OPERATION_Annn; break;
+        case 0xB: operation = OPERATION_Bnnn; break;
+        case 0xC: operation = OPERATION_Cxkk; break;
+        case 0xD: operation = OPERATION_Dxyn; break;
+        case 0xE:
+            switch (byte) {
+                case 0x9E: operation = OPERATION_Ex9E; break;
+                case 0xA1: operation = OPERATION_ExA1; break;
+            }
+            break;
+        case 0xF:
+            switch (byte) {
+                case 0x07: operation = OPERATION_Fx07; break;
+                case 0x0A: operation = OPERATION_Fx0A; break;
+                case 0x15: operation = OPERATION_Fx15; break;
+                case 0x18: operation = OPERATION_Fx18; break;
+                case 0x1E: operation = OPERATION_Fx1E; break;
+                case 0x29: operation = OPERATION_Fx29; break;
+                case 0x33: operation = OPERATION_Fx33; break;
+                case 0x55: operation = OPERATION_Fx55; break;
+                case 0x65: operation = OPERATION_Fx65; break;
+            }
+            break;
+    }
+
+    entry->operation = operation;
+    entry->Vx = (instruction >> 8) & 0x0F;
+    entry->Vy = (instruction >> 4) & 0x0F;
+    entry->byte = ((instruction >> 12) == 0xD) ? (instruction & 0x000F) : byte;
+    entry->addr = instruction & 0x0FFF;
+}
+
+#ifdef CHIP8_COMPUTED_GOTO
+#define DISPATCH(operation) goto *operations[operation];
+#define CASE(name) operation_##name:
+#define NEXT() \
+    if (remaining == 0) { return; } \
+    remaining--; \
+    program_counter = chip8->program_counter; \
+    if ((program_counter & 1) || program_counter >= sizeof(chip8->memory) - 1) { goto uncached; } \
+    entry = &cache->entries[program_counter / 2]; \
+    chip8->program_counter = program_counter + 2; \
+    goto *operations[entry->operation];
+#else
+#define DISPATCH(operation) switch (operation)
+#define CASE(name) case OPERATION_##name:
+#define NEXT() goto next_instruction;
+#endif
+
+void chip8_decode_cache_run(Chip8DecodeCache* cache, Chip8* chip8, uint64_t instructions) {
+    if (!chip8->program_loaded) { return; }
+
+#ifdef CHIP8_COMPUTED_GOTO
+    static const void* const operations[OPERATION_COUNT] = {
+        &&operation_DECODE, &&operation_UNKNOWN,
+        &&operation_00E0, &&operation_00EE, &&operation_1nnn, &&operation_2nnn,
+        &&operation_3xkk, &&operation_4xkk, &&operation_5xy0, &&operation_6xkk,
+        &&operation_7xkk, &&operation_8xy0, &&operation_8xy1, &&operation_8xy2,
+        &&operation_8xy3, &&operation_8xy4, &&operation_8xy5, &&operation_8xy6,
+        &&operation_8xy7, &&operation_8xyE, &&operation_9xy0, &&operation_Annn,
+        &&operation_Bnnn, &&operation_Cxkk, &&operation_Dxyn, &&operation_Ex9E,
+        &&operation_ExA1, &&operation_Fx07, &&operation_Fx0A, &&operation_Fx15,
+        &&operation_Fx18, &&operation_Fx1E, &&operation_Fx29, &&operation_Fx33,
+        &&operation_Fx55, &&operation_Fx65
+    };
+
+    // with computed goto only the first instruction goes through next_instruction
+    (void) &&next_instruction;
+#endif
+
+    uint64_t remaining = instructions;
+    uint16_t program_counter;
+    DecodedInstruction* entry;
+
+    // instructions at odd addresses (only reachable through Bnnn) or at the very end of memory
+    DecodedInstruction uncached_entry;
+
+next_instruction:
+    if (remaining == 0) { return; }
+    remaining--;
+
+    program_counter = chip8->program_counter;
+    if ((program_counter & 1) || program_counter >= sizeof(chip8->memory) - 1) { goto uncached; }
+
+    entry = &cache->entries[program_counter / 2];
+    chip8->program_counter = program_counter + 2;
+
+dispatch:
+    DISPATCH(entry->operation) {
+        CASE(DECODE)
+            program_counter = chip8->program_counter - 2;
+            decode(entry, (chip8->memory[program_counter] << 8) | chip8->memory[program_counter + 1]);
+            goto dispatch;
+
+        CASE(UNKNOWN) NEXT();
+
+        CASE(00E0) instruction_00E0(chip8); NEXT();
+        CASE(00EE) instruction_00EE(chip8); NEXT();
+        CASE(1nnn) instruction_1nnn(chip8, entry->addr); NEXT();
+        CASE(2nnn) instruction_2nnn(chip8, entry->addr); NEXT();
+        CASE(3xkk) instruction_3xkk(chip8, entry->Vx, entry->byte); NEXT();
+        CASE(4xkk) instruction_4xkk(chip8, entry->Vx, entry->byte); NEXT();
+        CASE(5xy0) instruction_5xy0(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(6xkk) instruction_6xkk(chip8, entry->Vx, entry->byte); NEXT();
+        CASE(7xkk) instruction_7xkk(chip8, entry->Vx, entry->byte); NEXT();
+        CASE(8xy0) instruction_8xy0(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy1) instruction_8xy1(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy2) instruction_8xy2(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy3) instruction_8xy3(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy4) instruction_8xy4(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy5) instruction_8xy5(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy6) instruction_8xy6(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xy7) instruction_8xy7(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(8xyE) instruction_8xyE(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(9xy0) instruction_9xy0(chip8, entry->Vx, entry->Vy); NEXT();
+        CASE(Annn) instruction_Annn(chip8, entry->addr); NEXT();
+        CASE(Bnnn) instruction_Bnnn(chip8, entry->addr); NEXT();
+        CASE(Cxkk) instruction_Cxkk(chip8, entry->Vx, entry->byte); NEXT();
+        CASE(Dxyn) instruction_Dxyn(chip8, entry->Vx, entry->Vy, entry->byte); NEXT();
+        CASE(Ex9E) instruction_Ex9E(chip8, entry->Vx); NEXT();
+        CASE(ExA1) instruction_ExA1(chip8, entry->Vx); NEXT();
+        CASE(Fx07) instruction_Fx07(chip8, entry->Vx); NEXT();
+        CASE(Fx0A) instruction_Fx0A(chip8, entry->Vx); NEXT();
+        CASE(Fx15) instruction_Fx15(chip8, entry->Vx); NEXT();
+        CASE(Fx18) instruction_Fx18(chip8, entry->Vx); NEXT();
+        CASE(Fx1E) instruction_Fx1E(chip8, entry->Vx); NEXT();
+        CASE(Fx29) instruction_Fx29(chip8, entry->Vx); NEXT();
+
+        // the only instructions that write memory, so drop whatever they overwrote
+        CASE(Fx33)
+            invalidate_range(cache, chip8->address_register, 3);
+            instruction_Fx33(chip8, entry->Vx);
+            NEXT();
+        CASE(Fx55)
+            invalidate_range(cache, chip8->address_register, entry->Vx + 1);
+            instruction_Fx55(chip8, entry->Vx);
+            NEXT();
+
+        CASE(Fx65) instruction_Fx65(chip8, entry->Vx); NEXT();
+    }
+
+uncached:
+    decode(&uncached_entry, fetch_instruction(chip8));
+    entry = &uncached_entry;
+    goto dispatch;
+}
@@ -0,0 +1,130 @@
+#include "chip8_clock.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// the VIP's 1802 runs at 1.7609 MHz and a machine cycle is 8 clocks
+#define COSMAC_CYCLES_PER_FRAME 3668
+
+// the cpu is stopped while the display dma reads 128 lines of 8 bytes every frame
+#define COSMAC_DISPLAY_CYCLES 1024
+
+// the interpreter's loop reading and dispatching the next instruction
+#define COSMAC_FETCH_CYCLES 40
+
+Chip8Clock chip8_clock_create(Chip8Timing timing, uint32_t instructions_per_second) {
+    Chip8Clock clock = {0};
+    clock.timing = timing;
+    clock.instructions_per_second = instructions_per_second ? instructions_per_second : CHIP8_DEFAULT_INSTRUCTIONS_PER_SECOND;
+
+    return clock;
+}
+
+static void start_frame(Chip8Clock* clock) {
+    if (clock->timing == CHIP8_TIMING_COSMAC) {
+        clock->cycles_left += COSMAC_CYCLES_PER_FRAME - COSMAC_DISPLAY_CYCLES;
+    } else {
+        uint32_t total = clock->instructions_per_second + clock->remainder;
+        clock->instructions_left = total / 60;
+        clock->remainder = total % 60;
+    }
+
+    clock->in_frame = 1;
+}
+
+uint64_t chip8_clock_run(Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8, uint64_t max_instructions) {
+    if (!clock->in_frame) { start_frame(clock); }
+
+    uint64_t instructions = 0;
+
+    if (clock->timing == CHIP8_TIMING_COSMAC) {
+        // the cost depends on the instruction, so they have to be run one at a time
+        while (clock->cycles_left > 0 && instructions < max_instructions) {
+            uint16_t program_counter = chip8->program_counter & 0xFFF;
+            uint16_t instruction = (chip8->memory[program_counter] << 8) | chip8->memory[(program_counter + 1) & 0xFFF];
+
+            chip8_engine_run(engine, chip8, 1);
+            clock->cycles_left -= chip8_instruction_cycles(instruction);
+            instructions++;
+        }
+
+        if (clock->cycles_left > 0) { return instructions; }
+    } else {
+        instructions = (clock->instructions_left < max_instructions) ? clock->instructions_left : max_instructions;
+        chip8_engine_run(engine, chip8, instructions);
+        clock->instructions_left -= instructions;
+
+        if (clock->instructions_left > 0) { return instructions; }
+    }
+
+    chip8_update_timers(chip8);
+    clock->in_frame = 0;
+
+    return instructions;
+}
+
+uint64_t chip8_clock_run_frame(Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8) {
+    return chip8_clock_run(clock, engine, chip8, UINT64_MAX);
+}
+
+// roughly what the VIP interpreter's handlers take, sprites cost more the taller they are
+// and register loads and stores the more registers they move
+uint32_t chip8_instruction_cycles(uint16_t instruction) {
+    uint8_t x = (instruction >> 8) & 0xF;
+    uint8_t n = instruction & 0xF;
+    uint8_t byte = instruction & 0xFF;
+
+    uint32_t cycles;
+    switch ((instruction >> 12) & 0xF) {
+        case 0x0: cycles = (byte == 0xE0) ? 24 : 23; break;
+        case 0x1: cycles = 23; break;
+        case 0x2: cycles = 23; break;
+        case 0x3: cycles = 12; break;
+        case 0x4: cycles = 12; break;
+        case 0x5: cycles = 16; break;
+        case 0x6: cycles = 6;  break;
+        case 0x7: cycles = 10; break;
+        case 0x8: cycles = 44; break;
+        case 0x9: cycles = 16; break;
+        case 0xA: cycles = 12; break;
+        case 0xB: cycles = 23; break;
+        case 0xC: cycles = 36; break;
+        case 0xD: cycles = 26 + 34 * n; break;
+        case 0xE: cycles = 16; break;
+        case 0xF:
+            switch (byte) {
+                case 0x0A: cycles = 19; break;
+                case 0x1E: cycles = 19; break;
+                case 0x29: cycles = 20; break;
+                case 0x33: cycles = 204; break;
+                case 0x55:
+                case 0x65: cycles = 14 + 14 * (x + 1); break;
+                default:   cycles = 10; break;
+            }
+            break;
+        default: cycles = 0; break;
+    }
+
+    return COSMAC_FETCH_CYCLES + cycles;
+}
+
+static const char* timing_names[] = {
+    [CHIP8_TIMING_FIXED] = "fixed",
+    [CHIP8_TIMING_COSMAC] = "cosmac",
+};
+
+int chip8_timing_parse(const char* name, Chip8Timing* timing) {
+    for (int i = 0; i < (int) (sizeof(timing_names) / sizeof(timing_names[0])); i++) {
+        if (strcmp(name, timing_names[i]) == 0) {
+            *timing = (Chip8Timing) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char* chip8_timing_name(Chip8Timing timing) {
+    return timing_names[timing];
+}
@@ -0,0 +1,58 @@
+/*
+ * little endian and varint helpers for the binary formats, so files can move between hosts
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline void write_u16(uint8_t* buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static inline void write_u32(uint8_t* buffer, uint32_t value) {
+    write_u16(buffer, value & 0xFFFF);
+    write_u16(buffer + 2, value >> 16);
+}
+
+static inline uint16_t read_u16(const uint8_t* buffer) {
+    return (uint16_t) (buffer[0] | (buffer[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t* buffer) {
+    return read_u16(buffer) | ((uint32_t) read_u16(buffer + 2) << 16);
+}
+
+static inline void write_u64(uint8_t* buffer, uint64_t value) {
+    write_u32(buffer, value & 0xFFFFFFFF);
+    write_u32(buffer + 4, value >> 32);
+}
+
+static inline uint64_t read_u64(const uint8_t* buffer) {
+    return read_u32(buffer) | ((uint64_t) read_u32(buffer + 4) << 32);
+}
+
+// 7 bits per byte, lowest first, the top bit marks that more bytes follow
+static inline size_t write_varint(uint8_t* buffer, uint64_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t) value;
+
+    return size;
+}
+
+static inline uint64_t read_varint(const uint8_t* buffer, size_t* position) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = buffer[(*position)++];
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) { break; }
+    }
+
+    return value;
+}
@@ -0,0 +1,182 @@
+#include "chip8_engine.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+Chip8Engine* chip8_engine_create(Chip8EngineType type) {
+    Chip8Engine* engine = calloc(1, sizeof(Chip8Engine));
+    if (!engine) {
+        printf("ERROR: Failed to allocate engine!\n");
+        return NULL;
+    }
+
+    engine->type = type;
+    engine->skip_idle = 1;
+
+    if (type == CHIP8_ENGINE_CACHED) {
+        engine->cache = chip8_decode_cache_create();
+        if (!engine->cache) {
+            free(engine);
+            return NULL;
+        }
+    }
+
+    if (type == CHIP8_ENGINE_JIT) {
+        engine->jit = chip8_jit_create();
+        if (!engine->jit) {
+            free(engine);
+            return NULL;
+        }
+    }
+
+    return engine;
+}
+
+void chip8_engine_destroy(Chip8Engine* engine) {
+    if (!engine) { return; }
+
+    chip8_decode_cache_destroy(engine->cache);
+    chip8_jit_destroy(engine->jit);
+    free(engine);
+}
+
+void chip8_engine_reset(Chip8Engine* engine) {
+    if (engine->cache) { chip8_decode_cache_invalidate_all(engine->cache); }
+    if (engine->jit) { chip8_jit_invalidate_all(engine->jit); }
+}
+
+// the longest idle loop looked for, waiting loops are usually 1 to 3 instructions
+#define IDLE_LOOP_MAX_INSTRUCTIONS 8
+
+// instructions that only read the timers, keypad, memory and registers and only write registers,
+// a loop made of these can only behave differently once the delay timer or the keypad changes
+static int is_idle_instruction(uint16_t instruction) {
+    uint8_t byte = instruction & 0xFF;
+
+    switch ((instruction >> 12) & 0xF) {
+        case 0x1: case 0x3: case 0x4: case 0x6: case 0xA: return 1;
+        case 0x5: case 0x9: return (instruction & 0xF) == 0;
+        case 0xE: return byte == 0x9E || byte == 0xA1;
+        case 0xF: return byte == 0x07 || byte == 0x0A;
+        default: return 0;
+    }
+}
+
+// a cheap look ahead before running anything, is the program counter inside a short run of idle
+// instructions that ends in a jump back to it (or in Fx0A, which jumps back to itself)
+static int maybe_idle_loop(const Chip8* chip8) {
+    uint16_t start = chip8->program_counter;
+
+    for (uint16_t address = start; address < start + 2 * IDLE_LOOP_MAX_INSTRUCTIONS && address < 0xFFF; address += 2) {
+        uint16_t instruction = (chip8->memory[address] << 8) | chip8->memory[address + 1];
+        if (!is_idle_instruction(instruction)) { return 0; }
+
+        if ((instruction & 0xF0FF) == 0xF00A) { return 1; }
+        if ((instruction & 0xF000) == 0x1000) { return (instruction & 0x0FFF) <= start && address - (instruction & 0x0FFF) < 2 * IDLE_LOOP_MAX_INSTRUCTIONS; }
+    }
+
+    return 0;
+}
+
+// runs the program with the reference interpreter for as long as it only runs idle instructions,
+// up to two trips around a loop, and returns the instructions run
+//
+// once a trip gets back to where it started with the registers unchanged, every further trip will
+// do exactly the same, so `*loop_length` is set and the caller can skip whole trips (the first trip
+// of a frame usually is not one of those, it picks up the delay timer's new value)
+static uint64_t probe_idle_loop(Chip8* chip8, uint64_t instructions, uint64_t* loop_length) {
+    *loop_length = 0;
+    if (!maybe_idle_loop(chip8)) { return 0; }
+
+    uint16_t start = chip8->program_counter;
+    uint16_t address_register = chip8->address_register;
+    uint8_t registers[16];
+    memcpy(registers, chip8->registers, sizeof(registers));
+
+    uint64_t run = 0;
+    uint64_t trip_start = 0;
+    int trips = 0;
+    while (run < instructions && run - trip_start < IDLE_LOOP_MAX_INSTRUCTIONS) {
+        uint16_t program_counter = chip8->program_counter;
+        if (program_counter > 0xFFE) { break; }
+
+        uint16_t instruction = (chip8->memory[program_counter] << 8) | chip8->memory[program_counter + 1];
+        if (!is_idle_instruction(instruction)) { break; }
+
+        chip8_update(chip8);
+        run++;
+
+        if (chip8->program_counter != start) { continue; }
+
+        if (chip8->address_register == address_register && memcmp(chip8->registers, registers, sizeof(registers)) == 0) {
+            *loop_length = run - trip_start;
+            break;
+        }
+
+        if (++trips == 2) { break; }
+
+        address_register = chip8->address_register;
+        memcpy(registers, chip8->registers, sizeof(registers));
+        trip_start = run;
+    }
+
+    return run;
+}
+
+void chip8_engine_run(Chip8Engine* engine, Chip8* chip8, uint64_t instructions) {
+    // only the reference interpreter writes traces and profiles, and skipped loops would be missing from them
+#ifdef CHIP8_TRACE
+    int observed = chip8->trace || chip8->profile;
+#else
+    int observed = chip8->profile != NULL;
+#endif
+    int skip_idle = engine->skip_idle && !observed;
+
+    // the other engines only know the default behaviour, every quirk profile has its own switch interpreter
+    Chip8EngineType type = (observed || chip8->quirks != CHIP8_QUIRKS_DEFAULT) ? CHIP8_ENGINE_SWITCH : engine->type;
+
+    if (skip_idle && chip8->program_loaded) {
+        uint64_t loop_length;
+        instructions -= probe_idle_loop(chip8, instructions, &loop_length);
+
+        if (loop_length) {
+            uint64_t skipped = instructions - instructions % loop_length;
+            engine->idle_instructions += skipped;
+            instructions -= skipped;
+        }
+    }
+
+    switch (type) {
+        case CHIP8_ENGINE_SWITCH: chip8_run(chip8, instructions); break;
+        case CHIP8_ENGINE_CACHED: chip8_decode_cache_run(engine->cache, chip8, instructions); break;
+        case CHIP8_ENGINE_JIT: chip8_jit_run(engine->jit, chip8, instructions); break;
+    }
+}
+
+void chip8_engine_run_frame(Chip8Engine* engine, Chip8* chip8) {
+    chip8_engine_run(engine, chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+    chip8_update_timers(chip8);
+}
+
+static const char* engine_names[] = {
+    [CHIP8_ENGINE_SWITCH] = "switch",
+    [CHIP8_ENGINE_CACHED] = "cached",
+    [CHIP8_ENGINE_JIT] = "jit",
+};
+
+int chip8_engine_parse(const char* name, Chip8EngineType* type) {
+    for (int i = 0; i < (int) (sizeof(engine_names) / sizeof(engine_names[0])); i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            *type = (Chip8EngineType) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char* chip8_engine_name(Chip8EngineType type) {
+    return engine_names[type];
+}
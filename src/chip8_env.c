@@ -0,0 +1,129 @@
+#include "chip8_env.h"
+#include "chip8_instructions.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENV_CACHE_LINE 64
+
+// everything a step touches for one machine, a cache line aligned block each
+typedef struct EnvMachine {
+    _Alignas(ENV_CACHE_LINE) Chip8 chip8;
+    Chip8Engine* engine;
+    Chip8Clock clock;
+    uint16_t keys; // the action on the keypad now
+} EnvMachine;
+
+struct Chip8Env {
+    EnvMachine* machines;
+    uint32_t count;
+
+    Chip8 initial;
+    Chip8Clock clock;
+
+    // keypad[key_index[k]] is chip8 key k
+    uint8_t key_index[16];
+};
+
+Chip8Env* chip8_env_create(const Chip8* initial, uint32_t count, Chip8EngineType engine_type) {
+    Chip8Env* env = calloc(1, sizeof(Chip8Env));
+    EnvMachine* machines = aligned_alloc(ENV_CACHE_LINE, (count ? count : 1) * sizeof(EnvMachine));
+    if (!env || !machines) {
+        printf("ERROR: Failed to allocate environment!\n");
+        free(env);
+        free(machines);
+        return NULL;
+    }
+
+    memset(machines, 0, (count ? count : 1) * sizeof(EnvMachine));
+    env->machines = machines;
+    env->clock = chip8_clock_create(CHIP8_TIMING_FIXED, 0);
+
+    chip8_clone(&env->initial, initial);
+    for (uint8_t key = 0; key < 16; key++) {
+        env->key_index[key] = get_keypad_index(key);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        machines[i].engine = chip8_engine_create(engine_type);
+        if (!machines[i].engine) {
+            chip8_env_destroy(env);
+            return NULL;
+        }
+        env->count = i + 1;
+    }
+
+    return env;
+}
+
+void chip8_env_destroy(Chip8Env* env) {
+    if (!env) { return; }
+
+    for (uint32_t i = 0; i < env->count; i++) {
+        chip8_engine_destroy(env->machines[i].engine);
+    }
+
+    free(env->machines);
+    free(env);
+}
+
+uint32_t chip8_env_count(const Chip8Env* env) {
+    return env->count;
+}
+
+void chip8_env_set_clock(Chip8Env* env, Chip8Timing timing, uint32_t instructions_per_second) {
+    env->clock = chip8_clock_create(timing, instructions_per_second);
+}
+
+void chip8_env_reset_one(Chip8Env* env, uint32_t index, uint64_t seed) {
+    EnvMachine* machine = &env->machines[index];
+
+    machine->chip8 = env->initial;
+    chip8_seed(&machine->chip8, seed + index);
+    memset(machine->chip8.keypad, 0, sizeof(machine->chip8.keypad));
+    machine->keys = 0;
+
+    machine->clock = env->clock;
+    chip8_engine_reset(machine->engine);
+}
+
+void chip8_env_reset(Chip8Env* env, uint64_t seed) {
+    for (uint32_t i = 0; i < env->count; i++) {
+        chip8_env_reset_one(env, i, seed);
+    }
+}
+
+void chip8_env_step(Chip8Env* env, const uint16_t* actions, uint32_t frames) {
+    for (uint32_t i = 0; i < env->count; i++) {
+        EnvMachine* machine = &env->machines[i];
+
+        // agents mostly hold the same keys from step to step, so the keypad is only rewritten when they change
+        uint16_t keys = actions[i];
+        if (keys != machine->keys) {
+            for (uint8_t key = 0; key < 16; key++) {
+                machine->chip8.keypad[env->key_index[key]] = (keys >> key) & 1;
+            }
+            machine->keys = keys;
+        }
+
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            chip8_clock_run_frame(&machine->clock, machine->engine, &machine->chip8);
+        }
+    }
+}
+
+const Chip8* chip8_env_machine(const Chip8Env* env, uint32_t index) {
+    return &env->machines[index].chip8;
+}
+
+const Chip8Display* chip8_env_display(const Chip8Env* env, uint32_t index) {
+    return &env->machines[index].chip8.display;
+}
+
+size_t chip8_env_stride(const Chip8Env* env) {
+    // the same for every env, taking one keeps the call like the other accessors
+    (void) env;
+    return sizeof(EnvMachine);
+}
@@ -0,0 +1,195 @@
+#include "chip8_input.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct KeyChange {
+    uint64_t time;
+    uint8_t key;
+    uint8_t down;
+} KeyChange;
+
+struct Chip8Input {
+    // positions only ever grow, wrapping at 2^32, and are masked into `changes`
+    _Alignas(64) atomic_uint write; // only stored by the writer
+    _Alignas(64) atomic_uint read;  // only stored by the reader
+
+    _Alignas(64) uint32_t mask;
+    KeyChange* changes;
+
+    // everything below is the reader's
+    uint8_t held[16];            // the keys as the rom is meant to see them
+    uint64_t pressed_at[16];     // the instruction a key went down before
+    uint64_t release_at[16];     // a release put off until the press has lasted a frame, UINT64_MAX for none
+    uint64_t instructions;       // run by chip8_input_run_frame so far
+    uint64_t frame_instructions; // the last frame's, what a frame's time is spread over
+    uint64_t frame_start;        // the end of the last frame
+};
+
+Chip8Input* chip8_input_create(uint32_t capacity) {
+    uint32_t size = 1;
+    while (size < capacity) { size <<= 1; }
+
+    Chip8Input* input = aligned_alloc(64, sizeof(Chip8Input));
+    KeyChange* changes = malloc(size * sizeof(KeyChange));
+    if (!input || !changes) {
+        printf("ERROR: Failed to allocate input queue!\n");
+        free(input);
+        free(changes);
+        return NULL;
+    }
+
+    memset(input, 0, sizeof(Chip8Input));
+    atomic_init(&input->write, 0);
+    atomic_init(&input->read, 0);
+    input->mask = size - 1;
+    input->changes = changes;
+    for (int key = 0; key < 16; key++) { input->release_at[key] = UINT64_MAX; }
+
+    return input;
+}
+
+void chip8_input_destroy(Chip8Input* input) {
+    if (!input) { return; }
+
+    free(input->changes);
+    free(input);
+}
+
+int chip8_input_push(Chip8Input* input, uint64_t time, uint8_t key, uint8_t down) {
+    uint32_t write = atomic_load_explicit(&input->write, memory_order_relaxed);
+
+    // acquire so the reader is done with the slot before it is written again
+    if (write - atomic_load_explicit(&input->read, memory_order_acquire) > input->mask) { return -1; }
+
+    KeyChange* change = &input->changes[write & input->mask];
+    change->time = time;
+    change->key = key & 0xF;
+    change->down = down != 0;
+
+    // release so the change is written before the reader can see it
+    atomic_store_explicit(&input->write, write + 1, memory_order_release);
+    return 0;
+}
+
+// the oldest change not applied yet, NULL if there is none
+static const KeyChange* peek_change(Chip8Input* input) {
+    uint32_t read = atomic_load_explicit(&input->read, memory_order_relaxed);
+    if (read == atomic_load_explicit(&input->write, memory_order_acquire)) { return NULL; }
+
+    return &input->changes[read & input->mask];
+}
+
+static void pop_change(Chip8Input* input) {
+    uint32_t read = atomic_load_explicit(&input->read, memory_order_relaxed);
+    atomic_store_explicit(&input->read, read + 1, memory_order_release);
+}
+
+static void set_key(Chip8Input* input, Chip8* chip8, uint8_t key, uint8_t down, Chip8Recording* recording, uint64_t instruction) {
+    input->held[key] = down;
+    if (chip8->keypad[key] == down) { return; }
+
+    chip8->keypad[key] = down;
+    if (recording) { chip8_recording_add_event(recording, instruction, key, down); }
+}
+
+// `now` counts the instructions run through the input, `instruction` is the same point for the recording
+static void apply_change(Chip8Input* input, Chip8* chip8, const KeyChange* change, uint64_t now, int hold,
+                         Chip8Recording* recording, uint64_t instruction) {
+    uint8_t key = change->key;
+
+    // a press while a release is put off just keeps the key down
+    if (change->down) {
+        input->release_at[key] = UINT64_MAX;
+        if (!input->held[key]) {
+            input->pressed_at[key] = now;
+            set_key(input, chip8, key, 1, recording, instruction);
+        }
+        return;
+    }
+
+    uint64_t earliest = input->pressed_at[key] + input->frame_instructions;
+    if (hold && input->held[key] && now < earliest) {
+        input->release_at[key] = earliest;
+    } else {
+        input->release_at[key] = UINT64_MAX;
+        set_key(input, chip8, key, 0, recording, instruction);
+    }
+}
+
+uint64_t chip8_input_run_frame(Chip8Input* input, Chip8Clock* clock, Chip8Engine* engine, Chip8* chip8, uint64_t frame_end,
+                               Chip8Recording* recording, uint64_t recorded_instructions) {
+    uint64_t frame_start = (input->frame_start && input->frame_start < frame_end) ? input->frame_start : frame_end;
+    uint64_t span = frame_end - frame_start;
+    input->frame_start = frame_end;
+
+    // until a frame has run, go by what the clock runs without any expensive instructions
+    if (!input->frame_instructions) { input->frame_instructions = clock->instructions_per_second / 60 + 1; }
+
+    // the keypad may have been replaced since the last frame (e.g. by loading a rom)
+    for (uint8_t key = 0; key < 16; key++) {
+        set_key(input, chip8, key, input->held[key], recording, recorded_instructions);
+    }
+
+    uint64_t run = 0;
+    do {
+        uint64_t now = input->instructions + run;
+
+        for (uint8_t key = 0; key < 16; key++) {
+            if (input->release_at[key] > now) { continue; }
+
+            input->release_at[key] = UINT64_MAX;
+            set_key(input, chip8, key, 0, recording, recorded_instructions + run);
+        }
+
+        // run up to whatever comes first, the end of the frame, the next change or the next put off release,
+        // changes from after the frame wait for the next one
+        uint64_t stop = UINT64_MAX;
+
+        const KeyChange* change;
+        while ((change = peek_change(input)) && change->time < frame_end) {
+            uint64_t at = (change->time > frame_start) ? (change->time - frame_start) * input->frame_instructions / span : 0;
+            if (at > run) {
+                stop = at;
+                break;
+            }
+
+            apply_change(input, chip8, change, now, 1, recording, recorded_instructions + run);
+            pop_change(input);
+        }
+
+        for (uint8_t key = 0; key < 16; key++) {
+            if (input->release_at[key] != UINT64_MAX && input->release_at[key] - input->instructions < stop) {
+                stop = input->release_at[key] - input->instructions;
+            }
+        }
+
+        run += chip8_clock_run(clock, engine, chip8, (stop == UINT64_MAX) ? UINT64_MAX : stop - run);
+    } while (clock->in_frame);
+
+    input->instructions += run;
+    if (run) { input->frame_instructions = run; }
+
+    return run;
+}
+
+void chip8_input_apply(Chip8Input* input, Chip8* chip8, uint64_t time) {
+    const KeyChange* change;
+    while ((change = peek_change(input)) && change->time < time) {
+        apply_change(input, chip8, change, input->instructions, 0, NULL, 0);
+        pop_change(input);
+    }
+
+    for (uint8_t key = 0; key < 16; key++) {
+        if (input->release_at[key] != UINT64_MAX) {
+            input->release_at[key] = UINT64_MAX;
+            input->held[key] = 0;
+        }
+        chip8->keypad[key] = input->held[key];
+    }
+
+    input->frame_start = time;
+}
@@ -0,0 +1,650 @@
+/*
+ * the instruction handlers shared by every execution engine, so the switch
+ * interpreter, the decode cache and the other engines all have the same semantics
+ *
+ * the Chip-8 reference used: http://devernay.free.fr/hacks/chip8/C8TECH10.HTM#memmap
+*/
+
+#pragma once
+
+#include "chip8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// for the functions every quirk profile gets its own copy of
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define CHIP8_ALWAYS_INLINE inline
+#endif
+
+// the behaviours a Chip8Quirks profile is made of
+#define QUIRK_VF_RESET      (1u << 0) // 8xy1, 8xy2 and 8xy3 clear VF
+#define QUIRK_SHIFT_VY      (1u << 1) // 8xy6 and 8xyE shift Vy into Vx instead of shifting Vx
+#define QUIRK_MEMORY_PAST   (1u << 2) // Fx55 and Fx65 leave I pointing past the last register
+#define QUIRK_MEMORY_LAST   (1u << 3) // Fx55 and Fx65 leave I pointing at the last register
+#define QUIRK_JUMP_VX       (1u << 4) // Bxnn jumps to xnn + Vx instead of nnn + V0
+#define QUIRK_CLIP          (1u << 5) // sprites are cut off at the edges of the screen instead of wrapping
+#define QUIRK_SCHIP_OPS     (1u << 6) // 00Cn, 00FB-00FF, 16x16 sprites with Dxy0, Fx30, Fx75 and Fx85
+#define QUIRK_XOCHIP_OPS    (1u << 7) // 00Dn, 5xy2, 5xy3, F000 nnnn, Fn01, F002 and Fx3A, skips step over F000 nnnn
+
+#define QUIRKS_DEFAULT 0
+#define QUIRKS_COSMAC (QUIRK_VF_RESET | QUIRK_SHIFT_VY | QUIRK_MEMORY_PAST | QUIRK_CLIP)
+#define QUIRKS_CHIP48 (QUIRK_MEMORY_LAST | QUIRK_JUMP_VX | QUIRK_CLIP)
+#define QUIRKS_SCHIP (QUIRK_JUMP_VX | QUIRK_CLIP | QUIRK_SCHIP_OPS)
+#define QUIRKS_XOCHIP (QUIRK_SHIFT_VY | QUIRK_MEMORY_PAST | QUIRK_SCHIP_OPS | QUIRK_XOCHIP_OPS)
+
+// where the 8x10 digits of Fx30 are kept, right after the 4x5 ones
+#define BIG_FONT_ADDRESS 0x50
+
+// memory is 4 KiB, addresses that run past it wrap around
+#define MEMORY_MASK 0xFFF
+
+static inline uint16_t fetch_instruction(Chip8* chip8) {
+    uint16_t instruction = (chip8->memory[chip8->program_counter & MEMORY_MASK] << 8) | chip8->memory[(chip8->program_counter + 1) & MEMORY_MASK];
+    chip8->program_counter += 2;
+
+    return instruction;
+}
+
+// xorshift32
+static inline uint32_t chip8_random(Chip8* chip8) {
+    uint32_t state = chip8->random_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    chip8->random_state = state;
+
+    return state;
+}
+
+// the keypad is laid out like the COSMAC VIP's hex keypad, index 0 is its top left key
+//
+//     1 2 3 C
+//     4 5 6 D
+//     7 8 9 E
+//     A 0 B F
+static const uint8_t keypad_values[16] = {
+    0x1, 0x2, 0x3, 0xC,
+    0x4, 0x5, 0x6, 0xD,
+    0x7, 0x8, 0x9, 0xE,
+    0xA, 0x0, 0xB, 0xF,
+};
+
+// indexed by a whole register so Ex9E and ExA1 need no masking or range check, values above 0xF read index 0
+static const uint8_t keypad_indices[256] = {
+    [0x1] = 0,  [0x2] = 1,  [0x3] = 2,  [0xC] = 3,
+    [0x4] = 4,  [0x5] = 5,  [0x6] = 6,  [0xD] = 7,
+    [0x7] = 8,  [0x8] = 9,  [0x9] = 10, [0xE] = 11,
+    [0xA] = 12, [0x0] = 13, [0xB] = 14, [0xF] = 15,
+};
+
+static inline uint8_t get_keypad_value(int index) {
+    return keypad_values[index & 0xF];
+}
+
+static inline uint8_t get_keypad_index(uint8_t value) {
+    return keypad_indices[value];
+}
+
+// a dirty bit for each of the display's rows in its current mode
+static inline uint64_t display_rows(const Chip8Display* display) {
+    return display->hires ? UINT64_MAX : (1ull << CHIP8_DISPLAY_HEIGHT) - 1;
+}
+
+static inline void instruction_00E0(Chip8* chip8) {
+    // only the rows that had something on them change
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        chip8->display_dirty |= (uint64_t) (chip8->display.planes[0][y][0] != 0) << y;
+        chip8->display.planes[0][y][0] = 0;
+    }
+}
+
+// 00E0 with the SUPER-CHIP and XO-CHIP opcodes, which can have drawn anywhere on the selected planes
+static inline void instruction_00E0_planes(Chip8* chip8) {
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            uint64_t* row = chip8->display.planes[plane][y];
+            chip8->display_dirty |= (uint64_t) ((row[0] | row[1]) != 0) << y;
+            row[0] = 0;
+            row[1] = 0;
+        }
+    }
+}
+
+// scrolls move whole rows and shift whole words, by pixels of the current mode
+static inline void instruction_00Cn(Chip8* chip8, uint8_t rows) {
+    int height = chip8_display_height(&chip8->display);
+    if (rows == 0) { return; }
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        uint64_t (*display)[CHIP8_DISPLAY_WORDS] = chip8->display.planes[plane];
+        memmove(display[rows], display[0], (size_t) (height - rows) * sizeof(display[0]));
+        memset(display[0], 0, rows * sizeof(display[0]));
+    }
+    chip8->display_dirty |= display_rows(&chip8->display);
+}
+
+static inline void instruction_00Dn(Chip8* chip8, uint8_t rows) {
+    int height = chip8_display_height(&chip8->display);
+    if (rows == 0) { return; }
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        uint64_t (*display)[CHIP8_DISPLAY_WORDS] = chip8->display.planes[plane];
+        memmove(display[0], display[rows], (size_t) (height - rows) * sizeof(display[0]));
+        memset(display[height - rows], 0, rows * sizeof(display[0]));
+    }
+    chip8->display_dirty |= display_rows(&chip8->display);
+}
+
+static inline void instruction_00FB(Chip8* chip8) {
+    int hires = chip8->display.hires;
+    int height = chip8_display_height(&chip8->display);
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        for (int y = 0; y < height; y++) {
+            uint64_t* row = chip8->display.planes[plane][y];
+            if (hires) { row[1] = (row[1] >> 4) | (row[0] << 60); }
+            row[0] >>= 4;
+        }
+    }
+    chip8->display_dirty |= display_rows(&chip8->display);
+}
+
+static inline void instruction_00FC(Chip8* chip8) {
+    int height = chip8_display_height(&chip8->display);
+
+    // in low resolution the second word is always empty
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        for (int y = 0; y < height; y++) {
+            uint64_t* row = chip8->display.planes[plane][y];
+            row[0] = (row[0] << 4) | (row[1] >> 60);
+            row[1] <<= 4;
+        }
+    }
+    chip8->display_dirty |= display_rows(&chip8->display);
+}
+
+// the interpreter exits, which is as good as spinning on the same instruction
+static inline void instruction_00FD(Chip8* chip8) {
+    chip8->program_counter -= 2;
+}
+
+// 00FE and 00FF, the screen is cleared when the resolution changes
+static inline void set_resolution(Chip8* chip8, uint8_t hires) {
+    memset(chip8->display.planes, 0, sizeof(chip8->display.planes));
+    chip8->display.hires = hires;
+    chip8->display_dirty = UINT64_MAX;
+}
+
+static inline void instruction_00EE(Chip8* chip8) {
+    chip8->stack_pointer -= 1;
+    chip8->program_counter = chip8->stack[chip8->stack_pointer];
+}
+
+static inline void instruction_1nnn(Chip8* chip8, uint16_t location) {
+    chip8->program_counter = location;
+}
+
+static inline void instruction_2nnn(Chip8* chip8, uint16_t location) {
+    chip8->stack[chip8->stack_pointer++] = chip8->program_counter;
+    chip8->program_counter = location;
+}
+
+static inline void instruction_3xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
+    if (chip8->registers[Vx] == value) {
+        chip8->program_counter += 2;
+    }
+}
+
+static inline void instruction_4xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
+    if (chip8->registers[Vx] != value) {
+        chip8->program_counter += 2;
+    }
+}
+
+static inline void instruction_5xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    if (chip8->registers[Vx] == chip8->registers[Vy]) {
+        chip8->program_counter += 2;
+    }
+}
+
+// Vx to Vy (counting down when x > y) from I on, I is left alone
+static inline void instruction_5xy2(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    int step = (Vx <= Vy) ? 1 : -1;
+    int count = (Vx <= Vy) ? Vy - Vx : Vx - Vy;
+
+    for (int i = 0; i <= count; i++) {
+        chip8->memory[(chip8->address_register + i) & MEMORY_MASK] = chip8->registers[Vx + i * step];
+    }
+}
+
+static inline void instruction_5xy3(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    int step = (Vx <= Vy) ? 1 : -1;
+    int count = (Vx <= Vy) ? Vy - Vx : Vx - Vy;
+
+    for (int i = 0; i <= count; i++) {
+        chip8->registers[Vx + i * step] = chip8->memory[(chip8->address_register + i) & MEMORY_MASK];
+    }
+}
+
+static inline void instruction_6xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
+    chip8->registers[Vx] = value;
+}
+
+static inline void instruction_7xkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
+    chip8->registers[Vx] += value;
+}
+
+static inline void instruction_8xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[Vx] = chip8->registers[Vy];
+}
+
+static inline void instruction_8xy1(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[Vx] |= chip8->registers[Vy];
+}
+
+static inline void instruction_8xy2(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[Vx] &= chip8->registers[Vy];
+}
+
+static inline void instruction_8xy3(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[Vx] ^= chip8->registers[Vy];
+}
+
+static inline void instruction_8xy4(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    uint16_t sum = chip8->registers[Vx] + chip8->registers[Vy];
+    chip8->registers[0xF] = (sum > 0xFF) ? 1 : 0;
+    chip8->registers[Vx] = (sum & 0x00FF);
+}
+
+static inline void instruction_8xy5(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[0xF] = (chip8->registers[Vx] > chip8->registers[Vy]) ? 1 : 0;
+    chip8->registers[Vx] -= chip8->registers[Vy];
+}
+
+static inline void instruction_8xy6(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    // Vy only matters with QUIRK_SHIFT_VY, the parameter keeps the handlers alike for dispatch
+    (void) Vy;
+    chip8->registers[0xF] = (chip8->registers[Vx] & 1);
+    chip8->registers[Vx] >>= 1;
+}
+
+static inline void instruction_8xy7(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    chip8->registers[0xF] = (chip8->registers[Vy] > chip8->registers[Vx]) ? 1 : 0;
+    chip8->registers[Vx] = chip8->registers[Vy] - chip8->registers[Vx];
+}
+
+static inline void instruction_8xyE(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    (void) Vy;
+    chip8->registers[0xF] = (chip8->registers[Vx] & 0x80) ? 1 : 0;
+    chip8->registers[Vx] <<= 1;
+}
+
+// the QUIRK_SHIFT_VY shifts, the flag is written last so it wins when Vx is VF
+static inline void instruction_8xy6_shift_vy(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    uint8_t value = chip8->registers[Vy];
+    chip8->registers[Vx] = value >> 1;
+    chip8->registers[0xF] = value & 1;
+}
+
+static inline void instruction_8xyE_shift_vy(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    uint8_t value = chip8->registers[Vy];
+    chip8->registers[Vx] = value << 1;
+    chip8->registers[0xF] = value >> 7;
+}
+
+static inline void instruction_9xy0(Chip8* chip8, uint8_t Vx, uint8_t Vy) {
+    if (chip8->registers[Vx] != chip8->registers[Vy]) {
+        chip8->program_counter += 2;
+    }
+}
+
+static inline void instruction_Annn(Chip8* chip8, uint16_t location) {
+    chip8->address_register = location;
+}
+
+static inline void instruction_Bnnn(Chip8* chip8, uint16_t location) {
+    chip8->program_counter = location + chip8->registers[0];
+}
+
+static inline void instruction_Bxnn(Chip8* chip8, uint16_t location) {
+    chip8->program_counter = location + chip8->registers[(location >> 8) & 0x0F];
+}
+
+static inline void instruction_Cxkk(Chip8* chip8, uint8_t Vx, uint8_t value) {
+    chip8->registers[Vx] = (chip8_random(chip8) % (255 - 1)) & value;
+}
+
+// xors the sprite at `address` onto the display, returns 1 if any pixel was turned off,
+// with `clip` the parts of the sprite past the right and bottom edges are dropped instead of wrapping around
+static CHIP8_ALWAYS_INLINE uint8_t draw_sprite(Chip8* chip8, uint8_t x, uint8_t y, uint16_t address, uint8_t size, int clip) {
+    uint8_t x_position = x % CHIP8_DISPLAY_WIDTH;
+    uint8_t y_position = y % CHIP8_DISPLAY_HEIGHT;
+
+    // the position itself always wraps
+    if (clip && size > CHIP8_DISPLAY_HEIGHT - y_position) { size = CHIP8_DISPLAY_HEIGHT - y_position; }
+
+    uint64_t collision = 0;
+    for (uint8_t row = 0; row < size; row++) {
+        uint64_t sprite_row = (uint64_t) chip8->memory[(address + row) & MEMORY_MASK] << 56;
+        sprite_row = (sprite_row >> x_position) | ((x_position && !clip) ? sprite_row << (64 - x_position) : 0);
+
+        uint8_t display_y = (y_position + row) % CHIP8_DISPLAY_HEIGHT;
+        uint64_t* display_row = &chip8->display.planes[0][display_y][0];
+        collision |= *display_row & sprite_row;
+        *display_row ^= sprite_row;
+        chip8->display_dirty |= (uint64_t) (sprite_row != 0) << display_y;
+    }
+
+    return collision ? 1 : 0;
+}
+
+// the sprite row `bits` (its leftmost pixel in the top bit) moved to `x` as the two words of a display row
+static CHIP8_ALWAYS_INLINE void place_sprite_row(uint64_t bits, uint8_t x, int hires, int clip, uint64_t* words) {
+    if (!hires) {
+        words[0] = (bits >> x) | ((x && !clip) ? bits << (64 - x) : 0);
+        words[1] = 0;
+    } else if (x < 64) {
+        // sprites are at most 16 pixels wide, so they never reach past the second word from here
+        words[0] = bits >> x;
+        words[1] = x ? bits << (64 - x) : 0;
+    } else {
+        uint8_t shift = x - 64;
+        words[1] = bits >> shift;
+        words[0] = (shift && !clip) ? bits << (64 - shift) : 0;
+    }
+}
+
+// draw_sprite with the SUPER-CHIP and XO-CHIP opcodes: in either resolution, a size of 0 draws 16x16,
+// and every selected plane gets a sprite of its own with the data for each plane following the last
+static CHIP8_ALWAYS_INLINE uint8_t draw_sprite_planes(Chip8* chip8, uint8_t x, uint8_t y, uint16_t address, uint8_t size, int clip) {
+    int hires = chip8->display.hires;
+    int width = chip8_display_width(&chip8->display);
+    int height = chip8_display_height(&chip8->display);
+    uint8_t x_position = x & (width - 1);
+    uint8_t y_position = y & (height - 1);
+
+    int wide = (size == 0);
+    uint8_t rows = wide ? 16 : size;
+    uint8_t visible = rows;
+    if (clip && visible > height - y_position) { visible = height - y_position; }
+
+    uint64_t collision = 0;
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        if (!(chip8->plane_mask & (1 << plane))) { continue; }
+
+        for (uint8_t row = 0; row < visible; row++) {
+            uint16_t row_address = address + (wide ? row * 2 : row);
+            uint64_t bits = (uint64_t) chip8->memory[row_address & MEMORY_MASK] << 56;
+            if (wide) { bits |= (uint64_t) chip8->memory[(row_address + 1) & MEMORY_MASK] << 48; }
+
+            uint64_t words[CHIP8_DISPLAY_WORDS];
+            place_sprite_row(bits, x_position, hires, clip, words);
+
+            uint8_t display_y = (y_position + row) & (height - 1);
+            uint64_t* display_row = chip8->display.planes[plane][display_y];
+            collision |= (display_row[0] & words[0]) | (display_row[1] & words[1]);
+            display_row[0] ^= words[0];
+            display_row[1] ^= words[1];
+            chip8->display_dirty |= (uint64_t) ((words[0] | words[1]) != 0) << display_y;
+        }
+
+        address += wide ? 32 : size;
+    }
+
+    return collision ? 1 : 0;
+}
+
+static inline void instruction_Dxyn(Chip8* chip8, uint8_t Vx, uint8_t Vy, uint8_t size) {
+    chip8->registers[0xF] = draw_sprite(chip8, chip8->registers[Vx], chip8->registers[Vy], chip8->address_register, size, 0);
+}
+
+static inline void instruction_Dxyn_clip(Chip8* chip8, uint8_t Vx, uint8_t Vy, uint8_t size) {
+    chip8->registers[0xF] = draw_sprite(chip8, chip8->registers[Vx], chip8->registers[Vy], chip8->address_register, size, 1);
+}
+
+static inline void instruction_Dxyn_planes(Chip8* chip8, uint8_t Vx, uint8_t Vy, uint8_t size, int clip) {
+    chip8->registers[0xF] = draw_sprite_planes(chip8, chip8->registers[Vx], chip8->registers[Vy], chip8->address_register, size, clip);
+}
+
+static inline void instruction_Ex9E(Chip8* chip8, uint8_t Vx) {
+    if (chip8->keypad[get_keypad_index(chip8->registers[Vx])]) {
+        chip8->program_counter += 2;
+    }
+}
+
+static inline void instruction_ExA1(Chip8* chip8, uint8_t Vx) {
+    if (!chip8->keypad[get_keypad_index(chip8->registers[Vx])]) {
+        chip8->program_counter += 2;
+    }
+}
+
+// XO-CHIP's only 4 byte instruction, I is loaded from the word after it
+static inline void instruction_F000(Chip8* chip8) {
+    uint16_t address = (chip8->memory[chip8->program_counter & MEMORY_MASK] << 8) | chip8->memory[(chip8->program_counter + 1) & MEMORY_MASK];
+    chip8->address_register = address & MEMORY_MASK;
+    chip8->program_counter += 2;
+}
+
+static inline void instruction_Fn01(Chip8* chip8, uint8_t planes) {
+    chip8->plane_mask = planes & ((1 << CHIP8_DISPLAY_PLANES) - 1);
+}
+
+static inline void instruction_F002(Chip8* chip8) {
+    for (int i = 0; i < (int) sizeof(chip8->audio_pattern); i++) {
+        chip8->audio_pattern[i] = chip8->memory[(chip8->address_register + i) & MEMORY_MASK];
+    }
+}
+
+static inline void instruction_Fx07(Chip8* chip8, uint8_t Vx) {
+    chip8->registers[Vx] = chip8->delay_timer;
+}
+
+static inline void instruction_Fx0A(Chip8* chip8, uint8_t Vx) {
+    for (uint8_t i = 0; i < 16; i++) {
+        if (chip8->keypad[i] == 1) {
+            chip8->registers[Vx] = get_keypad_value(i);
+            return;
+        }
+    }
+    chip8->program_counter -= 2;
+}
+
+static inline void instruction_Fx15(Chip8* chip8, uint8_t Vx) {
+    chip8->delay_timer = chip8->registers[Vx];
+}
+
+static inline void instruction_Fx18(Chip8* chip8, uint8_t Vx) {
+    chip8->sound_timer = chip8->registers[Vx];
+}
+
+static inline void instruction_Fx1E(Chip8* chip8, uint8_t Vx) {
+    chip8->address_register += chip8->registers[Vx];
+}
+
+static inline void instruction_Fx29(Chip8* chip8, uint8_t Vx) {
+    chip8->address_register = chip8->registers[Vx] * 5;
+}
+
+static inline void instruction_Fx30(Chip8* chip8, uint8_t Vx) {
+    chip8->address_register = BIG_FONT_ADDRESS + (chip8->registers[Vx] & 0xF) * 10;
+}
+
+static inline void instruction_Fx3A(Chip8* chip8, uint8_t Vx) {
+    chip8->pitch = chip8->registers[Vx];
+}
+
+static inline void instruction_Fx33(Chip8* chip8, uint8_t Vx) {
+    chip8->memory[chip8->address_register & MEMORY_MASK] = chip8->registers[Vx] / 100;
+    chip8->memory[(chip8->address_register + 1) & MEMORY_MASK] = (chip8->registers[Vx] / 10) % 10;
+    chip8->memory[(chip8->address_register + 2) & MEMORY_MASK] = chip8->registers[Vx] % 10;
+}
+
+static inline void instruction_Fx55(Chip8* chip8, uint8_t Vx) {
+    for (int i = 0; i <= Vx; i++) {
+        chip8->memory[(chip8->address_register + i) & MEMORY_MASK] = chip8->registers[i];
+    }
+}
+
+static inline void instruction_Fx65(Chip8* chip8, uint8_t Vx) {
+    for (int i = 0; i <= Vx; i++) {
+        chip8->registers[i] = chip8->memory[(chip8->address_register + i) & MEMORY_MASK];
+    }
+}
+
+static inline void instruction_Fx75(Chip8* chip8, uint8_t Vx) {
+    memcpy(chip8->flags, chip8->registers, Vx + 1);
+}
+
+static inline void instruction_Fx85(Chip8* chip8, uint8_t Vx) {
+    memcpy(chip8->registers, chip8->flags, Vx + 1);
+}
+
+// a skip that landed on F000 nnnn has only stepped over its first word, `skipped` is where it landed from
+static inline void skip_long_instruction(Chip8* chip8, uint16_t instruction, uint16_t skipped) {
+    uint8_t group = instruction >> 12;
+    int skip = group == 0x3 || group == 0x4 || group == 0x5 || group == 0x9 || group == 0xE;
+
+    if (skip && chip8->program_counter == skipped + 2 &&
+        chip8->memory[skipped & MEMORY_MASK] == 0xF0 && chip8->memory[(skipped + 1) & MEMORY_MASK] == 0x00) {
+        chip8->program_counter += 2;
+    }
+}
+
+// where Fx55 and Fx65 leave I
+static CHIP8_ALWAYS_INLINE void step_address_register(Chip8* chip8, uint8_t Vx, uint32_t quirks) {
+    if (quirks & QUIRK_MEMORY_PAST) { chip8->address_register += Vx + 1; }
+    if (quirks & QUIRK_MEMORY_LAST) { chip8->address_register += Vx; }
+}
+
+// decodes and runs an already fetched instruction, the program counter has to point past it,
+// `quirks` is always a constant so the checks on it are gone once this is inlined into a profile's interpreter
+static CHIP8_ALWAYS_INLINE void chip8_execute_quirks(Chip8* chip8, uint16_t instruction, uint32_t quirks) {
+    uint16_t addr = instruction & 0x0FFF;
+    uint8_t Vx = (instruction >> 8) & 0x0F;
+    uint8_t Vy = (instruction >> 4) & 0x0F;
+    uint8_t byte = instruction & 0x00FF;
+    uint8_t nibble = instruction & 0x000F;
+    uint16_t next = chip8->program_counter;
+
+    switch ((instruction >> 12) & 0xF) {
+        case 0x0:
+            if ((quirks & QUIRK_SCHIP_OPS) && (instruction & 0xFFF0) == 0x00C0) { instruction_00Cn(chip8, nibble); break; }
+            if ((quirks & QUIRK_XOCHIP_OPS) && (instruction & 0xFFF0) == 0x00D0) { instruction_00Dn(chip8, nibble); break; }
+
+            switch (byte) {
+                case 0xE0:
+                    if (quirks & QUIRK_SCHIP_OPS) { instruction_00E0_planes(chip8); } else { instruction_00E0(chip8); }
+                    break;
+                case 0xEE: instruction_00EE(chip8); break;
+                case 0xFB: if (quirks & QUIRK_SCHIP_OPS) { instruction_00FB(chip8); } break;
+                case 0xFC: if (quirks & QUIRK_SCHIP_OPS) { instruction_00FC(chip8); } break;
+                case 0xFD: if (quirks & QUIRK_SCHIP_OPS) { instruction_00FD(chip8); } break;
+                case 0xFE: if (quirks & QUIRK_SCHIP_OPS) { set_resolution(chip8, 0); } break;
+                case 0xFF: if (quirks & QUIRK_SCHIP_OPS) { set_resolution(chip8, 1); } break;
+            }
+            break;
+        case 0x1: instruction_1nnn(chip8, addr); break;
+        case 0x2: instruction_2nnn(chip8, addr); break;
+        case 0x3: instruction_3xkk(chip8, Vx, byte); break;
+        case 0x4: instruction_4xkk(chip8, Vx, byte); break;
+        case 0x5:
+            if ((quirks & QUIRK_XOCHIP_OPS) && nibble == 0x2) {
+                instruction_5xy2(chip8, Vx, Vy);
+            } else if ((quirks & QUIRK_XOCHIP_OPS) && nibble == 0x3) {
+                instruction_5xy3(chip8, Vx, Vy);
+            } else {
+                instruction_5xy0(chip8, Vx, Vy);
+            }
+            break;
+        case 0x6: instruction_6xkk(chip8, Vx, byte); break;
+        case 0x7: instruction_7xkk(chip8, Vx, byte); break;
+        case 0x8:
+            switch (nibble) {
+                case 0x0: instruction_8xy0(chip8, Vx, Vy); break;
+                case 0x1:
+                    instruction_8xy1(chip8, Vx, Vy);
+                    if (quirks & QUIRK_VF_RESET) { chip8->registers[0xF] = 0; }
+                    break;
+                case 0x2:
+                    instruction_8xy2(chip8, Vx, Vy);
+                    if (quirks & QUIRK_VF_RESET) { chip8->registers[0xF] = 0; }
+                    break;
+                case 0x3:
+                    instruction_8xy3(chip8, Vx, Vy);
+                    if (quirks & QUIRK_VF_RESET) { chip8->registers[0xF] = 0; }
+                    break;
+                case 0x4: instruction_8xy4(chip8, Vx, Vy); break;
+                case 0x5: instruction_8xy5(chip8, Vx, Vy); break;
+                case 0x6:
+                    if (quirks & QUIRK_SHIFT_VY) { instruction_8xy6_shift_vy(chip8, Vx, Vy); } else { instruction_8xy6(chip8, Vx, Vy); }
+                    break;
+                case 0x7: instruction_8xy7(chip8, Vx, Vy); break;
+                case 0xE:
+                    if (quirks & QUIRK_SHIFT_VY) { instruction_8xyE_shift_vy(chip8, Vx, Vy); } else { instruction_8xyE(chip8, Vx, Vy); }
+                    break;
+            }
+            break;
+        case 0x9: instruction_9xy0(chip8, Vx, Vy); break;
+        case 0xA: instruction_Annn(chip8, addr); break;
+        case 0xB:
+            if (quirks & QUIRK_JUMP_VX) { instruction_Bxnn(chip8, addr); } else { instruction_Bnnn(chip8, addr); }
+            break;
+        case 0xC: instruction_Cxkk(chip8, Vx, byte); break;
+        case 0xD:
+            if (quirks & QUIRK_SCHIP_OPS) { instruction_Dxyn_planes(chip8, Vx, Vy, nibble, (quirks & QUIRK_CLIP) != 0); break; }
+            if (quirks & QUIRK_CLIP) { instruction_Dxyn_clip(chip8, Vx, Vy, nibble); } else { instruction_Dxyn(chip8, Vx, Vy, nibble); }
+            break;
+        case 0xE:
+            switch (byte) {
+                case 0x9E: instruction_Ex9E(chip8, Vx); break;
+                case 0xA1: instruction_ExA1(chip8, Vx); break;
+            }
+            break;
+        case 0xF:
+            if ((quirks & QUIRK_XOCHIP_OPS) && instruction == 0xF000) { instruction_F000(chip8); break; }
+
+            switch (byte) {
+                case 0x01: if (quirks & QUIRK_XOCHIP_OPS) { instruction_Fn01(chip8, Vx); } break;
+                case 0x02: if ((quirks & QUIRK_XOCHIP_OPS) && Vx == 0) { instruction_F002(chip8); } break;
+                case 0x07: instruction_Fx07(chip8, Vx); break;
+                case 0x0A: instruction_Fx0A(chip8, Vx); break;
+                case 0x15: instruction_Fx15(chip8, Vx); break;
+                case 0x18: instruction_Fx18(chip8, Vx); break;
+                case 0x1E: instruction_Fx1E(chip8, Vx); break;
+                case 0x29: instruction_Fx29(chip8, Vx); break;
+                case 0x30: if (quirks & QUIRK_SCHIP_OPS) { instruction_Fx30(chip8, Vx); } break;
+                case 0x33: instruction_Fx33(chip8, Vx); break;
+                case 0x3A: if (quirks & QUIRK_XOCHIP_OPS) { instruction_Fx3A(chip8, Vx); } break;
+                case 0x55:
+                    instruction_Fx55(chip8, Vx);
+                    step_address_register(chip8, Vx, quirks);
+                    break;
+                case 0x65:
+                    instruction_Fx65(chip8, Vx);
+                    step_address_register(chip8, Vx, quirks);
+                    break;
+                case 0x75: if (quirks & QUIRK_SCHIP_OPS) { instruction_Fx75(chip8, Vx); } break;
+                case 0x85: if (quirks & QUIRK_SCHIP_OPS) { instruction_Fx85(chip8, Vx); } break;
+            }
+            break;
+    }
+
+    if (quirks & QUIRK_XOCHIP_OPS) { skip_long_instruction(chip8, instruction, next); }
+}
+
+static inline void chip8_execute(Chip8* chip8, uint16_t instruction) {
+    chip8_execute_quirks(chip8, instruction, QUIRKS_DEFAULT);
+}
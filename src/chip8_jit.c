@@ -0,0 +1,542 @@
+#include "chip8_jit.h"
+#include "chip8_instructions.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define CHIP8_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#ifdef CHIP8_JIT_SUPPORTED
+
+#define MEMORY_SIZE sizeof(((Chip8*) 0)->memory)
+
+// size of the executable buffer, everything is thrown away when it fills up
+#define CODE_BUFFER_SIZE (4 * 1024 * 1024)
+
+// blocks are cut at this length so a frame (11 instructions) rarely has to fall back to single steps
+#define MAX_BLOCK_INSTRUCTIONS 16
+
+// the most bytes one translated instruction can take, plus the prologue and epilogue
+#define MAX_INSTRUCTION_CODE_SIZE 48
+#define MAX_BLOCK_CODE_SIZE (MAX_BLOCK_INSTRUCTIONS * MAX_INSTRUCTION_CODE_SIZE + 32)
+
+typedef struct Block {
+    const uint8_t* code;
+    uint16_t instructions;
+} Block;
+
+// translated code indexes the block table with a shift
+_Static_assert(sizeof(Block) == 16, "Block has to be 16 bytes");
+
+// enters translated code at `code`, blocks then jump straight into each other until the budget
+// runs out or the next block is not translated yet, returns the remaining budget
+typedef uint64_t (*EnterFunction)(Chip8* chip8, uint64_t remaining, Block* blocks, const uint8_t* code);
+
+struct Chip8Jit {
+    // never writable and executable at once, guest memory writes lead to new translations so the bytes
+    // emitted are partly up to the rom, it is only made writable to translate and executable again to run
+    uint8_t* code;
+    size_t code_used;
+    uint8_t code_writable;
+
+    // the enter and exit stubs sit at the start of the code buffer and survive flushes
+    EnterFunction enter;
+    const uint8_t* exit;
+    size_t stubs_size;
+
+    // indexed by start address, instructions can start on odd addresses through Bnnn
+    Block blocks[MEMORY_SIZE];
+
+    // which bytes of memory have been translated, a write to one of them flushes the cache
+    uint8_t translated[MEMORY_SIZE];
+    uint8_t flush_pending;
+};
+
+static void emit_stubs(Chip8Jit* jit);
+
+Chip8Jit* chip8_jit_create() {
+    Chip8Jit* jit = calloc(1, sizeof(Chip8Jit));
+    if (!jit) {
+        printf("ERROR: Failed to allocate jit!\n");
+        return NULL;
+    }
+
+    jit->code = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        printf("ERROR: Failed to map memory for the jit!\n");
+        free(jit);
+        return NULL;
+    }
+    jit->code_writable = 1;
+
+    emit_stubs(jit);
+
+    return jit;
+}
+
+// flips the code buffer between writable and executable, only when it is not that already
+static int set_code_writable(Chip8Jit* jit, uint8_t writable) {
+    if (jit->code_writable == writable) { return 0; }
+
+    if (mprotect(jit->code, CODE_BUFFER_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) {
+        printf("ERROR: Failed to change the protection of the jit's code!\n");
+        return -1;
+    }
+    jit->code_writable = writable;
+
+    return 0;
+}
+
+void chip8_jit_destroy(Chip8Jit* jit) {
+    if (!jit) { return; }
+
+    munmap(jit->code, CODE_BUFFER_SIZE);
+    free(jit);
+}
+
+void chip8_jit_invalidate_all(Chip8Jit* jit) {
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->translated, 0, sizeof(jit->translated));
+    jit->code_used = jit->stubs_size;
+    jit->flush_pending = 0;
+}
+
+// called from translated code for everything that is not translated inline
+static void jit_execute(Chip8* chip8, uint32_t instruction, Chip8Jit* jit) {
+    uint8_t byte = instruction & 0x00FF;
+
+    if ((instruction >> 12) == 0xF && (byte == 0x33 || byte == 0x55)) {
+        uint16_t size = (byte == 0x33) ? 3 : ((instruction >> 8) & 0x0F) + 1;
+
+        for (uint16_t i = 0; i < size; i++) {
+            if (jit->translated[(chip8->address_register + i) & MEMORY_MASK]) { jit->flush_pending = 1; }
+        }
+    }
+
+    chip8_execute(chip8, (uint16_t) instruction);
+}
+
+// x86-64 code generation, while in translated code rbx holds the chip8, r12 the remaining
+// instruction budget and r13 the block table
+
+static void emit8(Chip8Jit* jit, uint8_t value) {
+    jit->code[jit->code_used++] = value;
+}
+
+static void emit16(Chip8Jit* jit, uint16_t value) {
+    memcpy(&jit->code[jit->code_used], &value, sizeof(value));
+    jit->code_used += sizeof(value);
+}
+
+static void emit32(Chip8Jit* jit, uint32_t value) {
+    memcpy(&jit->code[jit->code_used], &value, sizeof(value));
+    jit->code_used += sizeof(value);
+}
+
+static void emit64(Chip8Jit* jit, uint64_t value) {
+    memcpy(&jit->code[jit->code_used], &value, sizeof(value));
+    jit->code_used += sizeof(value);
+}
+
+// emits `opcode` followed by a modrm for [rbx + offset] with the given reg field
+static void emit_rbx(Chip8Jit* jit, const char* opcode, uint8_t reg, uint32_t offset) {
+    for (const char* byte = opcode; *byte; byte++) { emit8(jit, (uint8_t) *byte); }
+
+    emit8(jit, 0x80 | (reg << 3) | 3);
+    emit32(jit, offset);
+}
+
+// emits `opcode` followed by a 32 bit displacement to `target`
+static void emit_jump(Chip8Jit* jit, const char* opcode, const uint8_t* target) {
+    for (const char* byte = opcode; *byte; byte++) { emit8(jit, (uint8_t) *byte); }
+
+    emit32(jit, (uint32_t) (target - &jit->code[jit->code_used + 4]));
+}
+
+#define JMP "\xE9"
+#define JB "\x0F\x82"
+#define JA "\x0F\x87"
+#define JZ "\x0F\x84"
+
+static void emit_stubs(Chip8Jit* jit) {
+    jit->enter = (EnterFunction) (void*) jit->code;
+    emit8(jit, 0x53);                                     // push rbx
+    emit8(jit, 0x41); emit8(jit, 0x54);                   // push r12
+    emit8(jit, 0x41); emit8(jit, 0x55);                   // push r13
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xFB); // mov rbx, rdi
+    emit8(jit, 0x49); emit8(jit, 0x89); emit8(jit, 0xF4); // mov r12, rsi
+    emit8(jit, 0x49); emit8(jit, 0x89); emit8(jit, 0xD5); // mov r13, rdx
+    emit8(jit, 0xFF); emit8(jit, 0xE1);                   // jmp rcx
+
+    jit->exit = &jit->code[jit->code_used];
+    emit8(jit, 0x4C); emit8(jit, 0x89); emit8(jit, 0xE0); // mov rax, r12
+    emit8(jit, 0x41); emit8(jit, 0x5D);                   // pop r13
+    emit8(jit, 0x41); emit8(jit, 0x5C);                   // pop r12
+    emit8(jit, 0x5B);                                     // pop rbx
+    emit8(jit, 0xC3);                                     // ret
+
+    jit->stubs_size = jit->code_used;
+}
+
+#define REGISTER(index) ((uint32_t) (offsetof(Chip8, registers) + (index)))
+#define FIELD(name) ((uint32_t) offsetof(Chip8, name))
+
+// reg fields
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+#define MOVZX_LOAD "\x0F\xB6"  // movzx r32, byte [rbx + offset]
+#define STORE_BYTE "\x88"      // mov byte [rbx + offset], r8
+#define STORE_WORD "\x66\x89"  // mov word [rbx + offset], r16
+
+static void emit_call_helper(Chip8Jit* jit, uint16_t instruction) {
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xDF);          // mov rdi, rbx
+    emit8(jit, 0xBE); emit32(jit, instruction);                      // mov esi, instruction
+    emit8(jit, 0x48); emit8(jit, 0xBA); emit64(jit, (uint64_t) jit); // mov rdx, jit
+    emit8(jit, 0x48); emit8(jit, 0xB8); emit64(jit, (uint64_t) (uintptr_t) jit_execute); // mov rax, jit_execute
+    emit8(jit, 0xFF); emit8(jit, 0xD0);                              // call rax
+}
+
+// instructions which change or read the program counter, or write memory
+static int is_block_end(uint16_t instruction) {
+    uint8_t byte = instruction & 0x00FF;
+
+    switch (instruction >> 12) {
+        case 0x0: return byte == 0xEE;
+        case 0x1:
+        case 0x2:
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+        case 0xB:
+        case 0xE: return 1;
+        case 0xF: return byte == 0x0A || byte == 0x33 || byte == 0x55;
+    }
+
+    return 0;
+}
+
+// translates what it can inline, returns 0 when the instruction needs the helper
+static int emit_inline(Chip8Jit* jit, uint16_t instruction) {
+    uint8_t Vx = (instruction >> 8) & 0x0F;
+    uint8_t Vy = (instruction >> 4) & 0x0F;
+    uint8_t byte = instruction & 0x00FF;
+
+    switch (instruction >> 12) {
+        case 0x6:
+            emit_rbx(jit, "\xC6", 0, REGISTER(Vx)); emit8(jit, byte); // mov byte [Vx], kk
+            return 1;
+        case 0x7:
+            emit_rbx(jit, "\x80", 0, REGISTER(Vx)); emit8(jit, byte); // add byte [Vx], kk
+            return 1;
+        case 0x8:
+            // the sequences below read the registers again after writing VF, exactly like the handlers
+            switch (instruction & 0x000F) {
+                case 0x0:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vy));
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(Vx));
+                    return 1;
+                case 0x1:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vy));
+                    emit_rbx(jit, "\x08", EAX, REGISTER(Vx)); // or [Vx], al
+                    return 1;
+                case 0x2:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vy));
+                    emit_rbx(jit, "\x20", EAX, REGISTER(Vx)); // and [Vx], al
+                    return 1;
+                case 0x3:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vy));
+                    emit_rbx(jit, "\x30", EAX, REGISTER(Vx)); // xor [Vx], al
+                    return 1;
+                case 0x4:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit_rbx(jit, "\x02", EAX, REGISTER(Vy));     // add al, [Vy]
+                    emit8(jit, 0x0F); emit8(jit, 0x92); emit8(jit, 0xC1); // setc cl
+                    emit_rbx(jit, STORE_BYTE, ECX, REGISTER(0xF));
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(Vx));
+                    return 1;
+                case 0x5:
+                case 0x7: {
+                    // 8xy5 is Vx - Vy, 8xy7 is Vy - Vx
+                    uint8_t left = ((instruction & 0x000F) == 0x5) ? Vx : Vy;
+                    uint8_t right = ((instruction & 0x000F) == 0x5) ? Vy : Vx;
+
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(left));
+                    emit_rbx(jit, "\x3A", EAX, REGISTER(right));   // cmp al, [right]
+                    emit8(jit, 0x0F); emit8(jit, 0x97); emit8(jit, 0xC2); // seta dl
+                    emit_rbx(jit, STORE_BYTE, EDX, REGISTER(0xF));
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(left));
+                    emit_rbx(jit, "\x2A", EAX, REGISTER(right));   // sub al, [right]
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(Vx));
+                    return 1;
+                }
+                case 0x6:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit8(jit, 0x24); emit8(jit, 0x01);              // and al, 1
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(0xF));
+                    emit_rbx(jit, "\xD0", 5, REGISTER(Vx));         // shr byte [Vx], 1
+                    return 1;
+                case 0xE:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit8(jit, 0xC0); emit8(jit, 0xE8); emit8(jit, 0x07); // shr al, 7
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(0xF));
+                    emit_rbx(jit, "\xD0", 4, REGISTER(Vx));         // shl byte [Vx], 1
+                    return 1;
+            }
+            return 0;
+        case 0xA:
+            emit_rbx(jit, "\x66\xC7", 0, FIELD(address_register)); emit16(jit, instruction & 0x0FFF); // mov word [I], nnn
+            return 1;
+        case 0xF:
+            switch (byte) {
+                case 0x07:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, FIELD(delay_timer));
+                    emit_rbx(jit, STORE_BYTE, EAX, REGISTER(Vx));
+                    return 1;
+                case 0x15:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit_rbx(jit, STORE_BYTE, EAX, FIELD(delay_timer));
+                    return 1;
+                case 0x18:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit_rbx(jit, STORE_BYTE, EAX, FIELD(sound_timer));
+                    return 1;
+                case 0x1E:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit_rbx(jit, "\x66\x01", EAX, FIELD(address_register)); // add word [I], ax
+                    return 1;
+                case 0x29:
+                    emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(Vx));
+                    emit8(jit, 0x8D); emit8(jit, 0x04); emit8(jit, 0x80); // lea eax, [rax + rax * 4]
+                    emit_rbx(jit, STORE_WORD, EAX, FIELD(address_register));
+                    return 1;
+            }
+            return 0;
+    }
+
+    return 0;
+}
+
+// emits the program counter update for skips, `next` is the address after the instruction
+// (xor eax, eax has to come before the compare since it clears the flags)
+static void emit_skip(Chip8Jit* jit, uint8_t setcc, uint16_t next) {
+    emit8(jit, 0x0F); emit8(jit, setcc); emit8(jit, 0xC0);               // setcc al
+    emit8(jit, 0x8D); emit8(jit, 0x04); emit8(jit, 0x45); emit32(jit, next); // lea eax, [rax * 2 + next]
+    emit_rbx(jit, STORE_WORD, EAX, FIELD(program_counter));
+}
+
+#define SETE 0x94
+#define SETNE 0x95
+
+// translates the block ending instructions that only touch registers and the stack,
+// returns 0 when the instruction needs the helper
+static int emit_block_end(Chip8Jit* jit, uint16_t instruction, uint16_t next) {
+    uint8_t Vx = (instruction >> 8) & 0x0F;
+    uint8_t Vy = (instruction >> 4) & 0x0F;
+    uint8_t byte = instruction & 0x00FF;
+    uint16_t addr = instruction & 0x0FFF;
+
+    switch (instruction >> 12) {
+        case 0x0:
+            if (byte != 0xEE) { return 0; }
+            emit_rbx(jit, "\xFE", 1, FIELD(stack_pointer));                 // dec byte [sp]
+            emit_rbx(jit, MOVZX_LOAD, EAX, FIELD(stack_pointer));
+            emit8(jit, 0x0F); emit8(jit, 0xB7); emit8(jit, 0x84); emit8(jit, 0x43); // movzx eax, word [rbx + rax * 2 + stack]
+            emit32(jit, FIELD(stack));
+            emit_rbx(jit, STORE_WORD, EAX, FIELD(program_counter));
+            return 1;
+        case 0x1:
+            emit_rbx(jit, "\x66\xC7", 0, FIELD(program_counter)); emit16(jit, addr);
+            return 1;
+        case 0x2:
+            emit_rbx(jit, MOVZX_LOAD, EAX, FIELD(stack_pointer));
+            emit8(jit, 0x66); emit8(jit, 0xC7); emit8(jit, 0x84); emit8(jit, 0x43); // mov word [rbx + rax * 2 + stack], next
+            emit32(jit, FIELD(stack)); emit16(jit, next);
+            emit_rbx(jit, "\xFE", 0, FIELD(stack_pointer));                 // inc byte [sp]
+            emit_rbx(jit, "\x66\xC7", 0, FIELD(program_counter)); emit16(jit, addr);
+            return 1;
+        case 0x3:
+        case 0x4:
+            emit8(jit, 0x31); emit8(jit, 0xC0);                               // xor eax, eax
+            emit_rbx(jit, "\x80", 7, REGISTER(Vx)); emit8(jit, byte);         // cmp byte [Vx], kk
+            emit_skip(jit, ((instruction >> 12) == 0x3) ? SETE : SETNE, next);
+            return 1;
+        case 0x5:
+        case 0x9:
+            emit8(jit, 0x31); emit8(jit, 0xC0);                               // xor eax, eax
+            emit_rbx(jit, MOVZX_LOAD, ECX, REGISTER(Vx));
+            emit_rbx(jit, "\x3A", ECX, REGISTER(Vy));                          // cmp cl, [Vy]
+            emit_skip(jit, ((instruction >> 12) == 0x5) ? SETE : SETNE, next);
+            return 1;
+        case 0xB:
+            emit_rbx(jit, MOVZX_LOAD, EAX, REGISTER(0));
+            emit8(jit, 0x05); emit32(jit, addr);                               // add eax, nnn
+            emit_rbx(jit, STORE_WORD, EAX, FIELD(program_counter));
+            return 1;
+    }
+
+    return 0;
+}
+
+// NULL if the code buffer can not be written
+static Block* translate(Chip8Jit* jit, const Chip8* chip8, uint16_t start) {
+    if (set_code_writable(jit, 1) != 0) { return NULL; }
+    if (jit->code_used + MAX_BLOCK_CODE_SIZE > CODE_BUFFER_SIZE) { chip8_jit_invalidate_all(jit); }
+
+    // the instruction count is only known at the end, so the budget check is patched in afterwards
+    size_t block_offset = jit->code_used;
+    Block* block = &jit->blocks[start];
+    block->code = &jit->code[block_offset];
+    block->instructions = 0;
+
+    emit8(jit, 0x49); emit8(jit, 0x83); emit8(jit, 0xFC); emit8(jit, 0); // cmp r12, instructions
+    emit_jump(jit, JB, jit->exit);
+    emit8(jit, 0x49); emit8(jit, 0x83); emit8(jit, 0xEC); emit8(jit, 0); // sub r12, instructions
+
+    uint16_t address = start;
+    int ended = 0;
+    int writes_memory = 0;
+    while (!ended && block->instructions < MAX_BLOCK_INSTRUCTIONS && address < MEMORY_SIZE - 1) {
+        uint16_t instruction = (chip8->memory[address] << 8) | chip8->memory[address + 1];
+        jit->translated[address] = 1;
+        jit->translated[address + 1] = 1;
+        address += 2;
+        block->instructions++;
+
+        if (is_block_end(instruction)) {
+            if (!emit_block_end(jit, instruction, address)) {
+                // the handler expects the program counter to point past the instruction
+                emit_rbx(jit, "\x66\xC7", 0, FIELD(program_counter)); emit16(jit, address);
+                emit_call_helper(jit, instruction);
+            }
+            ended = 1;
+            writes_memory = (instruction & 0xF0FF) == 0xF033 || (instruction & 0xF0FF) == 0xF055;
+        } else if (!emit_inline(jit, instruction)) {
+            emit_call_helper(jit, instruction);
+        }
+    }
+
+    if (!ended) {
+        emit_rbx(jit, "\x66\xC7", 0, FIELD(program_counter)); emit16(jit, address);
+    }
+
+    jit->code[block_offset + 3] = (uint8_t) block->instructions;
+    jit->code[block_offset + 13] = (uint8_t) block->instructions;
+
+    // after a memory write go back to check whether the cache has to be flushed,
+    // otherwise jump straight into the next block when it is already translated
+    if (writes_memory) {
+        emit_jump(jit, JMP, jit->exit);
+    } else {
+        emit_rbx(jit, "\x0F\xB7", EAX, FIELD(program_counter));                 // movzx eax, word [pc]
+        emit8(jit, 0x3D); emit32(jit, MEMORY_SIZE - 2);                          // cmp eax, last address
+        emit_jump(jit, JA, jit->exit);
+        emit8(jit, 0xC1); emit8(jit, 0xE0); emit8(jit, 0x04);                    // shl eax, 4
+        emit8(jit, 0x49); emit8(jit, 0x8B); emit8(jit, 0x44); emit8(jit, 0x05); emit8(jit, 0x00); // mov rax, [r13 + rax]
+        emit8(jit, 0x48); emit8(jit, 0x85); emit8(jit, 0xC0);                    // test rax, rax
+        emit_jump(jit, JZ, jit->exit);
+        emit8(jit, 0xFF); emit8(jit, 0xE0);                                      // jmp rax
+    }
+
+    return block;
+}
+
+// a single instruction through the helper, used when a block does not fit in the remaining budget
+static void step(Chip8Jit* jit, Chip8* chip8) {
+    jit_execute(chip8, fetch_instruction(chip8), jit);
+    if (jit->flush_pending) { chip8_jit_invalidate_all(jit); }
+}
+
+#define COMPARE_FIELD(name) \
+    if (memcmp(&jit_state->name, &reference->name, sizeof(reference->name)) != 0) { \
+        printf("ERROR: jit and interpreter disagree on " #name " after the block at %03X!\n", block_start); \
+        return -1; \
+    }
+
+static int compare_state(const Chip8* jit_state, const Chip8* reference, uint16_t block_start) {
+    COMPARE_FIELD(memory);
+    COMPARE_FIELD(program_loaded);
+    COMPARE_FIELD(registers);
+    COMPARE_FIELD(program_counter);
+    COMPARE_FIELD(address_register);
+    COMPARE_FIELD(delay_timer);
+    COMPARE_FIELD(sound_timer);
+    COMPARE_FIELD(stack);
+    COMPARE_FIELD(stack_pointer);
+    COMPARE_FIELD(display);
+    COMPARE_FIELD(keypad);
+    COMPARE_FIELD(random_state);
+
+    return 0;
+}
+
+// runs blocks until the budget is used up, stepping `reference` along with chip8_update when given
+static int run(Chip8Jit* jit, Chip8* chip8, uint64_t instructions, Chip8* reference) {
+    if (!chip8->program_loaded) { return 0; }
+
+    uint64_t remaining = instructions;
+    while (remaining > 0) {
+        uint16_t program_counter = chip8->program_counter;
+
+        Block* block = NULL;
+        if (program_counter < MEMORY_SIZE - 1) {
+            block = jit->blocks[program_counter].code ? &jit->blocks[program_counter] : translate(jit, chip8, program_counter);
+        }
+
+        uint64_t executed;
+        if (block && block->instructions <= remaining && set_code_writable(jit, 0) == 0) {
+            // when verifying only one block runs at a time, the next budget check always fails
+            uint64_t budget = reference ? block->instructions : remaining;
+            executed = budget - jit->enter(chip8, budget, jit->blocks, block->code);
+
+            if (jit->flush_pending) { chip8_jit_invalidate_all(jit); }
+        } else {
+            step(jit, chip8);
+            executed = 1;
+        }
+
+        remaining -= executed;
+
+        if (reference) {
+            for (uint64_t i = 0; i < executed; i++) {
+                chip8_update(reference);
+            }
+
+            if (compare_state(chip8, reference, program_counter) != 0) { return -1; }
+        }
+    }
+
+    return 0;
+}
+
+void chip8_jit_run(Chip8Jit* jit, Chip8* chip8, uint64_t instructions) {
+    run(jit, chip8, instructions, NULL);
+}
+
+int chip8_jit_verify(Chip8Jit* jit, Chip8* chip8, uint64_t instructions) {
+    Chip8 reference = *chip8;
+
+    return run(jit, chip8, instructions, &reference);
+}
+
+#else
+
+Chip8Jit* chip8_jit_create() {
+    printf("ERROR: The jit is only supported on x86-64!\n");
+    return NULL;
+}
+
+void chip8_jit_destroy(Chip8Jit* jit) {}
+void chip8_jit_invalidate_all(Chip8Jit* jit) {}
+void chip8_jit_run(Chip8Jit* jit, Chip8* chip8, uint64_t instructions) {}
+int chip8_jit_verify(Chip8Jit* jit, Chip8* chip8, uint64_t instructions) { return -1; }
+
+#endif
@@ -0,0 +1,364 @@
+#include "chip8_pool.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct PoolWorker {
+    pthread_t thread;
+    struct Chip8Pool* pool;
+    uint32_t index;
+
+    // instance indices waiting to run, the owner works at the tail and thieves take from the head
+    pthread_mutex_t lock;
+    uint32_t* tasks;
+    uint32_t head;
+    uint32_t tail;
+
+    // for picking steal victims
+    uint32_t random_state;
+} PoolWorker;
+
+struct Chip8Pool {
+    Chip8PoolInstance* instances;
+    uint32_t instance_count;
+
+    PoolWorker* workers;
+    uint32_t thread_count;
+
+    // the current run
+    uint64_t chunk_frames;
+    atomic_uint pending; // instances with frames left
+
+    // workers with nothing to run or steal sleep here until a queue has a task to spare or the run is over
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_condition;
+    atomic_uint idle_workers;
+
+    // workers sleep between runs, every run bumps the generation
+    pthread_mutex_t control_lock;
+    pthread_cond_t start_condition;
+    pthread_cond_t done_condition;
+    uint64_t generation;
+    uint32_t finished_workers;
+    int shutting_down;
+};
+
+static double get_time_seconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+static int pop_task(PoolWorker* worker) {
+    int task = -1;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail > worker->head) { task = (int) worker->tasks[--worker->tail]; }
+    pthread_mutex_unlock(&worker->lock);
+
+    return task;
+}
+
+static int steal_task(PoolWorker* worker) {
+    Chip8Pool* pool = worker->pool;
+
+    // start at a random victim so thieves spread out
+    worker->random_state ^= worker->random_state << 13;
+    worker->random_state ^= worker->random_state >> 17;
+    worker->random_state ^= worker->random_state << 5;
+    uint32_t first = worker->random_state % pool->thread_count;
+
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        PoolWorker* victim = &pool->workers[(first + i) % pool->thread_count];
+        if (victim == worker) { continue; }
+
+        int task = -1;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tail > victim->head) { task = (int) victim->tasks[victim->head++]; }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (task >= 0) { return task; }
+    }
+
+    return -1;
+}
+
+static void push_task(PoolWorker* worker, uint32_t task) {
+    pthread_mutex_lock(&worker->lock);
+
+    // every instance is queued at most once, so moving the queue to the front always makes room
+    if (worker->tail == worker->pool->instance_count) {
+        memmove(worker->tasks, &worker->tasks[worker->head], (worker->tail - worker->head) * sizeof(uint32_t));
+        worker->tail -= worker->head;
+        worker->head = 0;
+    }
+
+    worker->tasks[worker->tail++] = task;
+    uint32_t queued = worker->tail - worker->head;
+    pthread_mutex_unlock(&worker->lock);
+
+    // the owner takes a lone task straight back, only a second one is worth waking a thief for
+    if (queued > 1 && atomic_load(&worker->pool->idle_workers) > 0) {
+        pthread_mutex_lock(&worker->pool->idle_lock);
+        pthread_cond_signal(&worker->pool->idle_condition);
+        pthread_mutex_unlock(&worker->pool->idle_lock);
+    }
+}
+
+static int has_tasks(Chip8Pool* pool) {
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        PoolWorker* worker = &pool->workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+        int queued = worker->tail > worker->head;
+        pthread_mutex_unlock(&worker->lock);
+
+        if (queued) { return 1; }
+    }
+
+    return 0;
+}
+
+// the instances still running are in other workers' hands, so sleep instead of spinning through the tail of the run
+static void wait_for_tasks(Chip8Pool* pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+
+    // counted before looking, so a task pushed after the look always signals
+    atomic_fetch_add(&pool->idle_workers, 1);
+    while (atomic_load(&pool->pending) > 0 && !has_tasks(pool)) {
+        pthread_cond_wait(&pool->idle_condition, &pool->idle_lock);
+    }
+    atomic_fetch_sub(&pool->idle_workers, 1);
+
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+static void run_chunk(Chip8Pool* pool, Chip8PoolInstance* instance) {
+    uint64_t frames = (instance->frames_left < pool->chunk_frames) ? instance->frames_left : pool->chunk_frames;
+
+    double start_time = get_time_seconds();
+    for (uint64_t i = 0; i < frames; i++) {
+        chip8_engine_run_frame(instance->engine, &instance->chip8);
+    }
+    instance->seconds += get_time_seconds() - start_time;
+
+    instance->instructions += frames * CHIP8_INSTRUCTIONS_PER_FRAME;
+    instance->frames_left -= frames;
+}
+
+static void work(PoolWorker* worker) {
+    Chip8Pool* pool = worker->pool;
+
+    while (atomic_load(&pool->pending) > 0) {
+        int task = pop_task(worker);
+        if (task < 0) { task = steal_task(worker); }
+        if (task < 0) {
+            wait_for_tasks(pool);
+            continue;
+        }
+
+        Chip8PoolInstance* instance = &pool->instances[task];
+        run_chunk(pool, instance);
+
+        if (instance->frames_left > 0) {
+            push_task(worker, (uint32_t) task);
+        } else if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+            // the last instance is done, nobody is left to push tasks so every sleeper has to go
+            pthread_mutex_lock(&pool->idle_lock);
+            pthread_cond_broadcast(&pool->idle_condition);
+            pthread_mutex_unlock(&pool->idle_lock);
+        }
+    }
+}
+
+static void* worker_main(void* data) {
+    PoolWorker* worker = data;
+    Chip8Pool* pool = worker->pool;
+    uint64_t seen_generation = 0;
+
+    pthread_mutex_lock(&pool->control_lock);
+    while (1) {
+        while (pool->generation == seen_generation && !pool->shutting_down) {
+            pthread_cond_wait(&pool->start_condition, &pool->control_lock);
+        }
+        if (pool->shutting_down) { break; }
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->control_lock);
+
+        work(worker);
+
+        pthread_mutex_lock(&pool->control_lock);
+        pool->finished_workers++;
+        pthread_cond_signal(&pool->done_condition);
+    }
+    pthread_mutex_unlock(&pool->control_lock);
+
+    return NULL;
+}
+
+Chip8Pool* chip8_pool_create(uint32_t instance_count, uint32_t thread_count, Chip8EngineType engine_type) {
+    if (engine_type == CHIP8_ENGINE_JIT) {
+        printf("ERROR: The pool does not support the jit engine!\n");
+        return NULL;
+    }
+
+    if (thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cores > 0) ? (uint32_t) cores : 1;
+    }
+
+    Chip8Pool* pool = calloc(1, sizeof(Chip8Pool));
+    if (!pool) {
+        printf("ERROR: Failed to allocate pool!\n");
+        return NULL;
+    }
+
+    pool->instance_count = instance_count;
+    pool->thread_count = thread_count;
+
+    size_t instances_size = instance_count * sizeof(Chip8PoolInstance);
+    pool->instances = aligned_alloc(CHIP8_POOL_CACHE_LINE, instances_size);
+    pool->workers = calloc(thread_count, sizeof(PoolWorker));
+    if (!pool->instances || !pool->workers) {
+        printf("ERROR: Failed to allocate pool instances!\n");
+        free(pool->instances);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->control_lock, NULL);
+    pthread_cond_init(&pool->start_condition, NULL);
+    pthread_cond_init(&pool->done_condition, NULL);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_condition, NULL);
+
+    memset(pool->instances, 0, instances_size);
+    for (uint32_t i = 0; i < instance_count; i++) {
+        pool->instances[i].chip8 = chip8_create();
+
+        pool->instances[i].engine = chip8_engine_create(engine_type);
+        if (!pool->instances[i].engine) {
+            pool->instance_count = i;
+            pool->thread_count = 0;
+            chip8_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        PoolWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->random_state = 0x9E3779B9u * (i + 1);
+        worker->tasks = malloc((instance_count ? instance_count : 1) * sizeof(uint32_t));
+        pthread_mutex_init(&worker->lock, NULL);
+
+        if (!worker->tasks || pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            printf("ERROR: Failed to start pool worker!\n");
+            free(worker->tasks);
+            pool->thread_count = i;
+            chip8_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void chip8_pool_destroy(Chip8Pool* pool) {
+    if (!pool) { return; }
+
+    pthread_mutex_lock(&pool->control_lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->start_condition);
+    pthread_mutex_unlock(&pool->control_lock);
+
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].tasks);
+    }
+
+    for (uint32_t i = 0; i < pool->instance_count; i++) {
+        chip8_engine_destroy(pool->instances[i].engine);
+    }
+
+    pthread_mutex_destroy(&pool->control_lock);
+    pthread_cond_destroy(&pool->start_condition);
+    pthread_cond_destroy(&pool->done_condition);
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_condition);
+
+    free(pool->instances);
+    free(pool->workers);
+    free(pool);
+}
+
+uint32_t chip8_pool_instance_count(const Chip8Pool* pool) {
+    return pool->instance_count;
+}
+
+uint32_t chip8_pool_thread_count(const Chip8Pool* pool) {
+    return pool->thread_count;
+}
+
+Chip8PoolInstance* chip8_pool_get(Chip8Pool* pool, uint32_t index) {
+    return &pool->instances[index];
+}
+
+void chip8_pool_load(Chip8Pool* pool, const Chip8* chip8, uint64_t seed) {
+    for (uint32_t i = 0; i < pool->instance_count; i++) {
+        Chip8PoolInstance* instance = &pool->instances[i];
+
+        instance->chip8 = *chip8;
+        chip8_seed(&instance->chip8, seed + i);
+
+        // the instances run on several threads at once, they cannot share a profile
+        instance->chip8.profile = NULL;
+
+        chip8_engine_reset(instance->engine);
+    }
+}
+
+double chip8_pool_run(Chip8Pool* pool, uint64_t frames, uint64_t chunk_frames) {
+    if (pool->instance_count == 0 || frames == 0) { return 0.0; }
+
+    pool->chunk_frames = chunk_frames ? chunk_frames : 1;
+
+    // deal the instances out evenly, stealing evens out whatever imbalance is left
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        pool->workers[i].head = 0;
+        pool->workers[i].tail = 0;
+    }
+
+    for (uint32_t i = 0; i < pool->instance_count; i++) {
+        pool->instances[i].frames_left = frames;
+
+        PoolWorker* worker = &pool->workers[i % pool->thread_count];
+        worker->tasks[worker->tail++] = i;
+    }
+
+    atomic_store(&pool->pending, pool->instance_count);
+
+    double start_time = get_time_seconds();
+
+    pthread_mutex_lock(&pool->control_lock);
+    pool->finished_workers = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_condition);
+
+    while (pool->finished_workers < pool->thread_count) {
+        pthread_cond_wait(&pool->done_condition, &pool->control_lock);
+    }
+    pthread_mutex_unlock(&pool->control_lock);
+
+    return get_time_seconds() - start_time;
+}
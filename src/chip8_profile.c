@@ -0,0 +1,344 @@
+#include "chip8_profile.h"
+#include "chip8_trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODE_CAPACITY 64
+
+// past this many call stacks new calls are counted on the caller, recursive roms would grow the tree forever
+#define MAX_NODES (1u << 16)
+
+// how many of the hottest addresses the json report disassembles
+#define HOT_ADDRESSES 32
+
+static const char* opcode_class_names[CHIP8_OPCODE_CLASS_COUNT] = {
+    "00E0", "00EE",
+    "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+    "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE",
+    "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1",
+    "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65",
+    "00Cn", "00Dn", "00FB", "00FC", "00FD", "00FE", "00FF", "5xy2", "5xy3",
+    "F000", "Fn01", "F002", "Fx30", "Fx3A", "Fx75", "Fx85",
+    "unknown",
+};
+
+// a rough split of the handlers by which part of the emulator they keep busy
+static const struct {
+    const char* name;
+    uint64_t classes; // bit per Chip8OpcodeClass
+} categories[] = {
+    {"draw", (1ull << CHIP8_OP_00E0) | (1ull << CHIP8_OP_Dxyn) | (1ull << CHIP8_OP_00Cn) | (1ull << CHIP8_OP_00Dn) | (1ull << CHIP8_OP_00FB) |
+             (1ull << CHIP8_OP_00FC) | (1ull << CHIP8_OP_00FE) | (1ull << CHIP8_OP_00FF) | (1ull << CHIP8_OP_Fn01)},
+    {"alu", (1ull << CHIP8_OP_6xkk) | (1ull << CHIP8_OP_7xkk) | (1ull << CHIP8_OP_8xy0) | (1ull << CHIP8_OP_8xy1) | (1ull << CHIP8_OP_8xy2) |
+            (1ull << CHIP8_OP_8xy3) | (1ull << CHIP8_OP_8xy4) | (1ull << CHIP8_OP_8xy5) | (1ull << CHIP8_OP_8xy6) | (1ull << CHIP8_OP_8xy7) |
+            (1ull << CHIP8_OP_8xyE) | (1ull << CHIP8_OP_Cxkk) | (1ull << CHIP8_OP_Fx33)},
+    {"memory", (1ull << CHIP8_OP_Annn) | (1ull << CHIP8_OP_Fx1E) | (1ull << CHIP8_OP_Fx29) | (1ull << CHIP8_OP_Fx55) | (1ull << CHIP8_OP_Fx65) |
+               (1ull << CHIP8_OP_5xy2) | (1ull << CHIP8_OP_5xy3) | (1ull << CHIP8_OP_F000) | (1ull << CHIP8_OP_Fx30) | (1ull << CHIP8_OP_Fx75) |
+               (1ull << CHIP8_OP_Fx85)},
+    {"flow", (1ull << CHIP8_OP_00EE) | (1ull << CHIP8_OP_1nnn) | (1ull << CHIP8_OP_2nnn) | (1ull << CHIP8_OP_3xkk) | (1ull << CHIP8_OP_4xkk) |
+             (1ull << CHIP8_OP_5xy0) | (1ull << CHIP8_OP_9xy0) | (1ull << CHIP8_OP_Bnnn) | (1ull << CHIP8_OP_00FD)},
+    {"timers", (1ull << CHIP8_OP_Fx07) | (1ull << CHIP8_OP_Fx15) | (1ull << CHIP8_OP_Fx18) | (1ull << CHIP8_OP_F002) | (1ull << CHIP8_OP_Fx3A)},
+    {"input", (1ull << CHIP8_OP_Ex9E) | (1ull << CHIP8_OP_ExA1) | (1ull << CHIP8_OP_Fx0A)},
+    {"unknown", 1ull << CHIP8_OP_UNKNOWN},
+};
+
+static inline uint32_t child_slot(uint32_t parent, uint16_t address, uint32_t mask) {
+    uint32_t hash = (parent * 0x9E3779B1u) ^ (address * 0x85EBCA6Bu);
+    return (hash ^ (hash >> 15)) & mask;
+}
+
+// the children table always has twice as many slots as there are nodes, so it never fills
+static int grow(Chip8Profile* profile, uint32_t capacity) {
+    Chip8ProfileNode* nodes = realloc(profile->nodes, capacity * sizeof(Chip8ProfileNode));
+    if (!nodes) { return -1; }
+    profile->nodes = nodes;
+
+    uint32_t* children = calloc(capacity * 2, sizeof(uint32_t));
+    if (!children) { return -1; }
+
+    uint32_t mask = capacity * 2 - 1;
+    for (uint32_t i = 1; i < profile->node_count; i++) {
+        uint32_t slot = child_slot(nodes[i].parent, nodes[i].address, mask);
+        while (children[slot]) { slot = (slot + 1) & mask; }
+        children[slot] = i + 1;
+    }
+
+    free(profile->children);
+    profile->children = children;
+    profile->node_capacity = capacity;
+
+    return 0;
+}
+
+Chip8Profile* chip8_profile_create() {
+    Chip8Profile* profile = calloc(1, sizeof(Chip8Profile));
+    if (!profile) {
+        printf("ERROR: Failed to allocate profile!\n");
+        return NULL;
+    }
+
+    if (grow(profile, INITIAL_NODE_CAPACITY) != 0) {
+        printf("ERROR: Failed to allocate profile call tree!\n");
+        chip8_profile_destroy(profile);
+        return NULL;
+    }
+
+    chip8_profile_clear(profile);
+
+    return profile;
+}
+
+void chip8_profile_destroy(Chip8Profile* profile) {
+    if (!profile) { return; }
+
+    free(profile->nodes);
+    free(profile->children);
+    free(profile);
+}
+
+void chip8_profile_clear(Chip8Profile* profile) {
+    profile->instructions = 0;
+    memset(profile->opcode_counts, 0, sizeof(profile->opcode_counts));
+    memset(profile->address_counts, 0, sizeof(profile->address_counts));
+
+    profile->nodes[0] = (Chip8ProfileNode) {.address = 0x200, .parent = 0, .calls = 1, .instructions = 0};
+    profile->node_count = 1;
+    profile->current = 0;
+    profile->overflow_depth = 0;
+    memset(profile->children, 0, profile->node_capacity * 2 * sizeof(uint32_t));
+
+    profile->frames = 0;
+    profile->frame_seconds = 0.0;
+    profile->max_frame_seconds = 0.0;
+    memset(profile->frame_buckets, 0, sizeof(profile->frame_buckets));
+}
+
+void chip8_profile_call(Chip8Profile* profile, uint16_t address) {
+    // still inside a call that did not get its own node
+    if (profile->overflow_depth) {
+        profile->overflow_depth++;
+        return;
+    }
+
+    uint32_t mask = profile->node_capacity * 2 - 1;
+    uint32_t slot = child_slot(profile->current, address, mask);
+    while (profile->children[slot]) {
+        Chip8ProfileNode* node = &profile->nodes[profile->children[slot] - 1];
+        if (node->parent == profile->current && node->address == address) {
+            node->calls++;
+            profile->current = profile->children[slot] - 1;
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    if (profile->node_count == profile->node_capacity) {
+        if (profile->node_capacity == MAX_NODES || grow(profile, profile->node_capacity * 2) != 0) {
+            profile->overflow_depth = 1;
+            return;
+        }
+
+        mask = profile->node_capacity * 2 - 1;
+        slot = child_slot(profile->current, address, mask);
+        while (profile->children[slot]) { slot = (slot + 1) & mask; }
+    }
+
+    uint32_t index = profile->node_count++;
+    profile->nodes[index] = (Chip8ProfileNode) {.address = address, .parent = profile->current, .calls = 1, .instructions = 0};
+    profile->children[slot] = index + 1;
+    profile->current = index;
+}
+
+void chip8_profile_return(Chip8Profile* profile) {
+    if (profile->overflow_depth) {
+        profile->overflow_depth--;
+        return;
+    }
+
+    // a return without a call stays in the program, the rom's stack underflows anyway
+    profile->current = profile->nodes[profile->current].parent;
+}
+
+void chip8_profile_add_frame(Chip8Profile* profile, double seconds) {
+    profile->frames++;
+    profile->frame_seconds += seconds;
+    if (seconds > profile->max_frame_seconds) { profile->max_frame_seconds = seconds; }
+
+    uint64_t microseconds = (uint64_t) (seconds * 1e6);
+    int bucket = 0;
+    while (microseconds > 1 && bucket < 31) {
+        microseconds >>= 1;
+        bucket++;
+    }
+
+    profile->frame_buckets[bucket]++;
+}
+
+const char* chip8_opcode_class_name(Chip8OpcodeClass opcode_class) {
+    return opcode_class_names[opcode_class];
+}
+
+// the HOT_ADDRESSES most executed addresses, most executed first, returns how many were found
+static int hottest_addresses(const Chip8Profile* profile, uint16_t* hottest) {
+    int count = 0;
+
+    for (uint32_t address = 0; address < 4096; address++) {
+        if (!profile->address_counts[address]) { continue; }
+
+        // insertion into the sorted list, it is short
+        int position = count;
+        while (position > 0 && profile->address_counts[address] > profile->address_counts[hottest[position - 1]]) {
+            if (position < HOT_ADDRESSES) { hottest[position] = hottest[position - 1]; }
+            position--;
+        }
+
+        if (position < HOT_ADDRESSES) {
+            hottest[position] = address;
+            if (count < HOT_ADDRESSES) { count++; }
+        }
+    }
+
+    return count;
+}
+
+// the frame names used in both outputs, "main" for the program and "sub_0ABC" for subroutines
+static void node_name(const Chip8Profile* profile, uint32_t index, char* buffer, size_t size) {
+    if (index == 0) {
+        snprintf(buffer, size, "main");
+    } else {
+        snprintf(buffer, size, "sub_%04X", profile->nodes[index].address);
+    }
+}
+
+int chip8_profile_save_json(const Chip8Profile* profile, const Chip8* chip8, const char* file) {
+    FILE* profile_file = fopen(file, "w");
+    if (!profile_file) {
+        printf("ERROR: Failed to open profile file!\n");
+        return -1;
+    }
+
+    fprintf(profile_file, "{\n  \"instructions\": %llu,\n", (unsigned long long) profile->instructions);
+
+    fprintf(profile_file, "  \"opcodes\": {");
+    int first = 1;
+    for (int i = 0; i < CHIP8_OPCODE_CLASS_COUNT; i++) {
+        if (!profile->opcode_counts[i]) { continue; }
+
+        fprintf(profile_file, "%s\n    \"%s\": %llu", first ? "" : ",", opcode_class_names[i], (unsigned long long) profile->opcode_counts[i]);
+        first = 0;
+    }
+    fprintf(profile_file, "%s},\n", first ? "" : "\n  ");
+
+    fprintf(profile_file, "  \"categories\": {");
+    for (int i = 0; i < (int) (sizeof(categories) / sizeof(categories[0])); i++) {
+        uint64_t count = 0;
+        for (int j = 0; j < CHIP8_OPCODE_CLASS_COUNT; j++) {
+            if (categories[i].classes & (1ull << j)) { count += profile->opcode_counts[j]; }
+        }
+
+        double share = profile->instructions ? (double) count / (double) profile->instructions : 0.0;
+        fprintf(profile_file, "%s\n    \"%s\": {\"count\": %llu, \"share\": %.4f}", i ? "," : "", categories[i].name, (unsigned long long) count, share);
+    }
+    fprintf(profile_file, "\n  },\n");
+
+    uint16_t hottest[HOT_ADDRESSES];
+    int hot_count = hottest_addresses(profile, hottest);
+
+    fprintf(profile_file, "  \"hot_addresses\": [");
+    for (int i = 0; i < hot_count; i++) {
+        uint16_t address = hottest[i];
+        uint16_t opcode = (chip8->memory[address] << 8) | chip8->memory[(address + 1) & 0xFFF];
+
+        char mnemonic[32];
+        chip8_disassemble(opcode, mnemonic, sizeof(mnemonic));
+
+        fprintf(profile_file, "%s\n    {\"address\": \"%04X\", \"opcode\": \"%04X\", \"mnemonic\": \"%s\", \"count\": %llu}",
+                i ? "," : "", address, opcode, mnemonic, (unsigned long long) profile->address_counts[address]);
+    }
+    fprintf(profile_file, "%s],\n", hot_count ? "\n  " : "");
+
+    // every executed address, as a sparse histogram
+    fprintf(profile_file, "  \"addresses\": {");
+    first = 1;
+    for (uint32_t address = 0; address < 4096; address++) {
+        if (!profile->address_counts[address]) { continue; }
+
+        fprintf(profile_file, "%s\"%04X\": %llu", first ? "" : ", ", address, (unsigned long long) profile->address_counts[address]);
+        first = 0;
+    }
+    fprintf(profile_file, "},\n");
+
+    // the calling context tree, parents always come before their children
+    fprintf(profile_file, "  \"calls\": [");
+    for (uint32_t i = 0; i < profile->node_count; i++) {
+        const Chip8ProfileNode* node = &profile->nodes[i];
+
+        char name[16];
+        node_name(profile, i, name, sizeof(name));
+
+        fprintf(profile_file, "%s\n    {\"id\": %u, \"parent\": %d, \"name\": \"%s\", \"address\": \"%04X\", \"calls\": %llu, \"instructions\": %llu}",
+                i ? "," : "", i, i ? (int) node->parent : -1, name, node->address,
+                (unsigned long long) node->calls, (unsigned long long) node->instructions);
+    }
+    fprintf(profile_file, "\n  ],\n");
+
+    double average = profile->frames ? profile->frame_seconds / (double) profile->frames : 0.0;
+    fprintf(profile_file, "  \"frames\": {\"count\": %llu, \"average_us\": %.3f, \"max_us\": %.3f, \"histogram_us\": {",
+            (unsigned long long) profile->frames, average * 1e6, profile->max_frame_seconds * 1e6);
+    first = 1;
+    for (int i = 0; i < 32; i++) {
+        if (!profile->frame_buckets[i]) { continue; }
+
+        fprintf(profile_file, "%s\"%llu\": %llu", first ? "" : ", ", i ? 1ull << i : 0ull, (unsigned long long) profile->frame_buckets[i]);
+        first = 0;
+    }
+    fprintf(profile_file, "}}\n}\n");
+
+    int result = ferror(profile_file) ? -1 : 0;
+    fclose(profile_file);
+
+    return result;
+}
+
+int chip8_profile_save_stacks(const Chip8Profile* profile, const char* file) {
+    FILE* stacks_file = fopen(file, "w");
+    if (!stacks_file) {
+        printf("ERROR: Failed to open stacks file!\n");
+        return -1;
+    }
+
+    // the rom's stack is 16 deep, but the tree is walked from the node up so any depth works
+    uint32_t* path = malloc(profile->node_count * sizeof(uint32_t));
+    if (!path) {
+        printf("ERROR: Failed to allocate stack path!\n");
+        fclose(stacks_file);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < profile->node_count; i++) {
+        if (!profile->nodes[i].instructions) { continue; }
+
+        uint32_t depth = 0;
+        for (uint32_t node = i; node != 0; node = profile->nodes[node].parent) { path[depth++] = node; }
+        path[depth++] = 0;
+
+        while (depth > 0) {
+            char name[16];
+            node_name(profile, path[--depth], name, sizeof(name));
+            fprintf(stacks_file, "%s%c", name, depth ? ';' : ' ');
+        }
+
+        fprintf(stacks_file, "%llu\n", (unsigned long long) profile->nodes[i].instructions);
+    }
+
+    free(path);
+
+    int result = ferror(stacks_file) ? -1 : 0;
+    fclose(stacks_file);
+
+    return result;
+}
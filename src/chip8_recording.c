@@ -0,0 +1,273 @@
+#include "chip8_recording.h"
+#include "chip8_endian.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORDING_FILE_MAGIC "C8IR"
+#define RECORDING_FILE_VERSION 3
+#define RECORDING_HEADER_SIZE 52
+
+// version 1 had no clock and always ran at the default rate, version 2 no quirks and always ran the default ones
+#define RECORDING_V1_HEADER_SIZE 40
+#define RECORDING_V2_HEADER_SIZE 48
+
+// the most bytes an event or a checkpoint takes in a file
+#define MAX_EVENT_SIZE 11
+#define MAX_CHECKPOINT_SIZE 18
+
+Chip8Recording* chip8_recording_create(uint64_t seed, uint64_t rom_hash) {
+    Chip8Recording* recording = calloc(1, sizeof(Chip8Recording));
+    if (!recording) {
+        printf("ERROR: Failed to allocate recording!\n");
+        return NULL;
+    }
+
+    recording->seed = seed;
+    recording->rom_hash = rom_hash;
+    recording->timing = CHIP8_TIMING_FIXED;
+    recording->instructions_per_second = CHIP8_DEFAULT_INSTRUCTIONS_PER_SECOND;
+
+    return recording;
+}
+
+void chip8_recording_destroy(Chip8Recording* recording) {
+    if (!recording) { return; }
+
+    free(recording->events);
+    free(recording->checkpoints);
+    free(recording);
+}
+
+// doubles the capacity of an array when it is full
+static int reserve(void** items, uint32_t* capacity, uint32_t count, size_t item_size) {
+    if (count < *capacity) { return 0; }
+
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+    void* new_items = realloc(*items, new_capacity * item_size);
+    if (!new_items) {
+        printf("ERROR: Failed to grow recording!\n");
+        return -1;
+    }
+
+    *items = new_items;
+    *capacity = new_capacity;
+
+    return 0;
+}
+
+int chip8_recording_add_event(Chip8Recording* recording, uint64_t instruction, uint8_t key, uint8_t down) {
+    if (reserve((void**) &recording->events, &recording->event_capacity, recording->event_count, sizeof(Chip8InputEvent)) != 0) { return -1; }
+
+    Chip8InputEvent* event = &recording->events[recording->event_count++];
+    event->instruction = instruction;
+    event->key = key & 0x0F;
+    event->down = down ? 1 : 0;
+
+    if (instruction > recording->length) { recording->length = instruction; }
+
+    return 0;
+}
+
+int chip8_recording_add_checkpoint(Chip8Recording* recording, uint64_t instruction, uint64_t display_hash) {
+    if (reserve((void**) &recording->checkpoints, &recording->checkpoint_capacity, recording->checkpoint_count, sizeof(Chip8Checkpoint)) != 0) { return -1; }
+
+    Chip8Checkpoint* checkpoint = &recording->checkpoints[recording->checkpoint_count++];
+    checkpoint->instruction = instruction;
+    checkpoint->display_hash = display_hash;
+
+    if (instruction > recording->length) { recording->length = instruction; }
+
+    return 0;
+}
+
+int chip8_recording_save(const Chip8Recording* recording, const char* file) {
+    size_t capacity = RECORDING_HEADER_SIZE + (size_t) recording->event_count * MAX_EVENT_SIZE +
+                      (size_t) recording->checkpoint_count * MAX_CHECKPOINT_SIZE;
+    uint8_t* buffer = malloc(capacity);
+    if (!buffer) {
+        printf("ERROR: Failed to allocate recording buffer!\n");
+        return -1;
+    }
+
+    memcpy(buffer, RECORDING_FILE_MAGIC, 4);
+    write_u32(buffer + 4, RECORDING_FILE_VERSION);
+    write_u64(buffer + 8, recording->seed);
+    write_u64(buffer + 16, recording->rom_hash);
+    write_u64(buffer + 24, recording->length);
+    write_u32(buffer + 32, recording->event_count);
+    write_u32(buffer + 36, recording->checkpoint_count);
+    write_u32(buffer + 40, recording->instructions_per_second);
+    write_u32(buffer + 44, recording->timing);
+    write_u32(buffer + 48, recording->quirks);
+    size_t size = RECORDING_HEADER_SIZE;
+
+    uint64_t previous = 0;
+    for (uint32_t i = 0; i < recording->event_count; i++) {
+        const Chip8InputEvent* event = &recording->events[i];
+        size += write_varint(buffer + size, event->instruction - previous);
+        buffer[size++] = event->key | (event->down << 4);
+        previous = event->instruction;
+    }
+
+    previous = 0;
+    for (uint32_t i = 0; i < recording->checkpoint_count; i++) {
+        const Chip8Checkpoint* checkpoint = &recording->checkpoints[i];
+        size += write_varint(buffer + size, checkpoint->instruction - previous);
+        write_u64(buffer + size, checkpoint->display_hash);
+        size += 8;
+        previous = checkpoint->instruction;
+    }
+
+    FILE* recording_file = fopen(file, "wb");
+    if (!recording_file) {
+        printf("ERROR: Failed to open recording file!\n");
+        free(buffer);
+        return -1;
+    }
+
+    fwrite(buffer, 1, size, recording_file);
+    free(buffer);
+
+    int result = ferror(recording_file) ? -1 : 0;
+    fclose(recording_file);
+
+    return result;
+}
+
+Chip8Recording* chip8_recording_load(const char* file) {
+    FILE* recording_file = fopen(file, "rb");
+    if (!recording_file) {
+        printf("ERROR: Failed to open recording file!\n");
+        return NULL;
+    }
+
+    fseek(recording_file, 0, SEEK_END);
+    long file_size = ftell(recording_file);
+    fseek(recording_file, 0, SEEK_SET);
+
+    // zero padding past the end lets a truncated file be read without checking every byte
+    uint8_t* buffer = (file_size > 0) ? calloc(1, file_size + MAX_CHECKPOINT_SIZE) : NULL;
+    if (!buffer || fread(buffer, 1, file_size, recording_file) != (size_t) file_size) {
+        printf("ERROR: Failed to read recording file!\n");
+        free(buffer);
+        fclose(recording_file);
+        return NULL;
+    }
+    fclose(recording_file);
+
+    uint32_t version = (file_size >= 8) ? read_u32(buffer + 4) : 0;
+    size_t header_size = (version == 1) ? RECORDING_V1_HEADER_SIZE : (version == 2) ? RECORDING_V2_HEADER_SIZE : RECORDING_HEADER_SIZE;
+    if (file_size < (long) header_size || memcmp(buffer, RECORDING_FILE_MAGIC, 4) != 0 || version < 1 || version > RECORDING_FILE_VERSION ||
+        (version > 1 && read_u32(buffer + 44) > CHIP8_TIMING_COSMAC) || (version > 2 && read_u32(buffer + 48) >= CHIP8_QUIRKS_COUNT)) {
+        printf("ERROR: Not a recording file!\n");
+        free(buffer);
+        return NULL;
+    }
+
+    uint32_t event_count = read_u32(buffer + 32);
+    uint32_t checkpoint_count = read_u32(buffer + 36);
+
+    Chip8Recording* recording = chip8_recording_create(read_u64(buffer + 8), read_u64(buffer + 16));
+    if (!recording) {
+        free(buffer);
+        return NULL;
+    }
+
+    if (version > 1) {
+        recording->instructions_per_second = read_u32(buffer + 40);
+        recording->timing = (Chip8Timing) read_u32(buffer + 44);
+    }
+
+    if (version > 2) { recording->quirks = (Chip8Quirks) read_u32(buffer + 48); }
+
+    size_t position = header_size;
+    uint64_t instruction = 0;
+    for (uint32_t i = 0; i < event_count && position < (size_t) file_size; i++) {
+        instruction += read_varint(buffer, &position);
+        uint8_t value = buffer[position++];
+
+        if (chip8_recording_add_event(recording, instruction, value & 0x0F, value >> 4) != 0) { break; }
+    }
+
+    instruction = 0;
+    for (uint32_t i = 0; i < checkpoint_count && position < (size_t) file_size; i++) {
+        instruction += read_varint(buffer, &position);
+
+        if (chip8_recording_add_checkpoint(recording, instruction, read_u64(buffer + position)) != 0) { break; }
+        position += 8;
+    }
+
+    int truncated = position > (size_t) file_size || recording->event_count != event_count || recording->checkpoint_count != checkpoint_count;
+
+    recording->length = read_u64(buffer + 24);
+    free(buffer);
+
+    if (truncated) {
+        printf("ERROR: Recording file is truncated!\n");
+        chip8_recording_destroy(recording);
+        return NULL;
+    }
+
+    return recording;
+}
+
+int chip8_replay_start(const Chip8Recording* recording, Chip8* chip8, const char* rom) {
+    Chip8Rom rom_data;
+    if (chip8_rom_read(&rom_data, rom) != 0) { return -1; }
+
+    if (rom_data.hash != recording->rom_hash) {
+        printf("ERROR: The rom does not match the recording!\n");
+        return -1;
+    }
+
+    chip8_seed(chip8, recording->seed);
+    chip8->quirks = recording->quirks;
+
+    return chip8_rom_load(chip8, &rom_data);
+}
+
+static int check_checkpoints(const Chip8Recording* recording, const Chip8* chip8, uint64_t instruction, uint32_t* next_checkpoint) {
+    while (*next_checkpoint < recording->checkpoint_count && recording->checkpoints[*next_checkpoint].instruction <= instruction) {
+        const Chip8Checkpoint* checkpoint = &recording->checkpoints[(*next_checkpoint)++];
+
+        if (chip8_display_hash(chip8) != checkpoint->display_hash) {
+            printf("ERROR: The replay does not match the recording at instruction %llu!\n", (unsigned long long) checkpoint->instruction);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int chip8_replay_run(const Chip8Recording* recording, Chip8* chip8, Chip8Engine* engine) {
+    Chip8Clock clock = chip8_clock_create(recording->timing, recording->instructions_per_second);
+
+    uint64_t instruction = 0;
+    uint32_t next_event = 0;
+    uint32_t next_checkpoint = 0;
+
+    while (instruction < recording->length) {
+        while (next_event < recording->event_count && recording->events[next_event].instruction <= instruction) {
+            const Chip8InputEvent* event = &recording->events[next_event++];
+            chip8->keypad[event->key] = event->down;
+        }
+
+        if (check_checkpoints(recording, chip8, instruction, &next_checkpoint) != 0) { return -1; }
+
+        // run up to whatever comes first, the end of the frame, the next event or the next checkpoint
+        uint64_t stop = recording->length;
+        if (next_event < recording->event_count && recording->events[next_event].instruction < stop) {
+            stop = recording->events[next_event].instruction;
+        }
+        if (next_checkpoint < recording->checkpoint_count && recording->checkpoints[next_checkpoint].instruction < stop) {
+            stop = recording->checkpoints[next_checkpoint].instruction;
+        }
+
+        instruction += chip8_clock_run(&clock, engine, chip8, stop - instruction);
+    }
+
+    return check_checkpoints(recording, chip8, instruction, &next_checkpoint);
+}
@@ -0,0 +1,290 @@
+#include "chip8_rewind.h"
+#include "chip8_snapshot.h"
+#include "chip8_endian.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the tokens below add at most 4 bytes per 3 bytes of snapshot, so this always fits an encoded frame
+#define MAX_ENCODED_SIZE (CHIP8_SNAPSHOT_SIZE * 3)
+
+typedef struct RewindFrame {
+    uint32_t offset;
+    uint16_t size;
+    uint16_t keyframe_distance; // frames back to its keyframe, 0 for keyframes
+} RewindFrame;
+
+struct Chip8Rewind {
+    // encoded frames, written one after the other and wrapping around at the end
+    uint8_t* data;
+    size_t data_size;
+    size_t write_offset;
+    size_t used;
+
+    // ring of frame descriptions, oldest first
+    RewindFrame* frames;
+    uint32_t frame_capacity;
+    uint32_t first;
+    uint32_t count;
+    uint64_t first_sequence; // number of frames ever dropped from the front
+
+    uint32_t keyframe_interval;
+    uint32_t frames_since_keyframe;
+
+    // the keyframe new frames are encoded against
+    uint8_t keyframe[CHIP8_SNAPSHOT_SIZE];
+
+    // the last keyframe decoded by a restore, rewinding frame by frame keeps needing the same one
+    uint8_t decoded_keyframe[CHIP8_SNAPSHOT_SIZE];
+    uint64_t decoded_keyframe_sequence;
+
+    uint8_t encoded[MAX_ENCODED_SIZE];
+};
+
+#define NO_SEQUENCE UINT64_MAX
+
+// keyframes are encoded against nothing
+static const uint8_t empty_snapshot[CHIP8_SNAPSHOT_SIZE];
+
+// a list of (unchanged bytes, changed bytes, changed bytes xored with the reference) tokens
+static size_t encode(const uint8_t* snapshot, const uint8_t* reference, uint8_t* buffer) {
+    size_t size = 0;
+    size_t i = 0;
+
+    while (i < CHIP8_SNAPSHOT_SIZE) {
+        size_t start = i;
+        while (i < CHIP8_SNAPSHOT_SIZE && snapshot[i] == reference[i]) { i++; }
+        size_t unchanged = i - start;
+
+        // a single unchanged byte is cheaper to copy than to start a new token for
+        start = i;
+        while (i < CHIP8_SNAPSHOT_SIZE &&
+               (snapshot[i] != reference[i] || (i + 1 < CHIP8_SNAPSHOT_SIZE && snapshot[i + 1] != reference[i + 1]))) {
+            i++;
+        }
+        size_t changed = i - start;
+
+        size += write_varint(buffer + size, unchanged);
+        size += write_varint(buffer + size, changed);
+        for (size_t j = start; j < i; j++) {
+            buffer[size++] = snapshot[j] ^ reference[j];
+        }
+    }
+
+    return size;
+}
+
+// `snapshot` has to hold the reference the frame was encoded against, returns -1 if the tokens run past its end
+static int decode(const uint8_t* buffer, uint8_t* snapshot) {
+    size_t position = 0;
+    size_t i = 0;
+
+    while (i < CHIP8_SNAPSHOT_SIZE) {
+        uint64_t unchanged = read_varint(buffer, &position);
+        if (unchanged > CHIP8_SNAPSHOT_SIZE - i) { return -1; }
+        i += unchanged;
+
+        uint64_t changed = read_varint(buffer, &position);
+        if (changed > CHIP8_SNAPSHOT_SIZE - i) { return -1; }
+        for (size_t j = 0; j < changed; j++) {
+            snapshot[i++] ^= buffer[position++];
+        }
+    }
+
+    return 0;
+}
+
+Chip8Rewind* chip8_rewind_create(size_t memory_size, uint32_t keyframe_interval) {
+    if (memory_size < 4 * MAX_ENCODED_SIZE || memory_size > UINT32_MAX || keyframe_interval == 0 || keyframe_interval > UINT16_MAX) {
+        printf("ERROR: Invalid rewind buffer size!\n");
+        return NULL;
+    }
+
+    Chip8Rewind* rewind = calloc(1, sizeof(Chip8Rewind));
+    if (!rewind) {
+        printf("ERROR: Failed to allocate rewind buffer!\n");
+        return NULL;
+    }
+
+    // frames rarely encode to less than this, past it the oldest frames are dropped early
+    rewind->frame_capacity = (uint32_t) (memory_size / 32);
+
+    rewind->data = malloc(memory_size);
+    rewind->frames = malloc(rewind->frame_capacity * sizeof(RewindFrame));
+    if (!rewind->data || !rewind->frames) {
+        printf("ERROR: Failed to allocate rewind buffer!\n");
+        chip8_rewind_destroy(rewind);
+        return NULL;
+    }
+
+    rewind->data_size = memory_size;
+    rewind->keyframe_interval = keyframe_interval;
+    chip8_rewind_clear(rewind);
+
+    return rewind;
+}
+
+void chip8_rewind_destroy(Chip8Rewind* rewind) {
+    if (!rewind) { return; }
+
+    free(rewind->data);
+    free(rewind->frames);
+    free(rewind);
+}
+
+void chip8_rewind_clear(Chip8Rewind* rewind) {
+    rewind->write_offset = 0;
+    rewind->used = 0;
+    rewind->first = 0;
+    rewind->count = 0;
+    rewind->first_sequence = 0;
+    rewind->frames_since_keyframe = 0;
+    rewind->decoded_keyframe_sequence = NO_SEQUENCE;
+}
+
+static RewindFrame* get_frame(const Chip8Rewind* rewind, uint32_t index) {
+    return &rewind->frames[(rewind->first + index) % rewind->frame_capacity];
+}
+
+static void drop_oldest(Chip8Rewind* rewind) {
+    rewind->used -= get_frame(rewind, 0)->size;
+    rewind->first = (rewind->first + 1) % rewind->frame_capacity;
+    rewind->count--;
+    rewind->first_sequence++;
+}
+
+// returns -1 without storing anything if making room dropped the keyframe the frame was encoded against
+static int store(Chip8Rewind* rewind, size_t size, uint16_t keyframe_distance) {
+    size_t offset = rewind->write_offset;
+    if (offset + size > rewind->data_size) {
+        // the frames left past the write position are the oldest ones, they would not overlap the
+        // frame about to go to the start but would sit in front of the ones it overwrites
+        while (rewind->count > 0 && get_frame(rewind, 0)->offset >= offset) {
+            drop_oldest(rewind);
+        }
+        offset = 0;
+    }
+
+    // the frames following the write position are the oldest ones
+    while (rewind->count > 0) {
+        RewindFrame* oldest = get_frame(rewind, 0);
+        int overlaps = oldest->offset < offset + size && offset < (size_t) oldest->offset + oldest->size;
+        if (!overlaps && rewind->count < rewind->frame_capacity) { break; }
+
+        drop_oldest(rewind);
+    }
+
+    if (keyframe_distance > rewind->count) { return -1; }
+
+    memcpy(rewind->data + offset, rewind->encoded, size);
+
+    RewindFrame* frame = get_frame(rewind, rewind->count++);
+    frame->offset = (uint32_t) offset;
+    frame->size = (uint16_t) size;
+    frame->keyframe_distance = keyframe_distance;
+
+    rewind->write_offset = offset + size;
+    rewind->used += size;
+
+    // deltas whose keyframe was dropped can not be decoded anymore
+    while (rewind->count > 0 && get_frame(rewind, 0)->keyframe_distance != 0) {
+        drop_oldest(rewind);
+    }
+
+    return 0;
+}
+
+void chip8_rewind_push(Chip8Rewind* rewind, const Chip8* chip8) {
+    uint8_t snapshot[CHIP8_SNAPSHOT_SIZE];
+    chip8_snapshot(chip8, snapshot);
+
+    uint32_t keyframe_distance = rewind->frames_since_keyframe;
+    size_t size;
+
+    if (rewind->count == 0 || keyframe_distance >= rewind->keyframe_interval) {
+        size = encode(snapshot, empty_snapshot, rewind->encoded);
+        memcpy(rewind->keyframe, snapshot, sizeof(snapshot));
+        keyframe_distance = 0;
+    } else {
+        size = encode(snapshot, rewind->keyframe, rewind->encoded);
+    }
+
+    // a delta can outlive its keyframe when the ring wraps, so it becomes a keyframe itself
+    if (store(rewind, size, (uint16_t) keyframe_distance) != 0) {
+        size = encode(snapshot, empty_snapshot, rewind->encoded);
+        memcpy(rewind->keyframe, snapshot, sizeof(snapshot));
+        keyframe_distance = 0;
+        store(rewind, size, 0);
+    }
+    rewind->frames_since_keyframe = rewind->count ? keyframe_distance + 1 : 0;
+}
+
+uint32_t chip8_rewind_size(const Chip8Rewind* rewind) {
+    return rewind->count;
+}
+
+size_t chip8_rewind_memory_used(const Chip8Rewind* rewind) {
+    return rewind->used;
+}
+
+// decodes the keyframe of the frame at `index` into decoded_keyframe
+static int decode_keyframe(Chip8Rewind* rewind, uint32_t index) {
+    uint32_t keyframe_index = index - get_frame(rewind, index)->keyframe_distance;
+    uint64_t sequence = rewind->first_sequence + keyframe_index;
+    if (rewind->decoded_keyframe_sequence == sequence) { return 0; }
+
+    memset(rewind->decoded_keyframe, 0, sizeof(rewind->decoded_keyframe));
+    if (decode(rewind->data + get_frame(rewind, keyframe_index)->offset, rewind->decoded_keyframe) != 0) {
+        rewind->decoded_keyframe_sequence = NO_SEQUENCE;
+        return -1;
+    }
+    rewind->decoded_keyframe_sequence = sequence;
+
+    return 0;
+}
+
+int chip8_rewind_restore(Chip8Rewind* rewind, uint32_t frames_back, Chip8* chip8) {
+    if (frames_back >= rewind->count) { return -1; }
+
+    uint32_t index = rewind->count - 1 - frames_back;
+    if (decode_keyframe(rewind, index) != 0) { return -1; }
+
+    uint8_t snapshot[CHIP8_SNAPSHOT_SIZE];
+    memcpy(snapshot, rewind->decoded_keyframe, sizeof(snapshot));
+
+    RewindFrame* frame = get_frame(rewind, index);
+    if (frame->keyframe_distance != 0 && decode(rewind->data + frame->offset, snapshot) != 0) { return -1; }
+
+    return chip8_restore(chip8, snapshot, sizeof(snapshot));
+}
+
+void chip8_rewind_drop(Chip8Rewind* rewind, uint32_t frames) {
+    if (frames >= rewind->count) {
+        chip8_rewind_clear(rewind);
+        return;
+    }
+
+    for (uint32_t i = 0; i < frames; i++) {
+        rewind->used -= get_frame(rewind, --rewind->count)->size;
+    }
+
+    // the sequence numbers of the dropped frames get reused
+    if (rewind->decoded_keyframe_sequence >= rewind->first_sequence + rewind->count) {
+        rewind->decoded_keyframe_sequence = NO_SEQUENCE;
+    }
+
+    // new frames continue the newest remaining frame's keyframe
+    uint32_t newest = rewind->count - 1;
+    RewindFrame* frame = get_frame(rewind, newest);
+
+    if (decode_keyframe(rewind, newest) != 0) {
+        chip8_rewind_clear(rewind);
+        return;
+    }
+    memcpy(rewind->keyframe, rewind->decoded_keyframe, sizeof(rewind->keyframe));
+
+    rewind->frames_since_keyframe = frame->keyframe_distance + 1;
+    rewind->write_offset = frame->offset + frame->size;
+}
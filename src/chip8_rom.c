@@ -0,0 +1,418 @@
+#include "chip8_rom.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+// both tables of the cache are grown to keep them at most half full
+#define INITIAL_CACHE_CAPACITY 64
+
+typedef struct CachePath {
+    char* path; // NULL for empty slots
+    uint64_t path_hash;
+    const Chip8Rom* rom;
+} CachePath;
+
+struct Chip8RomCache {
+    pthread_mutex_t lock;
+
+    // file path -> rom, so a path seen before never touches the disk
+    CachePath* paths;
+    uint32_t path_capacity;
+    uint32_t path_count;
+
+    // content hash -> rom, so the same rom under different paths is kept once
+    Chip8Rom** roms;
+    uint32_t rom_capacity;
+    uint32_t rom_count;
+
+    uint32_t reads;
+};
+
+uint64_t chip8_rom_hash_data(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+uint64_t chip8_rom_hash(const char* file) {
+    Chip8Rom rom;
+    if (chip8_rom_read(&rom, file) != 0) { return 0; }
+
+    return rom.hash;
+}
+
+int chip8_rom_read(Chip8Rom* rom, const char* file) {
+    FILE* rom_file = fopen(file, "rb");
+    if (!rom_file) {
+        printf("ERROR: Failed to open rom file!\n");
+        return -1;
+    }
+
+    // one byte more than fits, so a read that fills it means the rom is too big
+    uint8_t buffer[CHIP8_MAX_ROM_SIZE + 1];
+    size_t size = fread(buffer, 1, sizeof(buffer), rom_file);
+    int failed = ferror(rom_file);
+    fclose(rom_file);
+
+    if (failed) {
+        printf("ERROR: Failed to read rom file!\n");
+        return -1;
+    }
+
+    if (size > CHIP8_MAX_ROM_SIZE) {
+        printf("ERROR: Rom is larger than %d bytes!\n", CHIP8_MAX_ROM_SIZE);
+        return -1;
+    }
+
+    memcpy(rom->data, buffer, size);
+    rom->size = (uint32_t) size;
+    rom->hash = chip8_rom_hash_data(rom->data, size);
+
+    return 0;
+}
+
+int chip8_rom_load(Chip8* chip8, const Chip8Rom* rom) {
+    return chip8_load_program(chip8, rom->data, rom->size);
+}
+
+Chip8RomCache* chip8_rom_cache_create() {
+    Chip8RomCache* cache = calloc(1, sizeof(Chip8RomCache));
+    if (!cache) {
+        printf("ERROR: Failed to allocate rom cache!\n");
+        return NULL;
+    }
+
+    cache->paths = calloc(INITIAL_CACHE_CAPACITY, sizeof(CachePath));
+    cache->roms = calloc(INITIAL_CACHE_CAPACITY, sizeof(Chip8Rom*));
+    if (!cache->paths || !cache->roms) {
+        printf("ERROR: Failed to allocate rom cache!\n");
+        free(cache->paths);
+        free(cache->roms);
+        free(cache);
+        return NULL;
+    }
+
+    cache->path_capacity = INITIAL_CACHE_CAPACITY;
+    cache->rom_capacity = INITIAL_CACHE_CAPACITY;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+void chip8_rom_cache_destroy(Chip8RomCache* cache) {
+    if (!cache) { return; }
+
+    for (uint32_t i = 0; i < cache->path_capacity; i++) {
+        free(cache->paths[i].path);
+    }
+
+    for (uint32_t i = 0; i < cache->rom_capacity; i++) {
+        free(cache->roms[i]);
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->paths);
+    free(cache->roms);
+    free(cache);
+}
+
+static uint32_t find_path(const CachePath* paths, uint32_t capacity, const char* path, uint64_t path_hash) {
+    uint32_t mask = capacity - 1;
+    uint32_t slot = (uint32_t) path_hash & mask;
+    while (paths[slot].path && (paths[slot].path_hash != path_hash || strcmp(paths[slot].path, path) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// two roms with the same hash are only the same rom if their contents match too
+static int same_rom(const Chip8Rom* a, const Chip8Rom* b) {
+    return a->hash == b->hash && a->size == b->size && memcmp(a->data, b->data, a->size) == 0;
+}
+
+// the slot of `rom`'s content or the empty slot it goes into
+static uint32_t find_rom(Chip8Rom* const* roms, uint32_t capacity, const Chip8Rom* rom) {
+    uint32_t mask = capacity - 1;
+    uint32_t slot = (uint32_t) rom->hash & mask;
+    while (roms[slot] && !same_rom(roms[slot], rom)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static int grow_paths(Chip8RomCache* cache) {
+    uint32_t capacity = cache->path_capacity * 2;
+    CachePath* paths = calloc(capacity, sizeof(CachePath));
+    if (!paths) { return -1; }
+
+    for (uint32_t i = 0; i < cache->path_capacity; i++) {
+        const CachePath* entry = &cache->paths[i];
+        if (entry->path) { paths[find_path(paths, capacity, entry->path, entry->path_hash)] = *entry; }
+    }
+
+    free(cache->paths);
+    cache->paths = paths;
+    cache->path_capacity = capacity;
+
+    return 0;
+}
+
+static int grow_roms(Chip8RomCache* cache) {
+    uint32_t capacity = cache->rom_capacity * 2;
+    Chip8Rom** roms = calloc(capacity, sizeof(Chip8Rom*));
+    if (!roms) { return -1; }
+
+    for (uint32_t i = 0; i < cache->rom_capacity; i++) {
+        Chip8Rom* rom = cache->roms[i];
+        if (rom) { roms[find_rom(roms, capacity, rom)] = rom; }
+    }
+
+    free(cache->roms);
+    cache->roms = roms;
+    cache->rom_capacity = capacity;
+
+    return 0;
+}
+
+// keeps `rom` unless the cache already holds the same content, returns the copy in the cache
+static const Chip8Rom* add_rom(Chip8RomCache* cache, const Chip8Rom* rom) {
+    uint32_t slot = find_rom(cache->roms, cache->rom_capacity, rom);
+    if (cache->roms[slot]) { return cache->roms[slot]; }
+
+    if ((cache->rom_count + 1) * 2 > cache->rom_capacity) {
+        if (grow_roms(cache) != 0) { return NULL; }
+        slot = find_rom(cache->roms, cache->rom_capacity, rom);
+    }
+
+    Chip8Rom* copy = malloc(sizeof(Chip8Rom));
+    if (!copy) { return NULL; }
+    *copy = *rom;
+
+    cache->roms[slot] = copy;
+    cache->rom_count++;
+
+    return copy;
+}
+
+const Chip8Rom* chip8_rom_cache_get(Chip8RomCache* cache, const char* file) {
+    uint64_t path_hash = chip8_rom_hash_data((const uint8_t*) file, strlen(file));
+
+    pthread_mutex_lock(&cache->lock);
+
+    uint32_t slot = find_path(cache->paths, cache->path_capacity, file, path_hash);
+    const Chip8Rom* cached = cache->paths[slot].rom;
+    if (cached) {
+        pthread_mutex_unlock(&cache->lock);
+        return cached;
+    }
+
+    // roms are small and read rarely, holding the lock while reading keeps two threads from reading the same file
+    Chip8Rom rom;
+    cache->reads++;
+    if (chip8_rom_read(&rom, file) != 0) {
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+
+    cached = add_rom(cache, &rom);
+    char* path = cached ? malloc(strlen(file) + 1) : NULL;
+    if (path) { strcpy(path, file); }
+
+    if (path && (cache->path_count + 1) * 2 > cache->path_capacity) {
+        if (grow_paths(cache) == 0) {
+            slot = find_path(cache->paths, cache->path_capacity, file, path_hash);
+        } else {
+            free(path);
+            path = NULL;
+        }
+    }
+
+    // when the path can not be kept the rom is still handed out, it just gets read again next time
+    if (path) {
+        cache->paths[slot] = (CachePath) {.path = path, .path_hash = path_hash, .rom = cached};
+        cache->path_count++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!cached) { printf("ERROR: Failed to allocate cached rom!\n"); }
+
+    return cached;
+}
+
+const Chip8Rom* chip8_rom_cache_find(Chip8RomCache* cache, uint64_t hash) {
+    pthread_mutex_lock(&cache->lock);
+
+    // with colliding contents this is whichever of them the probe reaches first
+    uint32_t mask = cache->rom_capacity - 1;
+    uint32_t slot = (uint32_t) hash & mask;
+    while (cache->roms[slot] && cache->roms[slot]->hash != hash) {
+        slot = (slot + 1) & mask;
+    }
+    const Chip8Rom* rom = cache->roms[slot];
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return rom;
+}
+
+uint32_t chip8_rom_cache_reads(Chip8RomCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    uint32_t reads = cache->reads;
+    pthread_mutex_unlock(&cache->lock);
+
+    return reads;
+}
+
+uint32_t chip8_rom_cache_size(Chip8RomCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    uint32_t size = cache->rom_count;
+    pthread_mutex_unlock(&cache->lock);
+
+    return size;
+}
+
+static int compare_profiles(const void* a, const void* b) {
+    uint64_t hash_a = ((const Chip8RomProfile*) a)->hash;
+    uint64_t hash_b = ((const Chip8RomProfile*) b)->hash;
+
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+// fills in one `key=value` setting, returns the rest of the line
+static char* parse_setting(char* text, Chip8RomProfile* profile, int line_number) {
+    char* end = text;
+    while (*end && !isspace((unsigned char) *end)) { end++; }
+
+    // the name can have spaces in it, so it takes everything up to the end of the line
+    if (strncmp(text, "name=", 5) == 0) {
+        char* name = text + 5;
+        size_t length = strcspn(name, "\r\n");
+        while (length > 0 && isspace((unsigned char) name[length - 1])) { length--; }
+        if (length >= sizeof(profile->name)) { length = sizeof(profile->name) - 1; }
+
+        memcpy(profile->name, name, length);
+        profile->name[length] = '\0';
+
+        return name + strlen(name);
+    }
+
+    char saved = *end;
+    *end = '\0';
+
+    if (strncmp(text, "clock=", 6) == 0) {
+        profile->instructions_per_second = (uint32_t) strtoul(text + 6, NULL, 0);
+    } else if (strncmp(text, "timing=", 7) == 0) {
+        Chip8Timing timing;
+        if (chip8_timing_parse(text + 7, &timing) == 0) {
+            profile->timing = (int8_t) timing;
+        } else {
+            printf("ERROR: Unknown timing \"%s\" on line %d of the rom database!\n", text + 7, line_number);
+        }
+    } else if (strncmp(text, "quirks=", 7) == 0) {
+        Chip8Quirks quirks;
+        if (chip8_quirks_parse(text + 7, &quirks) == 0) {
+            profile->quirks = (int8_t) quirks;
+        } else {
+            printf("ERROR: Unknown quirks \"%s\" on line %d of the rom database!\n", text + 7, line_number);
+        }
+    }
+
+    *end = saved;
+
+    return end;
+}
+
+Chip8RomDatabase* chip8_rom_database_load(const char* file) {
+    FILE* database_file = fopen(file, "r");
+    if (!database_file) {
+        printf("ERROR: Failed to open rom database!\n");
+        return NULL;
+    }
+
+    Chip8RomDatabase* database = calloc(1, sizeof(Chip8RomDatabase));
+    if (!database) {
+        printf("ERROR: Failed to allocate rom database!\n");
+        fclose(database_file);
+        return NULL;
+    }
+
+    uint32_t capacity = 0;
+    int line_number = 0;
+
+    char line[512];
+    while (fgets(line, sizeof(line), database_file)) {
+        line_number++;
+
+        char* text = line;
+        while (isspace((unsigned char) *text)) { text++; }
+        if (*text == '\0' || *text == '#') { continue; }
+
+        char* end;
+        Chip8RomProfile profile = {.timing = CHIP8_ROM_DEFAULT, .quirks = CHIP8_ROM_DEFAULT};
+        profile.hash = strtoull(text, &end, 16);
+        if (end == text) {
+            printf("ERROR: Line %d of the rom database does not start with a hash!\n", line_number);
+            continue;
+        }
+
+        text = end;
+        while (*text) {
+            while (isspace((unsigned char) *text)) { text++; }
+            if (*text) { text = parse_setting(text, &profile, line_number); }
+        }
+
+        if (database->count == capacity) {
+            uint32_t new_capacity = capacity ? capacity * 2 : 64;
+            Chip8RomProfile* profiles = realloc(database->profiles, new_capacity * sizeof(Chip8RomProfile));
+            if (!profiles) {
+                printf("ERROR: Failed to allocate rom database!\n");
+                break;
+            }
+
+            database->profiles = profiles;
+            capacity = new_capacity;
+        }
+
+        database->profiles[database->count++] = profile;
+    }
+
+    fclose(database_file);
+
+    if (database->count) { qsort(database->profiles, database->count, sizeof(Chip8RomProfile), compare_profiles); }
+
+    return database;
+}
+
+void chip8_rom_database_destroy(Chip8RomDatabase* database) {
+    if (!database) { return; }
+
+    free(database->profiles);
+    free(database);
+}
+
+const Chip8RomProfile* chip8_rom_database_find(const Chip8RomDatabase* database, uint64_t hash) {
+    if (!database || !database->count) { return NULL; }
+
+    Chip8RomProfile key = {.hash = hash};
+    return bsearch(&key, database->profiles, database->count, sizeof(Chip8RomProfile), compare_profiles);
+}
+
+void chip8_rom_profile_apply(const Chip8RomProfile* profile, Chip8Timing* timing, uint32_t* instructions_per_second, Chip8Quirks* quirks) {
+    if (!profile) { return; }
+
+    if (profile->quirks != CHIP8_ROM_DEFAULT) { *quirks = (Chip8Quirks) profile->quirks; }
+    if (profile->timing != CHIP8_ROM_DEFAULT) { *timing = (Chip8Timing) profile->timing; }
+    if (profile->instructions_per_second) { *instructions_per_second = profile->instructions_per_second; }
+}
@@ -0,0 +1,170 @@
+#include "chip8_snapshot.h"
+#include "chip8_endian.h"
+#include "chip8_audio.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC "C8SS"
+#define SNAPSHOT_VERSION 2
+
+// version 1 had a single 64x32 plane and none of the SUPER-CHIP / XO-CHIP state, it can still be restored
+#define SNAPSHOT_V1_SIZE (CHIP8_SNAPSHOT_SIZE - CHIP8_DISPLAY_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_DISPLAY_WORDS * 8 + CHIP8_DISPLAY_HEIGHT * 8 - 35)
+
+void chip8_snapshot(const Chip8* chip8, uint8_t* buffer) {
+    memcpy(buffer, SNAPSHOT_MAGIC, 4);
+    write_u32(buffer + 4, SNAPSHOT_VERSION);
+    uint8_t* state = buffer + 8;
+
+    memcpy(state, chip8->memory, sizeof(chip8->memory));
+    state += sizeof(chip8->memory);
+    *state++ = chip8->program_loaded;
+
+    memcpy(state, chip8->registers, sizeof(chip8->registers));
+    state += sizeof(chip8->registers);
+
+    write_u16(state, chip8->program_counter);
+    write_u16(state + 2, chip8->address_register);
+    state += 4;
+
+    *state++ = chip8->delay_timer;
+    *state++ = chip8->sound_timer;
+
+    for (int i = 0; i < 16; i++) {
+        write_u16(state, chip8->stack[i]);
+        state += 2;
+    }
+    *state++ = chip8->stack_pointer;
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            for (int word = 0; word < CHIP8_DISPLAY_WORDS; word++) {
+                uint64_t value = chip8->display.planes[plane][y][word];
+                write_u32(state, (uint32_t) value);
+                write_u32(state + 4, (uint32_t) (value >> 32));
+                state += 8;
+            }
+        }
+    }
+
+    memcpy(state, chip8->keypad, sizeof(chip8->keypad));
+    state += sizeof(chip8->keypad);
+
+    write_u32(state, chip8->random_state);
+    state += 4;
+
+    *state++ = chip8->display.hires;
+    *state++ = chip8->plane_mask;
+    memcpy(state, chip8->flags, sizeof(chip8->flags));
+    state += sizeof(chip8->flags);
+    memcpy(state, chip8->audio_pattern, sizeof(chip8->audio_pattern));
+    state += sizeof(chip8->audio_pattern);
+    *state = chip8->pitch;
+}
+
+int chip8_restore(Chip8* chip8, const uint8_t* buffer, size_t size) {
+    uint32_t version = (size >= 8) ? read_u32(buffer + 4) : 0;
+    size_t expected_size = (version == 1) ? SNAPSHOT_V1_SIZE : CHIP8_SNAPSHOT_SIZE;
+    if (size < expected_size || memcmp(buffer, SNAPSHOT_MAGIC, 4) != 0 || (version != 1 && version != SNAPSHOT_VERSION)) {
+        printf("ERROR: Not a snapshot!\n");
+        return -1;
+    }
+
+    const uint8_t* state = buffer + 8;
+
+    memcpy(chip8->memory, state, sizeof(chip8->memory));
+    state += sizeof(chip8->memory);
+    chip8->program_loaded = *state++;
+
+    memcpy(chip8->registers, state, sizeof(chip8->registers));
+    state += sizeof(chip8->registers);
+
+    chip8->program_counter = read_u16(state);
+    chip8->address_register = read_u16(state + 2);
+    state += 4;
+
+    chip8->delay_timer = *state++;
+    chip8->sound_timer = *state++;
+
+    for (int i = 0; i < 16; i++) {
+        chip8->stack[i] = read_u16(state);
+        state += 2;
+    }
+    chip8->stack_pointer = *state++;
+
+    memset(&chip8->display, 0, sizeof(chip8->display));
+    if (version == 1) {
+        for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+            chip8->display.planes[0][y][0] = read_u32(state) | ((uint64_t) read_u32(state + 4) << 32);
+            state += 8;
+        }
+    } else {
+        for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+            for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+                for (int word = 0; word < CHIP8_DISPLAY_WORDS; word++) {
+                    chip8->display.planes[plane][y][word] = read_u32(state) | ((uint64_t) read_u32(state + 4) << 32);
+                    state += 8;
+                }
+            }
+        }
+    }
+    chip8->display_dirty = UINT64_MAX;
+
+    memcpy(chip8->keypad, state, sizeof(chip8->keypad));
+    state += sizeof(chip8->keypad);
+
+    chip8->random_state = read_u32(state);
+    state += 4;
+
+    if (version == 1) {
+        static const uint8_t default_pattern[] = CHIP8_TONE_DEFAULT_PATTERN;
+
+        chip8->plane_mask = 1;
+        memset(chip8->flags, 0, sizeof(chip8->flags));
+        memcpy(chip8->audio_pattern, default_pattern, sizeof(chip8->audio_pattern));
+        chip8->pitch = CHIP8_TONE_DEFAULT_PITCH;
+        return 0;
+    }
+
+    chip8->display.hires = *state++;
+    chip8->plane_mask = *state++;
+    memcpy(chip8->flags, state, sizeof(chip8->flags));
+    state += sizeof(chip8->flags);
+    memcpy(chip8->audio_pattern, state, sizeof(chip8->audio_pattern));
+    state += sizeof(chip8->audio_pattern);
+    chip8->pitch = *state;
+
+    return 0;
+}
+
+int chip8_snapshot_save(const Chip8* chip8, const char* file) {
+    FILE* snapshot_file = fopen(file, "wb");
+    if (!snapshot_file) {
+        printf("ERROR: Failed to open snapshot file!\n");
+        return -1;
+    }
+
+    uint8_t buffer[CHIP8_SNAPSHOT_SIZE];
+    chip8_snapshot(chip8, buffer);
+    fwrite(buffer, 1, sizeof(buffer), snapshot_file);
+
+    int result = ferror(snapshot_file) ? -1 : 0;
+    fclose(snapshot_file);
+
+    return result;
+}
+
+int chip8_snapshot_load(Chip8* chip8, const char* file) {
+    FILE* snapshot_file = fopen(file, "rb");
+    if (!snapshot_file) {
+        printf("ERROR: Failed to open snapshot file!\n");
+        return -1;
+    }
+
+    uint8_t buffer[CHIP8_SNAPSHOT_SIZE];
+    size_t size = fread(buffer, 1, sizeof(buffer), snapshot_file);
+    fclose(snapshot_file);
+
+    return chip8_restore(chip8, buffer, size);
+}
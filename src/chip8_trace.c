@@ -0,0 +1,214 @@
+#include "chip8_trace.h"
+#include "chip8_endian.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_FILE_MAGIC "C8TR"
+#define TRACE_FILE_VERSION 1
+#define TRACE_RECORD_SIZE 8
+
+Chip8Trace* chip8_trace_create(uint32_t capacity) {
+    uint32_t rounded_capacity = 1;
+    while (rounded_capacity < capacity && rounded_capacity < 0x80000000u) { rounded_capacity <<= 1; }
+
+    Chip8Trace* trace = malloc(sizeof(Chip8Trace));
+    if (!trace) {
+        printf("ERROR: Failed to allocate trace!\n");
+        return NULL;
+    }
+
+    trace->records = calloc(rounded_capacity, sizeof(Chip8TraceRecord));
+    if (!trace->records) {
+        printf("ERROR: Failed to allocate trace records!\n");
+        free(trace);
+        return NULL;
+    }
+
+    trace->capacity = rounded_capacity;
+    trace->count = 0;
+
+    return trace;
+}
+
+void chip8_trace_destroy(Chip8Trace* trace) {
+    if (!trace) { return; }
+
+    free(trace->records);
+    free(trace);
+}
+
+void chip8_trace_clear(Chip8Trace* trace) {
+    trace->count = 0;
+}
+
+uint32_t chip8_trace_size(const Chip8Trace* trace) {
+    return (trace->count < trace->capacity) ? (uint32_t) trace->count : trace->capacity;
+}
+
+const Chip8TraceRecord* chip8_trace_get(const Chip8Trace* trace, uint32_t index) {
+    uint64_t oldest = trace->count - chip8_trace_size(trace);
+    return &trace->records[(oldest + index) & (trace->capacity - 1)];
+}
+
+int chip8_trace_save(const Chip8Trace* trace, const char* file) {
+    FILE* trace_file = fopen(file, "wb");
+    if (!trace_file) {
+        printf("ERROR: Failed to open trace file!\n");
+        return -1;
+    }
+
+    uint32_t size = chip8_trace_size(trace);
+
+    uint8_t header[12];
+    memcpy(header, TRACE_FILE_MAGIC, 4);
+    write_u32(header + 4, TRACE_FILE_VERSION);
+    write_u32(header + 8, size);
+    fwrite(header, 1, sizeof(header), trace_file);
+
+    for (uint32_t i = 0; i < size; i++) {
+        const Chip8TraceRecord* record = chip8_trace_get(trace, i);
+
+        uint8_t buffer[TRACE_RECORD_SIZE];
+        write_u16(buffer, record->program_counter);
+        write_u16(buffer + 2, record->opcode);
+        write_u16(buffer + 4, record->address_register);
+        buffer[6] = record->changed_register;
+        buffer[7] = record->value;
+        fwrite(buffer, 1, sizeof(buffer), trace_file);
+    }
+
+    int result = ferror(trace_file) ? -1 : 0;
+    fclose(trace_file);
+
+    return result;
+}
+
+Chip8Trace* chip8_trace_load(const char* file) {
+    FILE* trace_file = fopen(file, "rb");
+    if (!trace_file) {
+        printf("ERROR: Failed to open trace file!\n");
+        return NULL;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), trace_file) != sizeof(header) || memcmp(header, TRACE_FILE_MAGIC, 4) != 0 || read_u32(header + 4) != TRACE_FILE_VERSION) {
+        printf("ERROR: Not a trace file!\n");
+        fclose(trace_file);
+        return NULL;
+    }
+
+    uint32_t size = read_u32(header + 8);
+    Chip8Trace* trace = chip8_trace_create(size);
+    if (!trace) {
+        fclose(trace_file);
+        return NULL;
+    }
+
+    uint8_t buffer[TRACE_RECORD_SIZE];
+    while (trace->count < size && fread(buffer, 1, sizeof(buffer), trace_file) == sizeof(buffer)) {
+        Chip8TraceRecord* record = &trace->records[trace->count++];
+        record->program_counter = read_u16(buffer);
+        record->opcode = read_u16(buffer + 2);
+        record->address_register = read_u16(buffer + 4);
+        record->changed_register = buffer[6];
+        record->value = buffer[7];
+    }
+
+    fclose(trace_file);
+
+    return trace;
+}
+
+void chip8_disassemble(uint16_t opcode, char* buffer, size_t size) {
+    uint16_t addr = opcode & 0x0FFF;
+    uint8_t Vx = (opcode >> 8) & 0x0F;
+    uint8_t Vy = (opcode >> 4) & 0x0F;
+    uint8_t byte = opcode & 0x00FF;
+    uint8_t nibble = opcode & 0x000F;
+
+    switch ((opcode >> 12) & 0xF) {
+        case 0x0:
+            if ((opcode & 0xFFF0) == 0x00C0) { snprintf(buffer, size, "SCD %X", nibble); return; }
+            if ((opcode & 0xFFF0) == 0x00D0) { snprintf(buffer, size, "SCU %X", nibble); return; }
+
+            switch (byte) {
+                case 0xE0: snprintf(buffer, size, "CLS"); return;
+                case 0xEE: snprintf(buffer, size, "RTE"); return;
+                case 0xFB: snprintf(buffer, size, "SCR"); return;
+                case 0xFC: snprintf(buffer, size, "SCL"); return;
+                case 0xFD: snprintf(buffer, size, "EXIT"); return;
+                case 0xFE: snprintf(buffer, size, "LOW"); return;
+                case 0xFF: snprintf(buffer, size, "HIGH"); return;
+            }
+            break;
+        case 0x1: snprintf(buffer, size, "JP %03X", addr); return;
+        case 0x2: snprintf(buffer, size, "CALL %03X", addr); return;
+        case 0x3: snprintf(buffer, size, "SE V%X, %02X", Vx, byte); return;
+        case 0x4: snprintf(buffer, size, "SNE V%X, %02X", Vx, byte); return;
+        case 0x5:
+            if (nibble == 0x2) { snprintf(buffer, size, "SAVE V%X - V%X", Vx, Vy); return; }
+            if (nibble == 0x3) { snprintf(buffer, size, "LOAD V%X - V%X", Vx, Vy); return; }
+            snprintf(buffer, size, "SNE V%X, V%X", Vx, Vy);
+            return;
+        case 0x6: snprintf(buffer, size, "LD V%X, %02X", Vx, byte); return;
+        case 0x7: snprintf(buffer, size, "ADD V%X, %02X", Vx, byte); return;
+        case 0x8:
+            switch (nibble) {
+                case 0x0: snprintf(buffer, size, "LD V%X, V%X", Vx, Vy); return;
+                case 0x1: snprintf(buffer, size, "OR V%X, V%X", Vx, Vy); return;
+                case 0x2: snprintf(buffer, size, "AND V%X, V%X", Vx, Vy); return;
+                case 0x3: snprintf(buffer, size, "XOR V%X, V%X", Vx, Vy); return;
+                case 0x4: snprintf(buffer, size, "ADD V%X, V%X", Vx, Vy); return;
+                case 0x5: snprintf(buffer, size, "SUB V%X, V%X", Vx, Vy); return;
+                case 0x6: snprintf(buffer, size, "SHR V%X, V%X", Vx, Vy); return;
+                case 0x7: snprintf(buffer, size, "SUBN V%X, V%X", Vx, Vy); return;
+                case 0xE: snprintf(buffer, size, "SHL V%X, V%X", Vx, Vy); return;
+            }
+            break;
+        case 0x9: snprintf(buffer, size, "SNE V%X, V%X", Vx, Vy); return;
+        case 0xA: snprintf(buffer, size, "LD I, %03X", addr); return;
+        case 0xB: snprintf(buffer, size, "JP V0, %03X", addr); return;
+        case 0xC: snprintf(buffer, size, "RND V%X, %02X", Vx, byte); return;
+        case 0xD: snprintf(buffer, size, "DRW V%X, V%X, %X", Vx, Vy, nibble); return;
+        case 0xE:
+            switch (byte) {
+                case 0x9E: snprintf(buffer, size, "SKP V%X", Vx); return;
+                case 0xA1: snprintf(buffer, size, "SKNP V%X", Vx); return;
+            }
+            break;
+        case 0xF:
+            if (opcode == 0xF000) { snprintf(buffer, size, "LD I, LONG"); return; }
+            if (opcode == 0xF002) { snprintf(buffer, size, "AUDIO"); return; }
+
+            switch (byte) {
+                case 0x01: snprintf(buffer, size, "PLANE %X", Vx); return;
+                case 0x07: snprintf(buffer, size, "LD V%X, DT", Vx); return;
+                case 0x0A: snprintf(buffer, size, "LD V%X", Vx); return;
+                case 0x15: snprintf(buffer, size, "LD DT, V%X", Vx); return;
+                case 0x18: snprintf(buffer, size, "LD ST, V%X", Vx); return;
+                case 0x1E: snprintf(buffer, size, "ADD I, V%X", Vx); return;
+                case 0x29: snprintf(buffer, size, "LD F, V%X", Vx); return;
+                case 0x30: snprintf(buffer, size, "LD HF, V%X", Vx); return;
+                case 0x33: snprintf(buffer, size, "LD B, V%X", Vx); return;
+                case 0x3A: snprintf(buffer, size, "PITCH V%X", Vx); return;
+                case 0x55: snprintf(buffer, size, "LD I, V%X", Vx); return;
+                case 0x65: snprintf(buffer, size, "LD V%X, I", Vx); return;
+                case 0x75: snprintf(buffer, size, "LD R, V%X", Vx); return;
+                case 0x85: snprintf(buffer, size, "LD V%X, R", Vx); return;
+            }
+            break;
+    }
+
+    // chip8_update ignores opcodes it does not know
+    snprintf(buffer, size, "UNKNOWN %04X", opcode);
+}
+
+void chip8_trace_format(const Chip8TraceRecord* record, char* buffer, size_t size) {
+    char mnemonic[32];
+    chip8_disassemble(record->opcode, mnemonic, sizeof(mnemonic));
+
+    snprintf(buffer, size, "%04x - %s", record->program_counter, mnemonic);
+}
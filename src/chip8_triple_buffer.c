@@ -0,0 +1,61 @@
+#include "chip8_triple_buffer.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+// set in `shared` when the shared slot holds a frame the reader has not seen
+#define FRESH 4u
+#define SLOT_MASK 3u
+
+struct Chip8TripleBuffer {
+    // a cache line each, so the two threads only ever share the slot being handed over
+    _Alignas(64) Chip8Frame frames[3];
+
+    _Alignas(64) atomic_uint shared; // index of the shared slot | FRESH
+
+    _Alignas(64) uint32_t write; // only touched by the writer
+    _Alignas(64) uint32_t read;  // only touched by the reader
+};
+
+Chip8TripleBuffer* chip8_triple_buffer_create() {
+    Chip8TripleBuffer* buffer = aligned_alloc(64, sizeof(Chip8TripleBuffer));
+    if (!buffer) {
+        printf("ERROR: Failed to allocate triple buffer!\n");
+        return NULL;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        buffer->frames[i] = (Chip8Frame) {0};
+    }
+
+    buffer->write = 0;
+    atomic_init(&buffer->shared, 1);
+    buffer->read = 2;
+
+    return buffer;
+}
+
+void chip8_triple_buffer_destroy(Chip8TripleBuffer* buffer) {
+    free(buffer);
+}
+
+Chip8Frame* chip8_triple_buffer_write_slot(Chip8TripleBuffer* buffer) {
+    return &buffer->frames[buffer->write];
+}
+
+void chip8_triple_buffer_publish(Chip8TripleBuffer* buffer) {
+    // release so the frame is written before the reader can take it, acquire for the slot handed back
+    uint32_t previous = atomic_exchange_explicit(&buffer->shared, buffer->write | FRESH, memory_order_acq_rel);
+    buffer->write = previous & SLOT_MASK;
+}
+
+const Chip8Frame* chip8_triple_buffer_read(Chip8TripleBuffer* buffer) {
+    if (!(atomic_load_explicit(&buffer->shared, memory_order_relaxed) & FRESH)) { return NULL; }
+
+    uint32_t previous = atomic_exchange_explicit(&buffer->shared, buffer->read, memory_order_acq_rel);
+    buffer->read = previous & SLOT_MASK;
+
+    return &buffer->frames[buffer->read];
+}
@@ -0,0 +1,626 @@
+#include "chip8_video.h"
+#include "chip8_endian.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define VIDEO_FILE_MAGIC "C8FV"
+#define VIDEO_FILE_VERSION 3
+#define VIDEO_HEADER_SIZE 8
+
+// the tokens below add at most 4 bytes per 3 bytes of frame
+#define MAX_ENCODED_SIZE (CHIP8_VIDEO_FRAME_SIZE * 3)
+
+// a frame header varint and the tokens
+#define MAX_RECORD_SIZE (10 + MAX_ENCODED_SIZE)
+
+// a changed frame that takes more than a low resolution screen is tried as a keyframe too
+#define KEYFRAME_CHECK_SIZE (CHIP8_DISPLAY_WIDTH / 8 * CHIP8_DISPLAY_HEIGHT)
+
+// chunks hold many frames, a chunk is handed to the writer thread when it is full or this many frames old
+#define CHUNK_SIZE (16 * 1024)
+#define CHUNK_COUNT 4
+#define CHUNK_MAX_FRAMES (60 * 5)
+
+// the chunk compression looks for matches of at least this many bytes through a hash chain of the last positions
+#define MATCH_MIN 4
+#define MATCH_HASH_BITS 12
+#define MATCH_CHAIN 64
+
+// the two varints in front of a chunk
+#define MAX_CHUNK_HEADER_SIZE 20
+
+typedef struct VideoChunk {
+    uint8_t data[CHUNK_SIZE];
+    size_t size;
+} VideoChunk;
+
+struct Chip8VideoWriter {
+    FILE* file;
+    int wait_for_disk;
+
+    // only touched by the thread adding frames
+    VideoChunk* current;
+    uint64_t current_first_frame;
+    uint8_t previous[CHIP8_VIDEO_FRAME_SIZE]; // the last frame encoded
+    uint64_t previous_frame;
+    uint32_t frames_since_keyframe;
+    uint64_t frames;
+    uint64_t dropped;
+    uint8_t encoded[MAX_ENCODED_SIZE];
+    uint8_t encoded_keyframe[MAX_ENCODED_SIZE];
+
+    // chunks waiting to be written, oldest first, and the empty ones, both guarded by `lock`
+    pthread_mutex_t lock;
+    pthread_cond_t condition;       // a chunk was queued or the writer is finishing
+    pthread_cond_t free_condition;  // a chunk was written
+    VideoChunk* full[CHUNK_COUNT];
+    uint32_t full_first;
+    uint32_t full_count;
+    VideoChunk* empty[CHUNK_COUNT];
+    uint32_t empty_count;
+    int finishing;
+    int failed;
+
+    pthread_t thread;
+    VideoChunk chunks[CHUNK_COUNT];
+
+    // only touched by the writer thread
+    uint8_t window[2 * CHUNK_SIZE]; // the last chunk written, then the one being compressed
+    size_t history_size;
+    uint8_t compressed[CHUNK_SIZE];
+    int32_t match_head[1 << MATCH_HASH_BITS];
+    int32_t match_previous[2 * CHUNK_SIZE];
+};
+
+struct Chip8VideoReader {
+    // the frames of every chunk decompressed one after the other
+    uint8_t* data;
+    size_t size;
+    size_t position;
+    int damaged; // a chunk could not be read, the frames end before it
+
+    uint8_t frame[CHIP8_VIDEO_FRAME_SIZE];
+    uint64_t frame_number;
+    uint64_t frames_read;
+};
+
+static const uint8_t blank_frame[CHIP8_VIDEO_FRAME_SIZE];
+
+static void write_u64_be(uint8_t* buffer, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (uint8_t) (value >> (56 - i * 8));
+    }
+}
+
+static uint64_t read_u64_be(const uint8_t* buffer) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t) buffer[i] << (56 - i * 8);
+    }
+
+    return value;
+}
+
+// rows as big endian words, so the leftmost pixel lands in the top bit of the first byte
+static void display_to_bytes(const Chip8Display* display, uint8_t* bytes) {
+    *bytes++ = display->hires;
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            for (int word = 0; word < CHIP8_DISPLAY_WORDS; word++) {
+                write_u64_be(bytes, display->planes[plane][y][word]);
+                bytes += 8;
+            }
+        }
+    }
+}
+
+static void bytes_to_display(const uint8_t* bytes, Chip8Display* display) {
+    memset(display, 0, sizeof(Chip8Display));
+    display->hires = *bytes++ ? 1 : 0;
+
+    for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+        for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            for (int word = 0; word < CHIP8_DISPLAY_WORDS; word++) {
+                display->planes[plane][y][word] = read_u64_be(bytes);
+                bytes += 8;
+            }
+        }
+    }
+}
+
+// a list of (unchanged bytes, changed bytes, changed bytes xored with the reference) tokens, as in chip8_rewind.c
+static size_t encode(const uint8_t* frame, const uint8_t* reference, uint8_t* buffer) {
+    size_t size = 0;
+    size_t i = 0;
+
+    while (i < CHIP8_VIDEO_FRAME_SIZE) {
+        size_t start = i;
+        while (i < CHIP8_VIDEO_FRAME_SIZE && frame[i] == reference[i]) { i++; }
+        size_t unchanged = i - start;
+
+        // a single unchanged byte is cheaper to copy than to start a new token for
+        start = i;
+        while (i < CHIP8_VIDEO_FRAME_SIZE &&
+               (frame[i] != reference[i] || (i + 1 < CHIP8_VIDEO_FRAME_SIZE && frame[i + 1] != reference[i + 1]))) {
+            i++;
+        }
+        size_t changed = i - start;
+
+        size += write_varint(buffer + size, unchanged);
+        size += write_varint(buffer + size, changed);
+        for (size_t j = start; j < i; j++) {
+            buffer[size++] = frame[j] ^ reference[j];
+        }
+    }
+
+    return size;
+}
+
+static uint32_t match_hash(const uint8_t* data) {
+    return (read_u32(data) * 2654435761u) >> (32 - MATCH_HASH_BITS);
+}
+
+// a sequence is a token byte (literal count << 4 | match length - MATCH_MIN), each half followed by a varint
+// with the rest of the count when it is 15, the literals, then the match offset as a varint (0 for the same
+// offset as the last match, frames repeating the ones a few back keep matching at the same distance),
+// the last sequence of a chunk stops after its literals
+static size_t write_sequence(uint8_t* buffer, const uint8_t* literals, size_t literal_count, size_t match_length, size_t match_offset) {
+    size_t match_code = match_length ? match_length - MATCH_MIN : 0;
+    size_t size = 0;
+
+    buffer[size++] = (uint8_t) (((literal_count < 15) ? literal_count : 15) << 4 | ((match_code < 15) ? match_code : 15));
+    if (literal_count >= 15) { size += write_varint(buffer + size, literal_count - 15); }
+
+    memcpy(buffer + size, literals, literal_count);
+    size += literal_count;
+
+    if (match_length) {
+        size += write_varint(buffer + size, match_offset);
+        if (match_code >= 15) { size += write_varint(buffer + size, match_code - 15); }
+    }
+
+    return size;
+}
+
+// LZ77 over a whole chunk, matches can reach back into the chunk before it so frames that repeat earlier
+// ones a few frames back cost a few bytes even at the start of a chunk, returns 0 when the result would
+// not be smaller than the chunk
+static size_t compress_chunk(Chip8VideoWriter* writer, const uint8_t* data, size_t size) {
+    uint8_t* window = writer->window;
+    int32_t* head = writer->match_head;
+    int32_t* previous = writer->match_previous;
+    for (size_t i = 0; i < (1 << MATCH_HASH_BITS); i++) { head[i] = -1; }
+
+    size_t start = writer->history_size;
+    size_t end = start + size;
+    memcpy(window + start, data, size);
+
+    for (size_t i = 0; i + MATCH_MIN <= start; i++) {
+        uint32_t hash = match_hash(window + i);
+        previous[i] = head[hash];
+        head[hash] = (int32_t) i;
+    }
+
+    uint8_t* out = writer->compressed;
+    size_t out_size = 0;
+    size_t last_offset = 0;
+    size_t literal_start = start;
+    size_t i = start;
+
+    while (i + MATCH_MIN <= end) {
+        uint32_t hash = match_hash(window + i);
+
+        size_t best_length = 0;
+        size_t best_offset = 0;
+        int32_t candidate = head[hash];
+        for (int depth = 0; candidate >= 0 && depth < MATCH_CHAIN; depth++) {
+            size_t length = 0;
+            while (i + length < end && window[candidate + length] == window[i + length]) { length++; }
+            if (length > best_length) {
+                best_length = length;
+                best_offset = i - (size_t) candidate;
+            }
+            candidate = previous[candidate];
+        }
+
+        previous[i] = head[hash];
+        head[hash] = (int32_t) i;
+
+        if (best_length < MATCH_MIN) {
+            i++;
+            continue;
+        }
+
+        // the token, three varints and the literals
+        if (out_size + 31 + (i - literal_start) >= size) { break; }
+        out_size += write_sequence(out + out_size, window + literal_start, i - literal_start, best_length,
+                                   (best_offset == last_offset) ? 0 : best_offset);
+        last_offset = best_offset;
+
+        for (size_t j = i + 1; j < i + best_length && j + MATCH_MIN <= end; j++) {
+            uint32_t skipped_hash = match_hash(window + j);
+            previous[j] = head[skipped_hash];
+            head[skipped_hash] = (int32_t) j;
+        }
+
+        i += best_length;
+        literal_start = i;
+    }
+
+    if (i + MATCH_MIN <= end || out_size + 11 + (end - literal_start) >= size) {
+        out_size = 0;
+    } else {
+        out_size += write_sequence(out + out_size, window + literal_start, end - literal_start, 0, 0);
+    }
+
+    // the next chunk matches against this one, however it was stored
+    memmove(window, window + start, size);
+    writer->history_size = size;
+
+    return out_size;
+}
+
+// `out` follows the `history` bytes decoded before it, returns -1 unless `data` decodes to exactly `size` bytes
+static int decompress_chunk(const uint8_t* data, size_t data_size, uint8_t* out, size_t history, size_t size) {
+    size_t position = 0;
+    size_t out_size = 0;
+    uint64_t last_offset = 0;
+
+    for (;;) {
+        if (position >= data_size) { return -1; }
+        uint8_t token = data[position++];
+
+        size_t literal_count = token >> 4;
+        if (literal_count == 15) { literal_count += read_varint(data, &position); }
+        if (position > data_size || literal_count > data_size - position || literal_count > size - out_size) { return -1; }
+
+        memcpy(out + out_size, data + position, literal_count);
+        position += literal_count;
+        out_size += literal_count;
+        if (out_size == size) { return position == data_size ? 0 : -1; }
+
+        uint64_t offset = read_varint(data, &position);
+        if (offset == 0) { offset = last_offset; }
+        last_offset = offset;
+        uint64_t match_length = (token & 0x0F) + MATCH_MIN;
+        if ((token & 0x0F) == 15) { match_length += read_varint(data, &position); }
+        if (position > data_size || offset == 0 || offset > history + out_size || match_length > size - out_size) { return -1; }
+
+        // matches can overlap what they copy
+        uint8_t* to = out + out_size;
+        const uint8_t* from = to - offset;
+        for (uint64_t i = 0; i < match_length; i++) { to[i] = from[i]; }
+        out_size += match_length;
+    }
+}
+
+// a chunk is two varints, its size and the size stored, then the compressed data, or the chunk itself
+// when both sizes are the same
+static int write_chunk(Chip8VideoWriter* writer, const VideoChunk* chunk) {
+    size_t compressed_size = compress_chunk(writer, chunk->data, chunk->size);
+    const uint8_t* stored = compressed_size ? writer->compressed : chunk->data;
+    size_t stored_size = compressed_size ? compressed_size : chunk->size;
+
+    uint8_t header[MAX_CHUNK_HEADER_SIZE];
+    size_t header_size = write_varint(header, chunk->size);
+    header_size += write_varint(header + header_size, stored_size);
+
+    if (fwrite(header, 1, header_size, writer->file) != header_size) { return -1; }
+    if (fwrite(stored, 1, stored_size, writer->file) != stored_size) { return -1; }
+
+    return fflush(writer->file);
+}
+
+static void* writer_main(void* data) {
+    Chip8VideoWriter* writer = data;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->full_count == 0 && !writer->finishing) {
+            pthread_cond_wait(&writer->condition, &writer->lock);
+        }
+        if (writer->full_count == 0) { break; }
+
+        VideoChunk* chunk = writer->full[writer->full_first];
+        writer->full_first = (writer->full_first + 1) % CHUNK_COUNT;
+        writer->full_count--;
+
+        // compressing and the disk are only waited on with the lock released
+        pthread_mutex_unlock(&writer->lock);
+        int failed = write_chunk(writer, chunk) != 0;
+        chunk->size = 0;
+        pthread_mutex_lock(&writer->lock);
+
+        if (failed) { writer->failed = 1; }
+        writer->empty[writer->empty_count++] = chunk;
+        pthread_cond_signal(&writer->free_condition);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+// queues the current chunk for writing and takes an empty one, leaving `current` NULL if there is none
+static void submit_chunk(Chip8VideoWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+
+    writer->full[(writer->full_first + writer->full_count) % CHUNK_COUNT] = writer->current;
+    writer->full_count++;
+    writer->current = (writer->empty_count > 0) ? writer->empty[--writer->empty_count] : NULL;
+
+    pthread_cond_signal(&writer->condition);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// takes an empty chunk back if the writer has freed one since, or waits for one when the writer was told to
+static void take_chunk(Chip8VideoWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    while (writer->wait_for_disk && writer->empty_count == 0) {
+        pthread_cond_wait(&writer->free_condition, &writer->lock);
+    }
+    if (writer->empty_count > 0) { writer->current = writer->empty[--writer->empty_count]; }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+Chip8VideoWriter* chip8_video_writer_create(const char* file, int wait_for_disk) {
+    Chip8VideoWriter* writer = calloc(1, sizeof(Chip8VideoWriter));
+    if (!writer) {
+        printf("ERROR: Failed to allocate video writer!\n");
+        return NULL;
+    }
+
+    writer->file = fopen(file, "wb");
+    if (!writer->file) {
+        printf("ERROR: Failed to open video file!\n");
+        free(writer);
+        return NULL;
+    }
+
+    // stays in the stdio buffer until the first chunk is written
+    uint8_t header[VIDEO_HEADER_SIZE];
+    memcpy(header, VIDEO_FILE_MAGIC, 4);
+    write_u32(header + 4, VIDEO_FILE_VERSION);
+    if (fwrite(header, 1, VIDEO_HEADER_SIZE, writer->file) != VIDEO_HEADER_SIZE) {
+        printf("ERROR: Failed to write video file!\n");
+        fclose(writer->file);
+        free(writer);
+        return NULL;
+    }
+
+    writer->wait_for_disk = wait_for_disk;
+    writer->current = &writer->chunks[0];
+
+    for (int i = 1; i < CHUNK_COUNT; i++) {
+        writer->empty[writer->empty_count++] = &writer->chunks[i];
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->condition, NULL);
+    pthread_cond_init(&writer->free_condition, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        printf("ERROR: Failed to start video writer!\n");
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->condition);
+        pthread_cond_destroy(&writer->free_condition);
+        fclose(writer->file);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+int chip8_video_writer_add(Chip8VideoWriter* writer, const Chip8Display* display, uint64_t frame) {
+    writer->frames++;
+
+    if (!writer->current) { take_chunk(writer); }
+    if (!writer->current) {
+        writer->dropped++;
+        return -1;
+    }
+
+    uint8_t bytes[CHIP8_VIDEO_FRAME_SIZE];
+    display_to_bytes(display, bytes);
+
+    // the first frame has nothing to be encoded against
+    int keyframe = writer->frames == writer->dropped + 1 || writer->frames_since_keyframe + 1 >= CHIP8_VIDEO_KEYFRAME_INTERVAL;
+    size_t encoded_size = keyframe ? 0 : encode(bytes, writer->previous, writer->encoded);
+    size_t keyframe_size = (keyframe || encoded_size > KEYFRAME_CHECK_SIZE) ? encode(bytes, blank_frame, writer->encoded_keyframe) : 0;
+    if (!keyframe && encoded_size > KEYFRAME_CHECK_SIZE && keyframe_size <= encoded_size) { keyframe = 1; }
+
+    VideoChunk* chunk = writer->current;
+    if (chunk->size == 0) { writer->current_first_frame = frame; }
+
+    chunk->size += write_varint(chunk->data + chunk->size, ((frame - writer->previous_frame) << 1) | (uint64_t) keyframe);
+    if (keyframe) {
+        memcpy(chunk->data + chunk->size, writer->encoded_keyframe, keyframe_size);
+        chunk->size += keyframe_size;
+        writer->frames_since_keyframe = 0;
+    } else {
+        memcpy(chunk->data + chunk->size, writer->encoded, encoded_size);
+        chunk->size += encoded_size;
+        writer->frames_since_keyframe++;
+    }
+
+    memcpy(writer->previous, bytes, CHIP8_VIDEO_FRAME_SIZE);
+    writer->previous_frame = frame;
+
+    // always leave room for the next frame
+    if (chunk->size + MAX_RECORD_SIZE > CHUNK_SIZE || frame - writer->current_first_frame >= CHUNK_MAX_FRAMES) {
+        submit_chunk(writer);
+    }
+
+    return 0;
+}
+
+uint64_t chip8_video_writer_frames(const Chip8VideoWriter* writer) {
+    return writer->frames;
+}
+
+uint64_t chip8_video_writer_dropped(const Chip8VideoWriter* writer) {
+    return writer->dropped;
+}
+
+int chip8_video_writer_finish(Chip8VideoWriter* writer) {
+    if (!writer) { return 0; }
+
+    if (writer->current && writer->current->size > 0) { submit_chunk(writer); }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->finishing = 1;
+    pthread_cond_signal(&writer->condition);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    int failed = writer->failed;
+    if (fclose(writer->file) != 0) { failed = 1; }
+    if (failed) { printf("ERROR: Failed to write video file!\n"); }
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->condition);
+    pthread_cond_destroy(&writer->free_condition);
+    free(writer);
+
+    return failed ? -1 : 0;
+}
+
+// decompresses every chunk of the file into reader->data, a chunk that can not be read ends the frames early
+static int read_chunks(Chip8VideoReader* reader, const uint8_t* data, size_t data_size) {
+    size_t capacity = 0;
+    size_t position = VIDEO_HEADER_SIZE;
+
+    while (position < data_size) {
+        uint64_t size = read_varint(data, &position);
+        uint64_t stored_size = read_varint(data, &position);
+        if (position > data_size || size > CHUNK_SIZE || stored_size > size || stored_size > data_size - position) {
+            reader->damaged = 1;
+            break;
+        }
+
+        // zero padding past the end lets a truncated frame be read without checking every byte
+        if (reader->size + size + MAX_ENCODED_SIZE > capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 4 * CHUNK_SIZE;
+            while (reader->size + size + MAX_ENCODED_SIZE > new_capacity) { new_capacity *= 2; }
+
+            uint8_t* frames = realloc(reader->data, new_capacity);
+            if (!frames) { return -1; }
+
+            reader->data = frames;
+            capacity = new_capacity;
+        }
+
+        uint8_t* chunk = reader->data + reader->size;
+        if (stored_size == size) {
+            memcpy(chunk, data + position, size);
+        } else if (decompress_chunk(data + position, stored_size, chunk, reader->size, size) != 0) {
+            reader->damaged = 1;
+            break;
+        }
+
+        reader->size += size;
+        position += stored_size;
+    }
+
+    if (!reader->data) {
+        reader->data = malloc(MAX_ENCODED_SIZE);
+        if (!reader->data) { return -1; }
+    }
+    memset(reader->data + reader->size, 0, MAX_ENCODED_SIZE);
+
+    return 0;
+}
+
+Chip8VideoReader* chip8_video_reader_open(const char* file) {
+    FILE* video_file = fopen(file, "rb");
+    if (!video_file) {
+        printf("ERROR: Failed to open video file!\n");
+        return NULL;
+    }
+
+    fseek(video_file, 0, SEEK_END);
+    long file_size = ftell(video_file);
+    fseek(video_file, 0, SEEK_SET);
+
+    // padded so the varints of a truncated chunk header can be read without checking every byte
+    Chip8VideoReader* reader = calloc(1, sizeof(Chip8VideoReader));
+    uint8_t* data = (file_size > 0) ? calloc(1, file_size + MAX_CHUNK_HEADER_SIZE) : NULL;
+    if (!reader || !data || fread(data, 1, file_size, video_file) != (size_t) file_size) {
+        printf("ERROR: Failed to read video file!\n");
+        free(reader);
+        free(data);
+        fclose(video_file);
+        return NULL;
+    }
+    fclose(video_file);
+
+    if (file_size < VIDEO_HEADER_SIZE || memcmp(data, VIDEO_FILE_MAGIC, 4) != 0 || read_u32(data + 4) != VIDEO_FILE_VERSION) {
+        printf("ERROR: Not a video file!\n");
+        free(reader);
+        free(data);
+        return NULL;
+    }
+
+    int failed = read_chunks(reader, data, (size_t) file_size);
+    free(data);
+    if (failed) {
+        printf("ERROR: Failed to allocate video frames!\n");
+        chip8_video_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void chip8_video_reader_close(Chip8VideoReader* reader) {
+    if (!reader) { return; }
+
+    free(reader->data);
+    free(reader);
+}
+
+int chip8_video_reader_next(Chip8VideoReader* reader, Chip8Display* display, uint64_t* frame) {
+    if (reader->position >= reader->size) {
+        if (!reader->damaged) { return 0; }
+
+        printf("ERROR: Video file is truncated!\n");
+        return -1;
+    }
+
+    uint64_t header = read_varint(reader->data, &reader->position);
+    reader->frame_number += header >> 1;
+
+    if (header & 1) {
+        memset(reader->frame, 0, CHIP8_VIDEO_FRAME_SIZE);
+    } else if (reader->frames_read == 0) {
+        // the first frame of a file is always a keyframe
+        return -1;
+    }
+
+    size_t i = 0;
+    while (i < CHIP8_VIDEO_FRAME_SIZE && reader->position <= reader->size) {
+        uint64_t unchanged = read_varint(reader->data, &reader->position);
+        uint64_t changed = read_varint(reader->data, &reader->position);
+        if (unchanged > CHIP8_VIDEO_FRAME_SIZE - i || changed > CHIP8_VIDEO_FRAME_SIZE - i - unchanged) { return -1; }
+
+        i += unchanged;
+        for (uint64_t j = 0; j < changed; j++) {
+            reader->frame[i++] ^= reader->data[reader->position++];
+        }
+    }
+
+    if (reader->position > reader->size) {
+        printf("ERROR: Video file is truncated!\n");
+        return -1;
+    }
+
+    bytes_to_display(reader->frame, display);
+    *frame = reader->frame_number;
+    reader->frames_read++;
+
+    return 1;
+}
@@ -2,20 +2,337 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #include <time.h>
 
 #include <SDL3/SDL.h>
 
 #include "chip8.h"
+#include "chip8_rewind.h"
+#include "chip8_recording.h"
+#include "chip8_triple_buffer.h"
+#include "chip8_clock.h"
+#include "chip8_engine.h"
+#include "chip8_profile.h"
+#include "chip8_rom.h"
+#include "chip8_audio.h"
+#include "chip8_video.h"
+#include "chip8_input.h"
 
 // what number to scale the chip8's resolution (64 x 32) by
 #define SCALE 15
-#define INSTRUCTIONS_PER_CYCLE 11
 
-int main(int argc, char* argv[]) {
-    // set random seed
-    srand(time(0));
+// memory for rewinding (hold backspace), and how often a full frame is kept
+#define REWIND_MEMORY (16 * 1024 * 1024)
+#define REWIND_KEYFRAME_INTERVAL 60
+
+// the most frames --run-ahead can look ahead
+#define MAX_RUN_AHEAD 8
+
+// how many frames apart a recording checks the display on replay
+#define RECORDING_CHECKPOINT_INTERVAL 60
+
+#define FRAME_NS (SDL_NS_PER_SECOND / 60)
+
+// the scheduler sleeps until this close to a frame and spins the rest, it grows when sleeps overshoot by more
+#define MIN_SPIN_NS 200000
+#define MAX_SPIN_NS 4000000
+
+// when the emulation falls further behind than this (e.g. the machine was suspended) it starts over from now
+#define MAX_FRAMES_BEHIND 5
+
+// the beep is written a frame at a time and the device asks for small buffers, so it starts within a
+// few milliseconds of the frame that set the sound timer, anything queued beyond that is dropped
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_SAMPLES_PER_FRAME (AUDIO_SAMPLE_RATE / 60)
+#define AUDIO_DEVICE_SAMPLES "256"
+#define AUDIO_MAX_QUEUED (AUDIO_SAMPLES_PER_FRAME + 256)
+#define AUDIO_RING_CAPACITY 4096
+#define AUDIO_VOLUME 0.1f
+
+// key changes waiting for the emulation thread, far more than anyone can press in a frame
+#define INPUT_QUEUE_CAPACITY 256
+
+// everything the emulation thread owns, plus the few fields the main thread talks to it through
+typedef struct Emulation {
+    Chip8 chip8;
+    Chip8Engine* engine;
+    Chip8Clock clock;
+    Chip8Rewind* rewind;
+
+    // the clock and quirks from the command line, with --rom-db known roms get their own for whatever it leaves out
+    Chip8Timing timing;
+    bool timing_set;
+    uint32_t clock_rate;
+    Chip8Quirks quirks;
+    bool quirks_set;
+    Chip8RomDatabase* database;
+
+    Chip8Recording* recording;
+
+    // with --video every frame handed over is also recorded, the file is written from a thread of its own
+    Chip8VideoWriter* video;
+
+    // with --run-ahead the frame shown is that many frames further on, run on a clone with the keys held now,
+    // so a key press shows up without waiting for the frames the rom takes to react to it
+    uint32_t run_ahead;
+    Chip8 ahead;
+    Chip8Engine* ahead_engine;
+    Chip8Display published; // the last display handed over while running ahead
+
+    // the beep, generated here and played from sdl's audio thread, NULL without an audio device
+    Chip8AudioRing* audio;
+    Chip8Tone tone;
+    float audio_samples[AUDIO_SAMPLES_PER_FRAME];
+    const char* record_file;
+    uint64_t instructions_run; // since the recording started
+    uint64_t frames_run;
+
+    // with --profile the emulation is profiled and every frame timed, written out on exit
+    const char* profile_file;
+    const char* stacks_file;
+
+    // frames go to the main thread through here, which gets woken by a `wake_event`
+    Chip8TripleBuffer* frames;
+    uint64_t last_publish;
+    uint32_t wake_event;
+    atomic_bool wake_pending;
+
+    // set by the main thread
+    atomic_bool running;
+    Chip8Input* input;         // key changes with the time they happened, see chip8_input.h
+    atomic_bool rewinding;
+    atomic_bool turbo;         // run frames back to back, the timers still tick once per emulated frame
+    _Atomic(char*) next_rom;   // a dropped rom to load, freed by the emulation thread
+
+    uint64_t spin_ns;
+} Emulation;
+
+// loads a rom with the clock and quirks the database has for it, returns its hash or 0 if it could not be loaded
+static uint64_t load_rom(Emulation* emulation, const char* file) {
+    Chip8Rom rom;
+    if (chip8_rom_read(&rom, file) != 0 || chip8_rom_load(&emulation->chip8, &rom) != 0) { return 0; }
+
+    Chip8Timing timing = CHIP8_TIMING_FIXED;
+    uint32_t clock_rate = 0;
+    Chip8Quirks quirks = CHIP8_QUIRKS_DEFAULT;
+    chip8_rom_profile_apply(chip8_rom_database_find(emulation->database, rom.hash), &timing, &clock_rate, &quirks);
+    if (emulation->timing_set) { timing = emulation->timing; }
+    if (emulation->clock_rate) { clock_rate = emulation->clock_rate; }
+    if (emulation->quirks_set) { quirks = emulation->quirks; }
+    emulation->clock = chip8_clock_create(timing, clock_rate);
+    emulation->chip8.quirks = quirks;
+
+    return rom.hash;
+}
+
+// saves the recording made so far and stops recording
+static void finish_recording(Chip8Recording** recording, const char* file, uint64_t instructions_run) {
+    if (!*recording) { return; }
+
+    (*recording)->length = instructions_run;
+    chip8_recording_save(*recording, file);
+
+    chip8_recording_destroy(*recording);
+    *recording = NULL;
+}
+
+// sleeps most of the way to `deadline` and spins the rest, sleeping alone can be late by a millisecond or more
+static void wait_until(Emulation* emulation, uint64_t deadline) {
+    uint64_t now = SDL_GetTicksNS();
+
+    if (deadline > now + emulation->spin_ns) {
+        uint64_t wake_time = deadline - emulation->spin_ns;
+        SDL_DelayNS(wake_time - now);
+
+        // keep enough spin time to cover the worst recent oversleep, letting it shrink back slowly
+        now = SDL_GetTicksNS();
+        uint64_t oversleep = (now > wake_time) ? now - wake_time : 0;
+        uint64_t spin_ns = emulation->spin_ns - emulation->spin_ns / 16;
+        if (oversleep * 2 > spin_ns) { spin_ns = oversleep * 2; }
+
+        emulation->spin_ns = (spin_ns < MIN_SPIN_NS) ? MIN_SPIN_NS : (spin_ns > MAX_SPIN_NS) ? MAX_SPIN_NS : spin_ns;
+    }
+
+    while (SDL_GetTicksNS() < deadline) {
+        SDL_CPUPauseInstruction();
+    }
+}
+
+static void run_frame(Emulation* emulation) {
+    Chip8* chip8 = &emulation->chip8;
+
+    // the frame stands for the time since the last one, key changes land where they fall in it
+    uint64_t frame_end = SDL_GetTicksNS();
+
+    char* rom = atomic_exchange(&emulation->next_rom, NULL);
+    if (rom) {
+        // a recording only covers the rom it was started with
+        finish_recording(&emulation->recording, emulation->record_file, emulation->instructions_run);
+
+        load_rom(emulation, rom);
+        chip8_engine_reset(emulation->engine);
+        if (chip8->profile) { chip8_profile_clear(chip8->profile); }
+        if (emulation->rewind) { chip8_rewind_clear(emulation->rewind); }
+        SDL_free(rom);
+    }
+
+    // rewinding would make the recorded input meaningless
+    bool rewinding = atomic_load(&emulation->rewinding) && emulation->rewind && !emulation->recording;
+    if (rewinding && chip8_rewind_size(emulation->rewind) > 1) {
+        // step back a frame, the newest frame held is the one on screen
+        chip8_rewind_drop(emulation->rewind, 1);
+        chip8_rewind_restore(emulation->rewind, 0, chip8);
+        chip8_engine_reset(emulation->engine);
+    }
+
+    // the keys being held stay as they are, even when rewinding
+    if (rewinding) { chip8_input_apply(emulation->input, chip8, frame_end); }
+
+    if (!rewinding) {
+        // run the instructions and update the timers, with the recording getting every key change at the instruction it landed on
+        uint64_t frame_start = chip8->profile ? SDL_GetTicksNS() : 0;
+        uint64_t instructions = chip8_input_run_frame(emulation->input, &emulation->clock, emulation->engine, chip8, frame_end,
+                                                      emulation->recording, emulation->instructions_run);
+        if (chip8->profile) { chip8_profile_add_frame(chip8->profile, (double) (SDL_GetTicksNS() - frame_start) / SDL_NS_PER_SECOND); }
+        if (emulation->rewind && chip8->program_loaded) { chip8_rewind_push(emulation->rewind, chip8); }
+        emulation->frames_run++;
+
+        // the sound timer has already ticked, so like the VIP a sound timer of 1 is too short to be heard,
+        // silence is not written at all so a beep never waits behind it, and fast forwarding is muted
+        if (emulation->audio && chip8->sound_timer > 0 && !atomic_load(&emulation->turbo)) {
+            // XO-CHIP roms can change the pattern and its pitch at any time
+            chip8_tone_set_pattern(&emulation->tone, chip8->audio_pattern);
+            chip8_tone_set_pitch(&emulation->tone, chip8->pitch);
+            chip8_tone_generate(&emulation->tone, emulation->audio_samples, AUDIO_SAMPLES_PER_FRAME);
+            chip8_audio_ring_write(emulation->audio, emulation->audio_samples, AUDIO_SAMPLES_PER_FRAME);
+        } else {
+            emulation->tone.phase = 0;
+        }
+
+        if (emulation->recording) {
+            emulation->instructions_run += instructions;
+            if (emulation->frames_run % RECORDING_CHECKPOINT_INTERVAL == 0) {
+                chip8_recording_add_checkpoint(emulation->recording, emulation->instructions_run, chip8_display_hash(chip8));
+            }
+        }
+    }
+
+    // fast forwarding would hand over far more frames than can be shown, the dirty rows wait for the next one
+    uint64_t now = SDL_GetTicksNS();
+    if (atomic_load(&emulation->turbo) && now - emulation->last_publish < FRAME_NS) { return; }
+
+    // only frames that changed the display are handed over
+    int first_row, row_count;
+    bool changed = chip8_display_take_dirty(chip8, &first_row, &row_count);
+
+    // the speculative frames never touch the real state, so the clone is simply thrown away the next time
+    const Chip8Display* display = &chip8->display;
+    if (emulation->run_ahead && !rewinding && chip8->program_loaded) {
+        chip8_clone(&emulation->ahead, chip8);
+        Chip8Clock clock = emulation->clock;
+        for (uint32_t i = 0; i < emulation->run_ahead; i++) {
+            chip8_clock_run_frame(&clock, emulation->ahead_engine, &emulation->ahead);
+        }
+
+        display = &emulation->ahead.display;
+        changed = memcmp(display, &emulation->published, sizeof(emulation->published)) != 0;
+        emulation->published = *display;
+    }
+    if (!changed) { return; }
+    emulation->last_publish = now;
+
+    Chip8Frame* frame = chip8_triple_buffer_write_slot(emulation->frames);
+    frame->display = *display;
+    frame->number = emulation->frames_run;
+    chip8_triple_buffer_publish(emulation->frames);
+
+    if (emulation->video) { chip8_video_writer_add(emulation->video, display, emulation->frames_run); }
+
+    // one wake up event at a time, the main thread always takes the newest frame anyway
+    if (!atomic_exchange(&emulation->wake_pending, true)) {
+        SDL_Event wake = {0};
+        wake.type = emulation->wake_event;
+        SDL_PushEvent(&wake);
+    }
+}
 
+// runs on sdl's audio thread whenever the device needs more samples, the ring running dry plays silence
+static void SDLCALL feed_audio(void* data, SDL_AudioStream* stream, int additional_amount, int total_amount) {
+    Emulation* emulation = data;
+    chip8_audio_ring_trim(emulation->audio, AUDIO_MAX_QUEUED);
+
+    float samples[256];
+    int needed = additional_amount / (int) sizeof(float);
+    while (needed > 0) {
+        uint32_t count = (needed < 256) ? (uint32_t) needed : 256;
+        uint32_t read = chip8_audio_ring_read(emulation->audio, samples, count);
+        memset(&samples[read], 0, (count - read) * sizeof(float));
+
+        SDL_PutAudioStreamData(stream, samples, (int) (count * sizeof(float)));
+        needed -= (int) count;
+    }
+}
+
+// opens the default playback device, the emulator runs silently when there is none
+static SDL_AudioStream* open_audio(Emulation* emulation) {
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, AUDIO_DEVICE_SAMPLES);
+    if (!SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+        printf("ERROR: Failed to initialize SDL audio, running without sound!\n");
+        return NULL;
+    }
+
+    emulation->audio = chip8_audio_ring_create(AUDIO_RING_CAPACITY);
+    if (!emulation->audio) { return NULL; }
+    emulation->tone = chip8_tone_create(AUDIO_SAMPLE_RATE, AUDIO_VOLUME);
+
+    SDL_AudioSpec spec = {SDL_AUDIO_F32, 1, AUDIO_SAMPLE_RATE};
+    SDL_AudioStream* stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, feed_audio, emulation);
+    if (!stream) {
+        printf("ERROR: Failed to open an audio device, running without sound!\n");
+        chip8_audio_ring_destroy(emulation->audio);
+        emulation->audio = NULL;
+        return NULL;
+    }
+
+    SDL_ResumeAudioStreamDevice(stream);
+    return stream;
+}
+
+// one texel per chip8 pixel of the display's resolution, stretched over the window
+static SDL_Texture* create_display_texture(SDL_Renderer* renderer, const Chip8Display* display) {
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING,
+                                             chip8_display_width(display), chip8_display_height(display));
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+
+    return texture;
+}
+
+static int emulation_thread(void* data) {
+    Emulation* emulation = data;
+    emulation->spin_ns = MIN_SPIN_NS;
+
+    uint64_t next_frame = SDL_GetTicksNS();
+    while (atomic_load(&emulation->running)) {
+        run_frame(emulation);
+
+        // frames are scheduled against a fixed timeline so the rate does not drift with how long they take
+        next_frame += FRAME_NS;
+
+        uint64_t now = SDL_GetTicksNS();
+        if (atomic_load(&emulation->turbo) || now > next_frame + MAX_FRAMES_BEHIND * FRAME_NS) {
+            next_frame = now;
+            continue;
+        }
+
+        wait_until(emulation, next_frame);
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
     // init sdl
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         printf("ERROR: Failed to initialize SDL!\n");
@@ -42,60 +359,190 @@ int main(int argc, char* argv[]) {
                                   SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F,
                                   SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V};
 
-    // create texture which will be used to display the chip8's framebuffer
-    SDL_Texture* chip8_display_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING, 64, 32);
-    SDL_SetTextureScaleMode(chip8_display_texture, SDL_SCALEMODE_NEAREST);
+    // the display as it is on screen, its dirty rows are the ones the newest frame changed
+    Chip8 shown = chip8_create();
+
+    // create texture which will be used to display the chip8's framebuffer, it is made again when the resolution changes
+    SDL_Texture* chip8_display_texture = create_display_texture(renderer, &shown.display);
 
-    // the chip8 itself
-    Chip8 chip8 = chip8_create();
+    // the unpacked framebuffer uploaded to the texture
+    uint8_t pixels[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT];
 
-    // used to limit the application to 60 fps
-    uint64_t last_time = SDL_GetPerformanceCounter();
+    // set when the window has to be drawn again even though the display did not change
+    bool redraw = true;
+
+    // the rom to start with, and with --record every keypad change is saved so chip8-run --replay can play the session again,
+    // --profile and --profile-stacks save a profile of the last rom played (see chip8_profile.h),
+    // --quirks picks the behaviour of the ambiguous instructions (see chip8.h),
+    // --video saves every frame shown so chip8-video can turn it into images (see chip8_video.h),
+    // --run-ahead N shows every frame as it will be N frames later if the keys stay as they are,
+    // --rom-db gives known roms their own clock and quirks (see chip8_rom.h)
+    const char* rom = NULL;
+    static Emulation emulation;
+    const char* database_file = NULL;
+    const char* video_file = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            emulation.record_file = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            emulation.profile_file = argv[++i];
+        } else if (strcmp(argv[i], "--profile-stacks") == 0 && i + 1 < argc) {
+            emulation.stacks_file = argv[++i];
+        } else if (strcmp(argv[i], "--rom-db") == 0 && i + 1 < argc) {
+            database_file = argv[++i];
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            video_file = argv[++i];
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            emulation.clock_rate = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc) {
+            if (chip8_timing_parse(argv[++i], &emulation.timing) != 0) {
+                printf("ERROR: Unknown timing \"%s\"!\n", argv[i]);
+                return -4;
+            }
+            emulation.timing_set = true;
+        } else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (chip8_quirks_parse(argv[++i], &emulation.quirks) != 0) {
+                printf("ERROR: Unknown quirks \"%s\"!\n", argv[i]);
+                return -4;
+            }
+            emulation.quirks_set = true;
+        } else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc) {
+            emulation.run_ahead = (uint32_t) strtoul(argv[++i], NULL, 0);
+            if (emulation.run_ahead > MAX_RUN_AHEAD) {
+                printf("ERROR: --run-ahead can look at most %d frames ahead!\n", MAX_RUN_AHEAD);
+                return -4;
+            }
+        } else {
+            rom = argv[i];
+        }
+    }
+
+    // the chip8 itself, run on its own thread
+    uint64_t seed = (uint64_t) time(0);
+    emulation.chip8 = chip8_create();
+    chip8_seed(&emulation.chip8, seed);
+    emulation.chip8.quirks = emulation.quirks;
+    if (emulation.profile_file || emulation.stacks_file) {
+        emulation.chip8.profile = chip8_profile_create();
+        if (!emulation.chip8.profile) { return -4; }
+    }
+    emulation.clock = chip8_clock_create(emulation.timing, emulation.clock_rate);
+    if (database_file) {
+        emulation.database = chip8_rom_database_load(database_file);
+        if (!emulation.database) { return -4; }
+    }
+    if (video_file) {
+        emulation.video = chip8_video_writer_create(video_file, 0);
+        if (!emulation.video) { return -4; }
+    }
+    emulation.engine = chip8_engine_create(CHIP8_ENGINE_SWITCH);
+    emulation.ahead_engine = chip8_engine_create(CHIP8_ENGINE_SWITCH);
+
+    // every frame gets pushed here so it can be played back in reverse
+    emulation.rewind = chip8_rewind_create(REWIND_MEMORY, REWIND_KEYFRAME_INTERVAL);
+
+    emulation.frames = chip8_triple_buffer_create();
+    emulation.input = chip8_input_create(INPUT_QUEUE_CAPACITY);
+    emulation.wake_event = SDL_RegisterEvents(1);
+    if (!emulation.engine || !emulation.ahead_engine || !emulation.frames || !emulation.input || !emulation.wake_event) {
+        printf("ERROR: Failed to set up the emulation thread!\n");
+        return -4;
+    }
 
     // launch rom through command line argument
-    if (argc > 1) {
-        chip8_load_rom(&chip8, argv[1]);
+    if (rom) {
+        uint64_t rom_hash = load_rom(&emulation, rom);
         SDL_SetWindowTitle(window, "Chip 8 Emulator");
+
+        if (emulation.record_file && emulation.chip8.program_loaded) {
+            emulation.recording = chip8_recording_create(seed, rom_hash);
+            if (emulation.recording) {
+                emulation.recording->timing = emulation.clock.timing;
+                emulation.recording->instructions_per_second = emulation.clock.instructions_per_second;
+                emulation.recording->quirks = emulation.chip8.quirks;
+            }
+        }
+    }
+
+    SDL_AudioStream* audio_stream = open_audio(&emulation);
+
+    atomic_store(&emulation.running, true);
+    SDL_Thread* thread = SDL_CreateThread(emulation_thread, "chip8", &emulation);
+    if (!thread) {
+        printf("ERROR: Failed to create the emulation thread!\n");
+        return -4;
     }
 
     SDL_Event event;
     bool running = true;
     while (running) {
-        while (SDL_PollEvent(&event)) {
+        // sleep until there is input or a new frame
+        if (!SDL_WaitEvent(&event)) { continue; }
+
+        do {
             switch (event.type) {
                 // window events
                 case SDL_EVENT_QUIT: running = false; break;
+                case SDL_EVENT_WINDOW_EXPOSED:
+                case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED: redraw = true; break;
                 case SDL_EVENT_DROP_FILE:
-                    chip8_load_rom(&chip8, event.drop.data);
+                    SDL_free(atomic_exchange(&emulation.next_rom, SDL_strdup(event.drop.data)));
                     SDL_SetWindowTitle(window, "Chip 8 Emulator");
                     break;
 
                 // keyboard events
                 case SDL_EVENT_KEY_DOWN:
                 case SDL_EVENT_KEY_UP: {
-                    uint8_t down = (event.type == SDL_EVENT_KEY_DOWN) ? 1 : 0;
+                    bool down = (event.type == SDL_EVENT_KEY_DOWN);
                     for (int i = 0; i < 16; i++) {
-                        if (event.key.scancode == keyboard_scancodes[i]) { chip8.keypad[i] = down; }
+                        if (event.key.scancode != keyboard_scancodes[i] || event.key.repeat) { continue; }
+
+                        // stamped with when sdl got the key, not when this loop got around to it
+                        chip8_input_push(emulation.input, event.key.timestamp, (uint8_t) i, down);
                     }
+                    if (event.key.scancode == SDL_SCANCODE_BACKSPACE) { atomic_store(&emulation.rewinding, down); }
+                    if (event.key.scancode == SDL_SCANCODE_TAB) { atomic_store(&emulation.turbo, down); }
                 } break;
-            }
-        }
 
-        uint64_t current_time = SDL_GetPerformanceCounter();
-        double delta_time = (double) (current_time - last_time) / (double) SDL_GetPerformanceFrequency();
-        if (delta_time < 1.0 / 60.0) { continue; }
-        last_time = current_time;
+                default:
+                    // cleared before taking the frame, so a frame published after this wakes us again
+                    if (event.type == emulation.wake_event) { atomic_store(&emulation.wake_pending, false); }
+                    break;
+            }
+        } while (SDL_PollEvent(&event));
 
-        // run the instructions
-        for (int i = 0; i < INSTRUCTIONS_PER_CYCLE; i++) {
-            chip8_update(&chip8);
+        const Chip8Frame* frame = chip8_triple_buffer_read(emulation.frames);
+        if (frame && frame->display.hires != shown.display.hires) {
+            SDL_DestroyTexture(chip8_display_texture);
+            chip8_display_texture = create_display_texture(renderer, &frame->display);
+            shown.display = frame->display;
+            shown.display_dirty = UINT64_MAX;
+        } else if (frame) {
+            for (int plane = 0; plane < CHIP8_DISPLAY_PLANES; plane++) {
+                for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+                    const uint64_t* row = frame->display.planes[plane][y];
+                    const uint64_t* shown_row = shown.display.planes[plane][y];
+                    shown.display_dirty |= (uint64_t) (((row[0] ^ shown_row[0]) | (row[1] ^ shown_row[1])) != 0) << y;
+                }
+            }
+            shown.display = frame->display;
         }
 
-        // update the timers
-        chip8_update_timers(&chip8);
+        // upload only the rows that changed, and skip rendering when nothing did
+        int first_row, row_count;
+        if (chip8_display_take_dirty(&shown, &first_row, &row_count)) {
+            int width = chip8_display_width(&shown.display);
+            chip8_display_unpack_rows(&shown, first_row, row_count, pixels);
 
-        // update the display texture
-        SDL_UpdateTexture(chip8_display_texture, NULL, chip8.display, 64 * sizeof(uint8_t));
+            uint8_t* first_pixel = &pixels[first_row * width];
+            SDL_Rect rows = {0, first_row, width, row_count};
+            SDL_UpdateTexture(chip8_display_texture, &rows, first_pixel, width * sizeof(uint8_t));
+
+            redraw = true;
+        }
+        if (!redraw) { continue; }
+        redraw = false;
 
         // render
         SDL_RenderClear(renderer);
@@ -103,7 +550,28 @@ int main(int argc, char* argv[]) {
         SDL_RenderPresent(renderer);
     }
 
+    atomic_store(&emulation.running, false);
+    SDL_WaitThread(thread, NULL);
+    if (audio_stream) { SDL_DestroyAudioStream(audio_stream); }
+    chip8_audio_ring_destroy(emulation.audio);
+
+    finish_recording(&emulation.recording, emulation.record_file, emulation.instructions_run);
+    chip8_video_writer_finish(emulation.video);
+    if (emulation.chip8.profile) {
+        if (emulation.profile_file) { chip8_profile_save_json(emulation.chip8.profile, &emulation.chip8, emulation.profile_file); }
+        if (emulation.stacks_file) { chip8_profile_save_stacks(emulation.chip8.profile, emulation.stacks_file); }
+        chip8_profile_destroy(emulation.chip8.profile);
+    }
+    chip8_rewind_destroy(emulation.rewind);
+    chip8_triple_buffer_destroy(emulation.frames);
+    chip8_input_destroy(emulation.input);
+    chip8_engine_destroy(emulation.engine);
+    chip8_engine_destroy(emulation.ahead_engine);
+    chip8_rom_database_destroy(emulation.database);
+    SDL_free(atomic_load(&emulation.next_rom));
+
     SDL_DestroyWindow(window);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
     SDL_QuitSubSystem(SDL_INIT_VIDEO);
     SDL_Quit();
 
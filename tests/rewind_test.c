@@ -0,0 +1,107 @@
+/*
+ * pushes states of very different encoded sizes through small rewind buffers and checks that every frame
+ * still held restores to exactly the state that was pushed for it
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "chip8_rewind.h"
+#include "chip8_snapshot.h"
+
+#define PUSHES 3000
+
+// the smallest buffer chip8_rewind_create takes, so the ring wraps every few frames
+#define MIN_MEMORY (4 * CHIP8_SNAPSHOT_SIZE * 3)
+
+static uint8_t pushed[PUSHES][CHIP8_SNAPSHOT_SIZE];
+
+// state `n` is nearly empty or full of noise, so frame sizes jump between a few bytes and a few KB
+static void make_state(Chip8* chip8, uint32_t n, uint32_t* random_state) {
+    *chip8 = chip8_create();
+    chip8->program_counter = (uint16_t) (0x200 + n * 2);
+
+    uint32_t noisy = (n % 3 == 0) ? sizeof(chip8->memory) : (n % 7) * 64;
+    for (uint32_t i = 0; i < noisy; i++) {
+        *random_state ^= *random_state << 13;
+        *random_state ^= *random_state >> 17;
+        *random_state ^= *random_state << 5;
+        chip8->memory[i] = (uint8_t) *random_state;
+    }
+}
+
+static int check_held(Chip8Rewind* rewind, uint32_t newest) {
+    uint32_t held = chip8_rewind_size(rewind);
+    if (held == 0 || held > newest + 1) {
+        printf("ERROR: %u frames held after %u pushes!\n", held, newest + 1);
+        return -1;
+    }
+
+    for (uint32_t back = 0; back < held; back++) {
+        Chip8 chip8 = chip8_create();
+        uint8_t snapshot[CHIP8_SNAPSHOT_SIZE];
+
+        if (chip8_rewind_restore(rewind, back, &chip8) != 0) {
+            printf("ERROR: Frame %u back could not be restored after %u pushes!\n", back, newest + 1);
+            return -1;
+        }
+
+        chip8_snapshot(&chip8, snapshot);
+        if (memcmp(snapshot, pushed[newest - back], sizeof(snapshot)) != 0) {
+            printf("ERROR: Frame %u back does not match what was pushed after %u pushes!\n", back, newest + 1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int run(size_t memory_size, uint32_t keyframe_interval, uint32_t rewind_every) {
+    Chip8Rewind* rewind = chip8_rewind_create(memory_size, keyframe_interval);
+    if (!rewind) { return -1; }
+
+    uint32_t random_state = 0x12345678u;
+    uint32_t length = 0; // frames on the timeline, pushed[length - 1] is the newest
+    int result = 0;
+
+    for (uint32_t n = 0; n < PUSHES && result == 0; n++) {
+        Chip8 chip8;
+        make_state(&chip8, n, &random_state);
+        chip8_rewind_push(rewind, &chip8);
+        chip8_snapshot(&chip8, pushed[length++]);
+
+        // stepping back rewrites the ring from the middle, the next push continues from the restored frame
+        if (rewind_every && n % rewind_every == rewind_every - 1 && chip8_rewind_size(rewind) > 3) {
+            chip8_rewind_drop(rewind, 2);
+            length -= 2;
+        }
+
+        result = check_held(rewind, length - 1);
+    }
+
+    chip8_rewind_destroy(rewind);
+    return result;
+}
+
+int main() {
+    struct { size_t memory_size; uint32_t keyframe_interval; uint32_t rewind_every; } cases[] = {
+        {MIN_MEMORY, 1, 0},
+        {MIN_MEMORY, 4, 0},
+        {MIN_MEMORY * 3, 60, 0},
+        {MIN_MEMORY, 1, 11},
+        {MIN_MEMORY * 2, 5, 13},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (run(cases[i].memory_size, cases[i].keyframe_interval, cases[i].rewind_every) != 0) {
+            printf("ERROR: Rewind case %zu failed!\n", i);
+            return -1;
+        }
+    }
+
+    printf("rewind: all cases passed\n");
+    return 0;
+}
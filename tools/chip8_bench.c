@@ -0,0 +1,351 @@
+/*
+ * chip8-bench: runs generated roms that each hammer one part of the interpreter and reports how fast every engine runs them
+ *
+ * usage: chip8-bench [--instructions N] [--repeat N] [--engine NAME] [--bench NAME] [--json FILE]
+ *                    [--baseline FILE [--tolerance PERCENT]]
+ *
+ * the roms are built in memory, so the numbers do not depend on what roms are lying around:
+ *   alu     the 8xyN group and 7xkk in a tight loop
+ *   draw    15 row sprites drawn all over the screen with Dxyn
+ *   memory  Fx55, Fx65 and Fx33 moving registers in and out of memory
+ *   calls   2nnn recursing 15 deep and unwinding with 00EE
+ *
+ * every rom is run for --instructions instructions (20 million by default) --repeat times (5 by default)
+ * after an untimed warm up, on every engine unless --engine picks one, with idle skipping turned off
+ *
+ * --json writes the results, one per line, and --baseline compares them against a file written
+ * earlier, failing when a benchmark got more than --tolerance percent (10 by default) slower
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "chip8_engine.h"
+
+#define DEFAULT_INSTRUCTIONS 20000000
+#define DEFAULT_REPEAT 5
+#define DEFAULT_TOLERANCE 10.0
+
+// the warm up run gets this fraction of the instructions, enough for the caches and the jit to fill
+#define WARM_UP_DIVISOR 10
+
+#define MAX_ENGINES 3
+#define MAX_BENCHMARKS 4
+
+typedef struct Benchmark {
+    const char* name;
+    const uint16_t* program; // big endian words, sprite data included
+    size_t words;
+} Benchmark;
+
+static const uint16_t alu_program[] = {
+    0x6001, // 200: LD V0, 01
+    0x6107, // 202: LD V1, 07
+    0x6233, // 204: LD V2, 33
+    0x6355, // 206: LD V3, 55
+    0x8014, // 208: ADD V0, V1
+    0x8125, // 20A: SUB V1, V2
+    0x8231, // 20C: OR V2, V3
+    0x8302, // 20E: AND V3, V0
+    0x8413, // 210: XOR V4, V1
+    0x8506, // 212: SHR V5
+    0x860E, // 214: SHL V6
+    0x8707, // 216: SUBN V7, V0
+    0x8840, // 218: LD V8, V4
+    0x7901, // 21A: ADD V9, 01
+    0x1208, // 21C: JP 208
+};
+
+static const uint16_t draw_program[] = {
+    0x6000, // 200: LD V0, 00
+    0x6100, // 202: LD V1, 00
+    0xA20E, // 204: LD I, 20E
+    0xD01F, // 206: DRW V0, V1, F
+    0x7007, // 208: ADD V0, 07
+    0x7103, // 20A: ADD V1, 03
+    0x1206, // 20C: JP 206
+    0xFF81, 0xBDA5, 0xA5BD, 0x81FF, 0x183C, 0x7EFF, 0x7E3C, 0x1800, // 20E: the sprite
+};
+
+static const uint16_t memory_program[] = {
+    0x6080, // 200: LD V0, 80
+    0xA300, // 202: LD I, 300
+    0xF955, // 204: LD [I], V9
+    0xF965, // 206: LD V9, [I]
+    0xA310, // 208: LD I, 310
+    0xF033, // 20A: LD B, V0
+    0x7001, // 20C: ADD V0, 01
+    0x1202, // 20E: JP 202
+};
+
+static const uint16_t calls_program[] = {
+    0x6000, // 200: LD V0, 00
+    0x2206, // 202: CALL 206
+    0x1200, // 204: JP 200
+    0x7001, // 206: ADD V0, 01
+    0x300F, // 208: SE V0, 0F
+    0x2206, // 20A: CALL 206
+    0x00EE, // 20C: RET
+};
+
+static const Benchmark benchmarks[MAX_BENCHMARKS] = {
+    {"alu", alu_program, sizeof(alu_program) / sizeof(alu_program[0])},
+    {"draw", draw_program, sizeof(draw_program) / sizeof(draw_program[0])},
+    {"memory", memory_program, sizeof(memory_program) / sizeof(memory_program[0])},
+    {"calls", calls_program, sizeof(calls_program) / sizeof(calls_program[0])},
+};
+
+typedef struct Result {
+    const char* benchmark;
+    Chip8EngineType engine;
+    double mips;         // mean over the repeats
+    double stddev_mips;
+    double min_mips;
+    double max_mips;
+    double ns_per_instruction;
+    uint64_t state_hash; // the display, registers and program counter at the end, the same for every engine
+} Result;
+
+static double get_time_seconds() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+// extends the display hash with the registers, so benchmarks that never draw are checked too
+static uint64_t state_hash(const Chip8* chip8) {
+    uint64_t hash = chip8_display_hash(chip8);
+
+    uint8_t state[21];
+    memcpy(state, chip8->registers, sizeof(chip8->registers));
+    state[16] = chip8->address_register >> 8;
+    state[17] = chip8->address_register & 0xFF;
+    state[18] = chip8->program_counter >> 8;
+    state[19] = chip8->program_counter & 0xFF;
+    state[20] = chip8->stack_pointer;
+
+    for (size_t i = 0; i < sizeof(state); i++) {
+        hash ^= state[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+static void print_usage() {
+    printf("usage: chip8-bench [--instructions N] [--repeat N] [--engine NAME] [--bench NAME] [--json FILE]\n");
+    printf("                   [--baseline FILE [--tolerance PERCENT]]\n");
+}
+
+static void load(Chip8* chip8, const Benchmark* benchmark) {
+    uint8_t program[64];
+    for (size_t i = 0; i < benchmark->words; i++) {
+        program[i * 2] = benchmark->program[i] >> 8;
+        program[i * 2 + 1] = benchmark->program[i] & 0xFF;
+    }
+
+    *chip8 = chip8_create();
+    chip8_load_program(chip8, program, benchmark->words * 2);
+}
+
+static int run_benchmark(const Benchmark* benchmark, Chip8EngineType type, uint64_t instructions, uint32_t repeat, Result* result) {
+    Chip8Engine* engine = chip8_engine_create(type);
+    if (!engine) { return -1; }
+    engine->skip_idle = 0;
+
+    Chip8 chip8;
+    load(&chip8, benchmark);
+    chip8_engine_reset(engine);
+    chip8_engine_run(engine, &chip8, instructions / WARM_UP_DIVISOR);
+
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    double total_seconds = 0.0;
+    result->min_mips = INFINITY;
+    result->max_mips = 0.0;
+
+    for (uint32_t i = 0; i < repeat; i++) {
+        // every run starts over so they all do the same work, the engine keeps what it compiled
+        load(&chip8, benchmark);
+
+        double start_time = get_time_seconds();
+        chip8_engine_run(engine, &chip8, instructions);
+        double elapsed = get_time_seconds() - start_time;
+
+        double mips = (elapsed > 0.0) ? (double) instructions / elapsed / 1e6 : 0.0;
+        sum += mips;
+        sum_squares += mips * mips;
+        total_seconds += elapsed;
+        if (mips < result->min_mips) { result->min_mips = mips; }
+        if (mips > result->max_mips) { result->max_mips = mips; }
+    }
+
+    double mean = sum / repeat;
+    double variance = sum_squares / repeat - mean * mean;
+
+    result->benchmark = benchmark->name;
+    result->engine = type;
+    result->mips = mean;
+    result->stddev_mips = (variance > 0.0) ? sqrt(variance) : 0.0;
+    result->ns_per_instruction = total_seconds * 1e9 / ((double) instructions * repeat);
+    result->state_hash = state_hash(&chip8);
+
+    chip8_engine_destroy(engine);
+
+    return 0;
+}
+
+static int save_json(const Result* results, int count, uint64_t instructions, uint32_t repeat, const char* file) {
+    FILE* json_file = fopen(file, "w");
+    if (!json_file) {
+        printf("ERROR: Failed to open json file!\n");
+        return -1;
+    }
+
+    fprintf(json_file, "{\n  \"instructions\": %llu,\n  \"repeat\": %u,\n  \"results\": [\n", (unsigned long long) instructions, repeat);
+    for (int i = 0; i < count; i++) {
+        const Result* result = &results[i];
+        fprintf(json_file, "    {\"benchmark\": \"%s\", \"engine\": \"%s\", \"mips\": %.3f, \"stddev_mips\": %.3f, \"min_mips\": %.3f, "
+                           "\"max_mips\": %.3f, \"ns_per_instruction\": %.4f, \"state_hash\": \"%016llx\"}%s\n",
+                result->benchmark, chip8_engine_name(result->engine), result->mips, result->stddev_mips, result->min_mips,
+                result->max_mips, result->ns_per_instruction, (unsigned long long) result->state_hash, (i + 1 < count) ? "," : "");
+    }
+    fprintf(json_file, "  ]\n}\n");
+
+    int result = ferror(json_file) ? -1 : 0;
+    fclose(json_file);
+
+    return result;
+}
+
+// reads the result lines of a file written by save_json, returns the number of regressions or -1
+static int compare_baseline(const Result* results, int count, const char* file, double tolerance) {
+    FILE* baseline_file = fopen(file, "r");
+    if (!baseline_file) {
+        printf("ERROR: Failed to open baseline file!\n");
+        return -1;
+    }
+
+    int regressions = 0;
+
+    char line[512];
+    while (fgets(line, sizeof(line), baseline_file)) {
+        char benchmark[32];
+        char engine[32];
+        double mips;
+        if (sscanf(line, " {\"benchmark\": \"%31[^\"]\", \"engine\": \"%31[^\"]\", \"mips\": %lf", benchmark, engine, &mips) != 3) { continue; }
+
+        for (int i = 0; i < count; i++) {
+            const Result* result = &results[i];
+            if (strcmp(result->benchmark, benchmark) != 0 || strcmp(chip8_engine_name(result->engine), engine) != 0) { continue; }
+
+            double change = (mips > 0.0) ? (result->mips / mips - 1.0) * 100.0 : 0.0;
+            int regressed = change < -tolerance;
+            regressions += regressed;
+
+            printf("%-8s %-8s %10.2f -> %10.2f MIPS %+7.1f%%%s\n", benchmark, engine, mips, result->mips, change, regressed ? "  REGRESSION" : "");
+        }
+    }
+
+    fclose(baseline_file);
+
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t instructions = DEFAULT_INSTRUCTIONS;
+    uint32_t repeat = DEFAULT_REPEAT;
+    double tolerance = DEFAULT_TOLERANCE;
+    const char* only_benchmark = NULL;
+    const char* json_file = NULL;
+    const char* baseline_file = NULL;
+
+    Chip8EngineType engines[MAX_ENGINES] = {CHIP8_ENGINE_SWITCH, CHIP8_ENGINE_CACHED, CHIP8_ENGINE_JIT};
+    int engine_count = MAX_ENGINES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+            instructions = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            if (chip8_engine_parse(argv[++i], &engines[0]) != 0) {
+                printf("ERROR: Unknown engine \"%s\"!\n", argv[i]);
+                return -1;
+            }
+            engine_count = 1;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            only_benchmark = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_file = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = strtod(argv[++i], NULL);
+        } else {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if (!instructions || !repeat) {
+        print_usage();
+        return -1;
+    }
+
+    Result results[MAX_BENCHMARKS * MAX_ENGINES];
+    int count = 0;
+
+    printf("%-8s %-8s %10s %10s %8s %10s %10s  %s\n", "bench", "engine", "MIPS", "ns/instr", "stddev", "min", "max", "state hash");
+
+    for (int i = 0; i < MAX_BENCHMARKS; i++) {
+        const Benchmark* benchmark = &benchmarks[i];
+        if (only_benchmark && strcmp(only_benchmark, benchmark->name) != 0) { continue; }
+
+        for (int j = 0; j < engine_count; j++) {
+            Result* result = &results[count];
+
+            // the jit is not available everywhere, only an engine asked for by name has to run
+            if (run_benchmark(benchmark, engines[j], instructions, repeat, result) != 0) {
+                if (engine_count == 1) { return -3; }
+                continue;
+            }
+
+            printf("%-8s %-8s %10.2f %10.3f %8.2f %10.2f %10.2f  %016llx\n", benchmark->name, chip8_engine_name(engines[j]),
+                   result->mips, result->ns_per_instruction, result->stddev_mips, result->min_mips, result->max_mips,
+                   (unsigned long long) result->state_hash);
+
+            // every engine has to end up in the same state, a fast wrong engine is no good
+            if (count > 0 && results[count - 1].benchmark == result->benchmark && results[count - 1].state_hash != result->state_hash) {
+                printf("ERROR: The %s engine does not match the others on %s!\n", chip8_engine_name(engines[j]), benchmark->name);
+                return -5;
+            }
+
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        printf("ERROR: Unknown benchmark \"%s\"!\n", only_benchmark);
+        return -1;
+    }
+
+    if (json_file && save_json(results, count, instructions, repeat, json_file) != 0) { return -4; }
+
+    if (baseline_file) {
+        int regressions = compare_baseline(results, count, baseline_file, tolerance);
+        if (regressions < 0) { return -2; }
+        if (regressions > 0) {
+            printf("ERROR: %d benchmarks are more than %.1f%% slower than the baseline!\n", regressions, tolerance);
+            return -6;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,465 @@
+/*
+ * chip8-conformance: runs a corpus of test roms headlessly on every core and checks what they leave on the display
+ *
+ * usage: chip8-conformance <manifest> [--engine NAME] [--threads N] [--diff DIR] [--update]
+ *
+ * the manifest is a text file with one run per line, rom paths are relative to the manifest:
+ *
+ *     # display hash    frames  rom             settings
+ *     fe0c3b8ca3c28438  600     ibm_logo.ch8    clock=700 timing=cosmac quirks=cosmac seed=1
+ *
+ * every rom is loaded with chip8_load_rom, run for that many frames and its chip8_display_hash compared
+ * against the golden one, settings left out are the defaults chip8-run uses, so a run shows the same
+ * display as chip8-run with the same --frames, --clock, --timing, --quirks and --seed
+ *
+ * the golden displays are kept next to the manifest as one frame videos named golden/<hash>.c8v (see
+ * chip8_video.h), for a run that does not match a diff image is written to --diff (the current directory by
+ * default), pixels the same in both are black or white, ones only the golden display has lit are red and
+ * ones only the run has lit, or lit in another color, are green
+ *
+ * --update runs everything, writes the hashes it got back into the manifest and saves their golden displays,
+ * golden displays no run uses any more are not deleted
+ *
+ * --engine picks the engine every run uses (switch by default, see chip8_engine.h), --threads defaults to
+ * one per core
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "chip8.h"
+#include "chip8_engine.h"
+#include "chip8_clock.h"
+#include "chip8_video.h"
+#include "chip8_image.h"
+
+#define MAX_LINE_SIZE 4096
+#define MAX_PATH_SIZE 4096
+
+// how many image pixels a high resolution pixel takes in a diff, low resolution ones take twice that
+#define DIFF_SCALE 4
+
+typedef struct ConformanceRun {
+    uint32_t line; // counted from 1
+    char rom[MAX_PATH_SIZE];
+
+    uint64_t frames;
+    uint64_t seed;
+    uint32_t instructions_per_second;
+    Chip8Timing timing;
+    Chip8Quirks quirks;
+
+    uint64_t expected_hash;
+
+    // filled in by the workers
+    int loaded;
+    uint64_t hash;
+    Chip8Display display;
+} ConformanceRun;
+
+typedef struct Conformance {
+    ConformanceRun* runs;
+    uint32_t run_count;
+
+    // the manifest as it was read, for --update
+    char** lines;
+    uint32_t line_count;
+
+    Chip8EngineType engine_type;
+    atomic_uint next_run;
+} Conformance;
+
+static double get_time_seconds() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+static void print_usage() {
+    printf("usage: chip8-conformance <manifest> [--engine NAME] [--threads N] [--diff DIR] [--update]\n");
+}
+
+// the next whitespace separated word, NULL at the end of the line
+static char* next_word(char** text) {
+    char* word = *text + strspn(*text, " \t");
+    if (*word == '\0') { return NULL; }
+
+    char* end = word + strcspn(word, " \t");
+    *text = end + (*end != '\0');
+    *end = '\0';
+
+    return word;
+}
+
+static int parse_setting(char* setting, ConformanceRun* run) {
+    char* value = strchr(setting, '=');
+    if (!value) { return -1; }
+    *value++ = '\0';
+
+    if (strcmp(setting, "quirks") == 0) {
+        return chip8_quirks_parse(value, &run->quirks);
+    } else if (strcmp(setting, "timing") == 0) {
+        return chip8_timing_parse(value, &run->timing);
+    } else if (strcmp(setting, "clock") == 0) {
+        run->instructions_per_second = (uint32_t) strtoul(value, NULL, 0);
+    } else if (strcmp(setting, "seed") == 0) {
+        run->seed = strtoull(value, NULL, 0);
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+// `directory` ends in a slash or is empty
+static int parse_run(const char* line, const char* directory, int update, ConformanceRun* run) {
+    char text[MAX_LINE_SIZE];
+    snprintf(text, sizeof(text), "%s", line);
+    char* rest = text;
+
+    char* hash = next_word(&rest);
+    char* frames = next_word(&rest);
+    char* rom = next_word(&rest);
+    if (!hash || !frames || !rom) { return -1; }
+
+    // new runs get their hash from --update, so anything goes there
+    char* end;
+    run->expected_hash = strtoull(hash, &end, 16);
+    if (*end != '\0' && !update) { return -1; }
+
+    run->frames = strtoull(frames, &end, 0);
+    if (*end != '\0' || run->frames == 0) { return -1; }
+
+    int length = (rom[0] == '/') ? snprintf(run->rom, sizeof(run->rom), "%s", rom)
+                                 : snprintf(run->rom, sizeof(run->rom), "%s%s", directory, rom);
+    if (length >= (int) sizeof(run->rom)) { return -1; }
+
+    char* setting;
+    while ((setting = next_word(&rest))) {
+        if (parse_setting(setting, run) != 0) { return -1; }
+    }
+
+    return 0;
+}
+
+static int load_manifest(Conformance* conformance, const char* file, int update) {
+    FILE* manifest = fopen(file, "r");
+    if (!manifest) {
+        printf("ERROR: Failed to open manifest!\n");
+        return -1;
+    }
+
+    char directory[MAX_PATH_SIZE] = "";
+    const char* slash = strrchr(file, '/');
+    if (slash) { snprintf(directory, sizeof(directory), "%.*s", (int) (slash - file + 1), file); }
+
+    uint32_t capacity = 0;
+    char line[MAX_LINE_SIZE];
+    while (fgets(line, sizeof(line), manifest)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (conformance->line_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char** lines = realloc(conformance->lines, capacity * sizeof(char*));
+            ConformanceRun* runs = realloc(conformance->runs, capacity * sizeof(ConformanceRun));
+            if (lines) { conformance->lines = lines; }
+            if (runs) { conformance->runs = runs; }
+            if (!lines || !runs) {
+                printf("ERROR: Failed to allocate manifest!\n");
+                fclose(manifest);
+                return -1;
+            }
+        }
+
+        char* copy = strdup(line);
+        if (!copy) {
+            printf("ERROR: Failed to allocate manifest!\n");
+            fclose(manifest);
+            return -1;
+        }
+        conformance->lines[conformance->line_count++] = copy;
+
+        const char* start = line + strspn(line, " \t");
+        if (*start == '\0' || *start == '#') { continue; }
+
+        ConformanceRun* run = &conformance->runs[conformance->run_count];
+        memset(run, 0, sizeof(ConformanceRun));
+        run->line = conformance->line_count;
+        run->timing = CHIP8_TIMING_FIXED;
+        run->quirks = CHIP8_QUIRKS_DEFAULT;
+
+        if (parse_run(line, directory, update, run) != 0) {
+            printf("ERROR: Invalid run on manifest line %u!\n", run->line);
+            fclose(manifest);
+            return -1;
+        }
+        conformance->run_count++;
+    }
+
+    fclose(manifest);
+    return 0;
+}
+
+static void run_rom(ConformanceRun* run, Chip8Engine* engine) {
+    Chip8 chip8 = chip8_create();
+    chip8_seed(&chip8, run->seed);
+    chip8.quirks = run->quirks;
+
+    if (chip8_load_rom(&chip8, run->rom) != 0) { return; }
+    run->loaded = 1;
+
+    chip8_engine_reset(engine);
+    Chip8Clock clock = chip8_clock_create(run->timing, run->instructions_per_second);
+    for (uint64_t frame = 0; frame < run->frames; frame++) {
+        chip8_clock_run_frame(&clock, engine, &chip8);
+    }
+
+    run->hash = chip8_display_hash(&chip8);
+    run->display = chip8.display;
+}
+
+// every worker takes the next run nobody has started yet, the runs are independent so that is all the balancing needed
+static void* run_worker(void* argument) {
+    Conformance* conformance = argument;
+
+    Chip8Engine* engine = chip8_engine_create(conformance->engine_type);
+    if (!engine) { return NULL; }
+
+    uint32_t index;
+    while ((index = atomic_fetch_add(&conformance->next_run, 1)) < conformance->run_count) {
+        run_rom(&conformance->runs[index], engine);
+    }
+
+    chip8_engine_destroy(engine);
+    return NULL;
+}
+
+static void golden_path(char* path, size_t size, const char* manifest, uint64_t hash) {
+    const char* slash = strrchr(manifest, '/');
+    snprintf(path, size, "%.*sgolden/%016llx.c8v", slash ? (int) (slash - manifest + 1) : 0, manifest, (unsigned long long) hash);
+}
+
+static int load_golden(const char* path, Chip8Display* display) {
+    // a missing golden display is not an error, the diff then only shows the run
+    FILE* file = fopen(path, "rb");
+    if (!file) { return -1; }
+    fclose(file);
+
+    Chip8VideoReader* reader = chip8_video_reader_open(path);
+    if (!reader) { return -1; }
+
+    uint64_t frame;
+    int result = chip8_video_reader_next(reader, display, &frame);
+    chip8_video_reader_close(reader);
+
+    return (result == 1) ? 0 : -1;
+}
+
+static int save_golden(const char* path, const Chip8Display* display) {
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        fclose(file);
+        return 0;
+    }
+
+    Chip8VideoWriter* writer = chip8_video_writer_create(path, 1);
+    if (!writer) { return -1; }
+
+    chip8_video_writer_add(writer, display, 0);
+    return chip8_video_writer_finish(writer);
+}
+
+static int write_diff(const ConformanceRun* run, const Chip8Display* golden, const char* directory) {
+    Chip8Display blank;
+    memset(&blank, 0, sizeof(blank));
+    if (!golden) { golden = &blank; }
+
+    uint32_t width = (golden->hires || run->display.hires) ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH;
+    uint32_t height = (golden->hires || run->display.hires) ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+    uint32_t scale = (width == CHIP8_HIRES_WIDTH) ? DIFF_SCALE : DIFF_SCALE * 2;
+
+    Image expected = {width * scale, height * scale, malloc((size_t) width * height * scale * scale)};
+    Image actual = {width * scale, height * scale, malloc((size_t) width * height * scale * scale)};
+    if (!expected.pixels || !actual.pixels) {
+        printf("ERROR: Failed to allocate diff image!\n");
+        free(expected.pixels);
+        free(actual.pixels);
+        return -1;
+    }
+
+    image_draw_display(golden, &expected);
+    image_draw_display(&run->display, &actual);
+
+    // black and white where they agree, red for pixels the run is missing and green for ones it should not have
+    for (uint32_t i = 0; i < actual.width * actual.height; i++) {
+        uint8_t pixel = actual.pixels[i];
+        actual.pixels[i] = (pixel == expected.pixels[i]) ? (pixel != 0) : (pixel == 0) ? 2 : 3;
+    }
+
+    static const uint8_t palette[12] = {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x40, 0x40, 0x40, 0xFF, 0x40};
+
+    const char* rom_name = strrchr(run->rom, '/');
+    rom_name = rom_name ? rom_name + 1 : run->rom;
+
+    char file_name[MAX_PATH_SIZE * 2];
+    snprintf(file_name, sizeof(file_name), "%s/%u_%s.png", directory, run->line, rom_name);
+    int result = image_write_png(&actual, palette, file_name);
+    if (result == 0) { printf("      diff: %s\n", file_name); }
+
+    free(expected.pixels);
+    free(actual.pixels);
+    return result;
+}
+
+static int update_manifest(const Conformance* conformance, const char* file) {
+    char golden_directory[MAX_PATH_SIZE];
+    const char* slash = strrchr(file, '/');
+    snprintf(golden_directory, sizeof(golden_directory), "%.*sgolden", slash ? (int) (slash - file + 1) : 0, file);
+    mkdir(golden_directory, 0755);
+
+    for (uint32_t i = 0; i < conformance->run_count; i++) {
+        const ConformanceRun* run = &conformance->runs[i];
+
+        char path[MAX_PATH_SIZE];
+        golden_path(path, sizeof(path), file, run->hash);
+        if (save_golden(path, &run->display) != 0) { return -1; }
+    }
+
+    FILE* manifest = fopen(file, "w");
+    if (!manifest) {
+        printf("ERROR: Failed to open manifest!\n");
+        return -1;
+    }
+
+    // only the hashes change, the rest of every line is kept as it was
+    uint32_t run_index = 0;
+    for (uint32_t i = 0; i < conformance->line_count; i++) {
+        const char* line = conformance->lines[i];
+
+        if (run_index < conformance->run_count && conformance->runs[run_index].line == i + 1) {
+            const char* start = line + strspn(line, " \t");
+            const char* rest = start + strcspn(start, " \t");
+            fprintf(manifest, "%016llx%s\n", (unsigned long long) conformance->runs[run_index++].hash, rest);
+        } else {
+            fprintf(manifest, "%s\n", line);
+        }
+    }
+
+    if (fclose(manifest) != 0) {
+        printf("ERROR: Failed to write manifest!\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* manifest_file = NULL;
+    const char* diff_directory = ".";
+    Chip8EngineType engine_type = CHIP8_ENGINE_SWITCH;
+    uint32_t thread_count = 0;
+    int update = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            if (chip8_engine_parse(argv[++i], &engine_type) != 0) {
+                printf("ERROR: Unknown engine \"%s\"!\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            diff_directory = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0) {
+            update = 1;
+        } else if (argv[i][0] != '-' && !manifest_file) {
+            manifest_file = argv[i];
+        } else {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if (!manifest_file) {
+        print_usage();
+        return -1;
+    }
+
+    Conformance conformance = {0};
+    conformance.engine_type = engine_type;
+    if (load_manifest(&conformance, manifest_file, update) != 0) { return -2; }
+
+    if (thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cores > 0) ? (uint32_t) cores : 1;
+    }
+    if (thread_count > conformance.run_count) { thread_count = conformance.run_count ? conformance.run_count : 1; }
+
+    pthread_t* threads = malloc(thread_count * sizeof(pthread_t));
+    if (!threads) {
+        printf("ERROR: Failed to allocate threads!\n");
+        return -3;
+    }
+
+    double start_time = get_time_seconds();
+
+    uint32_t started = 0;
+    for (; started < thread_count; started++) {
+        if (pthread_create(&threads[started], NULL, run_worker, &conformance) != 0) { break; }
+    }
+    if (started == 0) {
+        printf("ERROR: Failed to start threads!\n");
+        return -3;
+    }
+    for (uint32_t i = 0; i < started; i++) { pthread_join(threads[i], NULL); }
+
+    double elapsed = get_time_seconds() - start_time;
+    free(threads);
+
+    uint32_t failed = 0;
+    uint32_t unreadable = 0;
+    for (uint32_t i = 0; i < conformance.run_count; i++) {
+        ConformanceRun* run = &conformance.runs[i];
+
+        if (!run->loaded) {
+            printf("FAIL  line %u: %s could not be loaded\n", run->line, run->rom);
+            unreadable++;
+            continue;
+        }
+
+        if (update || run->hash == run->expected_hash) {
+            printf("ok    line %u: %s %016llx\n", run->line, run->rom, (unsigned long long) run->hash);
+            continue;
+        }
+
+        printf("FAIL  line %u: %s expected %016llx, got %016llx\n", run->line, run->rom,
+               (unsigned long long) run->expected_hash, (unsigned long long) run->hash);
+        failed++;
+
+        char path[MAX_PATH_SIZE];
+        golden_path(path, sizeof(path), manifest_file, run->expected_hash);
+
+        Chip8Display golden;
+        write_diff(run, (load_golden(path, &golden) == 0) ? &golden : NULL, diff_directory);
+    }
+
+    printf("engine: %s\n", chip8_engine_name(engine_type));
+    printf("threads: %u\n", started);
+    printf("runs: %u\n", conformance.run_count);
+    printf("failed: %u\n", failed + unreadable);
+    printf("seconds: %.6f\n", elapsed);
+
+    if (unreadable) { return -2; }
+
+    if (update && update_manifest(&conformance, manifest_file) != 0) { return -4; }
+
+    return failed ? -5 : 0;
+}
@@ -0,0 +1,137 @@
+#include "chip8_image.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void image_draw_display(const Chip8Display* display, Image* image) {
+    uint32_t scale_x = image->width / (uint32_t) chip8_display_width(display);
+    uint32_t scale_y = image->height / (uint32_t) chip8_display_height(display);
+
+    for (uint32_t y = 0; y < image->height; y++) {
+        const uint64_t* first = display->planes[0][y / scale_y];
+        const uint64_t* second = display->planes[1][y / scale_y];
+
+        for (uint32_t x = 0; x < image->width; x++) {
+            uint32_t pixel = x / scale_x;
+            uint32_t shift = 63 - pixel % 64;
+            image->pixels[y * image->width + x] = (uint8_t) (((first[pixel / 64] >> shift) & 1) | (((second[pixel / 64] >> shift) & 1) << 1));
+        }
+    }
+}
+
+void image_display_palette(uint8_t* rgb) {
+    static const uint8_t palette[4] = CHIP8_DISPLAY_PALETTE;
+
+    for (int i = 0; i < 4; i++) {
+        rgb[i * 3] = (uint8_t) ((palette[i] >> 5) * 255 / 7);
+        rgb[i * 3 + 1] = (uint8_t) (((palette[i] >> 2) & 7) * 255 / 7);
+        rgb[i * 3 + 2] = (uint8_t) ((palette[i] & 3) * 255 / 3);
+    }
+}
+
+static void write_u32_be(uint8_t* buffer, uint32_t value) {
+    buffer[0] = (uint8_t) (value >> 24);
+    buffer[1] = (uint8_t) (value >> 16);
+    buffer[2] = (uint8_t) (value >> 8);
+    buffer[3] = (uint8_t) value;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) { value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1; }
+            table[i] = value;
+        }
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) { crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8); }
+    return ~crc;
+}
+
+static int write_png_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t size) {
+    uint8_t header[8];
+    write_u32_be(header, size);
+    memcpy(header + 4, type, 4);
+
+    uint8_t footer[4];
+    write_u32_be(footer, crc32(crc32(0, header + 4, 4), data, size));
+
+    return (fwrite(header, 1, 8, file) == 8 && fwrite(data, 1, size, file) == size && fwrite(footer, 1, 4, file) == 4) ? 0 : -1;
+}
+
+// a 2 bit palette png, the pixel data goes into zlib stored blocks since it is tiny anyway
+int image_write_png(const Image* image, const uint8_t* palette, const char* file_name) {
+    uint32_t row_size = 1 + (image->width + 3) / 4;
+    uint32_t raw_size = row_size * image->height;
+    uint32_t block_count = (raw_size + 65534) / 65535;
+    uint32_t zlib_size = 2 + block_count * 5 + raw_size + 4;
+
+    uint8_t* raw = calloc(1, raw_size);
+    uint8_t* zlib = malloc(zlib_size);
+    if (!raw || !zlib) {
+        printf("ERROR: Failed to allocate png!\n");
+        free(raw);
+        free(zlib);
+        return -1;
+    }
+
+    // every row starts with filter type 0 (none)
+    for (uint32_t y = 0; y < image->height; y++) {
+        for (uint32_t x = 0; x < image->width; x++) {
+            raw[y * row_size + 1 + x / 4] |= (uint8_t) (image->pixels[y * image->width + x] << (6 - (x % 4) * 2));
+        }
+    }
+
+    uint32_t size = 0;
+    zlib[size++] = 0x78;
+    zlib[size++] = 0x01;
+    for (uint32_t offset = 0; offset < raw_size; offset += 65535) {
+        uint32_t block_size = (raw_size - offset < 65535) ? raw_size - offset : 65535;
+        zlib[size++] = (offset + block_size == raw_size) ? 1 : 0;
+        zlib[size++] = (uint8_t) block_size;
+        zlib[size++] = (uint8_t) (block_size >> 8);
+        zlib[size++] = (uint8_t) ~block_size;
+        zlib[size++] = (uint8_t) (~block_size >> 8);
+        memcpy(zlib + size, raw + offset, block_size);
+        size += block_size;
+    }
+
+    uint32_t a = 1, b = 0;
+    for (uint32_t i = 0; i < raw_size; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    write_u32_be(zlib + size, (b << 16) | a);
+    size += 4;
+
+    uint8_t header[13];
+    write_u32_be(header, image->width);
+    write_u32_be(header + 4, image->height);
+    header[8] = 2;  // bit depth
+    header[9] = 3;  // palette
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // not interlaced
+
+    FILE* file = fopen(file_name, "wb");
+    int result = -1;
+    if (file) {
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        if (fwrite(signature, 1, 8, file) == 8 && write_png_chunk(file, "IHDR", header, 13) == 0 &&
+            write_png_chunk(file, "PLTE", palette, 12) == 0 &&
+            write_png_chunk(file, "IDAT", zlib, size) == 0 && write_png_chunk(file, "IEND", NULL, 0) == 0) {
+            result = 0;
+        }
+        if (fclose(file) != 0) { result = -1; }
+    }
+    if (result != 0) { printf("ERROR: Failed to write png file!\n"); }
+
+    free(raw);
+    free(zlib);
+    return result;
+}
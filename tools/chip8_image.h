@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * palette images of the display shared by the tools, one byte per pixel with up to 4 colors,
+ * written as 2 bit palette pngs
+*/
+
+typedef struct Image {
+    uint32_t width;
+    uint32_t height;
+    uint8_t* pixels; // one byte per pixel, an index into the palette
+} Image;
+
+// draws the display scaled up to fill the whole image, the pixels are the index into CHIP8_DISPLAY_PALETTE
+void image_draw_display(const Chip8Display* display, Image* image);
+
+// CHIP8_DISPLAY_PALETTE as 4 8 bit red, green and blue triples
+void image_display_palette(uint8_t* rgb);
+
+// `palette` is 4 red, green and blue triples
+int image_write_png(const Image* image, const uint8_t* palette, const char* file_name);
@@ -0,0 +1,480 @@
+/*
+ * chip8-run: runs a rom headlessly as fast as the host allows
+ *
+ * usage: chip8-run <rom | --restore FILE> [--instructions N | --frames N] [--seed N] [--engine NAME] [--verify] [--trace FILE]
+ *                  [--snapshot FILE] [--replay FILE] [--clock N] [--timing NAME] [--no-skip-idle]
+ *                  [--profile FILE] [--profile-stacks FILE] [--rom-db FILE] [--quirks NAME] [--video FILE]
+ *                  [--instances N [--threads N] [--chunk N] [--batch] [--per-instance]]
+ *
+ * --engine picks the execution engine (switch, cached or jit), see chip8_engine.h
+ * --clock sets the instructions per emulated second and --timing picks fixed or cosmac frames, see chip8_clock.h,
+ * --quirks picks how the instructions the chip8 variants disagree on behave (default, cosmac, chip48, schip
+ * or xochip, see chip8.h), the cached and jit engines run the switch interpreter for anything but default
+ * --rom-db looks the rom up in a database of per rom settings (see chip8_rom.h) for the ones not given
+ * --no-skip-idle runs every instruction of loops that only wait for the timers or keypad instead of skipping them
+ * --verify runs the jit against the switch interpreter and fails at the first difference
+ *
+ * --instances runs that many copies of the rom on a work stealing pool (see chip8_pool.h),
+ * each seeded with seed + index, --threads defaults to one per core and --chunk is the
+ * number of frames a worker runs before an instance goes back into its queue
+ *
+ * --batch runs the instances on one thread in groups of CHIP8_BATCH_LANES with the
+ * lockstep vector interpreter (see chip8_batch.h), --verify checks every lane against chip8_update
+ *
+ * --restore starts from a snapshot (see chip8_snapshot.h) instead of a rom, including its random state,
+ * --snapshot saves the state at the end of the run
+ *
+ * --replay feeds a recording made with the frontend's --record back into the rom it was
+ * recorded on (see chip8_recording.h), for as many instructions as were recorded, and fails
+ * at the first display hash checkpoint that does not match
+ *
+ * --profile writes a JSON report of how often every instruction handler and address ran, the
+ * subroutine call tree and the host time per frame, --profile-stacks the same call tree as
+ * collapsed stacks for flamegraph tools (see chip8_profile.h), both run the switch interpreter
+ *
+ * --video records every frame that changed the display (see chip8_video.h), chip8-video turns it into images
+ *
+ * --trace needs the core to be built with CHIP8_ENABLE_TRACE, it saves the
+ * last instructions run which chip8-trace can turn back into text
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "chip8_trace.h"
+#include "chip8_engine.h"
+#include "chip8_pool.h"
+#include "chip8_batch.h"
+#include "chip8_snapshot.h"
+#include "chip8_recording.h"
+#include "chip8_clock.h"
+#include "chip8_profile.h"
+#include "chip8_rom.h"
+#include "chip8_video.h"
+
+// how many instructions a trace keeps
+#define TRACE_CAPACITY (1 << 20)
+
+// frames a pool worker runs before putting an instance back
+#define DEFAULT_CHUNK_FRAMES 60
+
+static double get_time_seconds() {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+static void print_usage() {
+    printf("usage: chip8-run <rom | --restore FILE> [--instructions N | --frames N] [--seed N] [--engine NAME] [--verify] [--trace FILE]\n");
+    printf("                 [--snapshot FILE] [--replay FILE] [--clock N] [--timing NAME] [--no-skip-idle]\n");
+    printf("                 [--profile FILE] [--profile-stacks FILE] [--rom-db FILE] [--quirks NAME] [--video FILE]\n");
+    printf("                 [--instances N [--threads N] [--chunk N] [--batch] [--per-instance]]\n");
+}
+
+static int run_pool(const Chip8* chip8, Chip8EngineType engine_type, uint64_t seed, uint64_t frames,
+                    uint32_t instance_count, uint32_t thread_count, uint64_t chunk_frames, int per_instance, int skip_idle) {
+    Chip8Pool* pool = chip8_pool_create(instance_count, thread_count, engine_type);
+    if (!pool) { return -3; }
+
+    for (uint32_t i = 0; i < instance_count; i++) {
+        chip8_pool_get(pool, i)->engine->skip_idle = (uint8_t) skip_idle;
+    }
+
+    chip8_pool_load(pool, chip8, seed);
+    double elapsed = chip8_pool_run(pool, frames, chunk_frames);
+
+    uint64_t instructions = 0;
+    uint64_t idle_instructions = 0;
+    double busy_seconds = 0.0;
+    for (uint32_t i = 0; i < instance_count; i++) {
+        Chip8PoolInstance* instance = chip8_pool_get(pool, i);
+        instructions += instance->instructions;
+        idle_instructions += instance->engine->idle_instructions;
+        busy_seconds += instance->seconds;
+
+        if (per_instance) {
+            printf("instance %u: %.0f instructions/sec, display hash %016llx\n", i,
+                   (instance->seconds > 0.0) ? (double) instance->instructions / instance->seconds : 0.0,
+                   (unsigned long long) chip8_display_hash(&instance->chip8));
+        }
+    }
+
+    printf("engine: %s\n", chip8_engine_name(engine_type));
+    printf("instances: %u\n", instance_count);
+    printf("threads: %u\n", chip8_pool_thread_count(pool));
+    printf("instructions: %llu\n", (unsigned long long) instructions);
+    printf("seconds: %.6f\n", elapsed);
+    printf("instructions/sec: %.0f\n", (elapsed > 0.0) ? (double) instructions / elapsed : 0.0);
+    printf("instructions/sec per instance: %.0f\n", (busy_seconds > 0.0) ? (double) instructions / busy_seconds : 0.0);
+    printf("idle instructions skipped: %llu\n", (unsigned long long) idle_instructions);
+
+    chip8_pool_destroy(pool);
+
+    return 0;
+}
+
+static int run_batches(const Chip8* chip8, uint64_t seed, uint64_t frames, uint32_t instance_count, int verify, int per_instance) {
+    Chip8BatchStats stats = {0};
+    double elapsed = 0.0;
+
+    for (uint32_t first = 0; first < instance_count; first += CHIP8_BATCH_LANES) {
+        uint32_t lanes = (instance_count - first < CHIP8_BATCH_LANES) ? instance_count - first : CHIP8_BATCH_LANES;
+
+        // a fresh batch every group, unused lanes stay unloaded
+        Chip8Batch* batch = chip8_batch_create();
+        if (!batch) { return -3; }
+
+        Chip8 lane_chip8 = *chip8;
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            chip8_seed(&lane_chip8, seed + first + lane);
+            chip8_batch_set(batch, lane, &lane_chip8);
+        }
+
+        double start_time = get_time_seconds();
+        for (uint64_t i = 0; i < frames; i++) {
+            if (verify) {
+                if (chip8_batch_verify(batch, CHIP8_INSTRUCTIONS_PER_FRAME) != 0) { return -5; }
+                chip8_batch_update_timers(batch);
+            } else {
+                chip8_batch_run_frame(batch);
+            }
+        }
+        elapsed += get_time_seconds() - start_time;
+
+        Chip8BatchStats batch_stats = chip8_batch_stats(batch);
+        stats.vector_steps += batch_stats.vector_steps;
+        stats.vector_instructions += batch_stats.vector_instructions;
+        stats.scalar_instructions += batch_stats.scalar_instructions;
+
+        if (per_instance) {
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                chip8_batch_get(batch, lane, &lane_chip8);
+                printf("instance %u: display hash %016llx\n", first + lane, (unsigned long long) chip8_display_hash(&lane_chip8));
+            }
+        }
+
+        chip8_batch_destroy(batch);
+    }
+
+    uint64_t instructions = stats.vector_instructions + stats.scalar_instructions;
+
+    printf("engine: batch\n");
+    printf("instances: %u\n", instance_count);
+    printf("instructions: %llu\n", (unsigned long long) instructions);
+    printf("seconds: %.6f\n", elapsed);
+    printf("instructions/sec: %.0f\n", (elapsed > 0.0) ? (double) instructions / elapsed : 0.0);
+    printf("lanes per vector step: %.2f\n", stats.vector_steps ? (double) stats.vector_instructions / (double) stats.vector_steps : 0.0);
+    printf("scalar instructions: %.2f%%\n", instructions ? 100.0 * (double) stats.scalar_instructions / (double) instructions : 0.0);
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage();
+        return -1;
+    }
+
+    const char* rom = NULL;
+    uint64_t instructions = 0;
+    uint64_t frames = 0;
+    uint64_t seed = 0;
+    const char* trace_file = NULL;
+    const char* restore_file = NULL;
+    const char* snapshot_file = NULL;
+    const char* replay_file = NULL;
+    const char* profile_file = NULL;
+    const char* stacks_file = NULL;
+    const char* database_file = NULL;
+    const char* video_file = NULL;
+    Chip8EngineType engine_type = CHIP8_ENGINE_SWITCH;
+    uint32_t clock_rate = 0;
+    Chip8Timing timing = CHIP8_TIMING_FIXED;
+    int timing_set = 0;
+    Chip8Quirks quirks = CHIP8_QUIRKS_DEFAULT;
+    int quirks_set = 0;
+    int verify = 0;
+    uint32_t instance_count = 0;
+    uint32_t thread_count = 0;
+    uint64_t chunk_frames = DEFAULT_CHUNK_FRAMES;
+    int per_instance = 0;
+    int batch = 0;
+    int skip_idle = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--instructions") == 0 && i + 1 < argc) {
+            instructions = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            if (chip8_engine_parse(argv[++i], &engine_type) != 0) {
+                printf("ERROR: Unknown engine \"%s\"!\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc) {
+            clock_rate = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc) {
+            if (chip8_timing_parse(argv[++i], &timing) != 0) {
+                printf("ERROR: Unknown timing \"%s\"!\n", argv[i]);
+                return -1;
+            }
+            timing_set = 1;
+        } else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            if (chip8_quirks_parse(argv[++i], &quirks) != 0) {
+                printf("ERROR: Unknown quirks \"%s\"!\n", argv[i]);
+                return -1;
+            }
+            quirks_set = 1;
+        } else if (strcmp(argv[i], "--rom-db") == 0 && i + 1 < argc) {
+            database_file = argv[++i];
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            video_file = argv[++i];
+        } else if (strcmp(argv[i], "--no-skip-idle") == 0) {
+            skip_idle = 0;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        } else if (strcmp(argv[i], "--profile-stacks") == 0 && i + 1 < argc) {
+            stacks_file = argv[++i];
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_file = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot_file = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instance_count = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunk_frames = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "--per-instance") == 0) {
+            per_instance = 1;
+        } else if (argv[i][0] == '-') {
+            print_usage();
+            return -1;
+        } else {
+            rom = argv[i];
+        }
+    }
+
+    if ((!rom == !restore_file) || (instructions && frames)) {
+        print_usage();
+        return -1;
+    }
+
+    if (batch && !instance_count) {
+        printf("ERROR: --batch needs --instances!\n");
+        return -1;
+    }
+
+    if (verify && !batch && engine_type != CHIP8_ENGINE_JIT) {
+        printf("ERROR: --verify only works with the jit engine!\n");
+        return -1;
+    }
+
+    if ((clock_rate || timing != CHIP8_TIMING_FIXED) && (instance_count || verify || replay_file)) {
+        printf("ERROR: --clock and --timing only work on a single instance, replays use the recorded clock!\n");
+        return -1;
+    }
+
+    if (quirks_set && replay_file) {
+        printf("ERROR: Replays use the recorded quirks!\n");
+        return -1;
+    }
+
+    if (replay_file && (restore_file || instructions || frames || instance_count || verify)) {
+        printf("ERROR: --replay runs for as long as the recording and only on a rom!\n");
+        return -1;
+    }
+
+    if (instance_count && ((verify && !batch) || trace_file || snapshot_file || instructions)) {
+        printf("ERROR: --instances only works with --frames!\n");
+        return -1;
+    }
+
+    if ((profile_file || stacks_file) && (instance_count || verify)) {
+        printf("ERROR: --profile only works on a single instance without --verify!\n");
+        return -1;
+    }
+
+    if (video_file && (instance_count || verify || replay_file)) {
+        printf("ERROR: --video only works on a single instance without --verify or --replay!\n");
+        return -1;
+    }
+
+    Chip8Recording* recording = NULL;
+    if (replay_file) {
+        recording = chip8_recording_load(replay_file);
+        if (!recording) { return -2; }
+
+        instructions = recording->length;
+    }
+
+    // default to one emulated minute
+    if (!instructions && !frames) { frames = 60 * 60; }
+
+    // a frame budget is just an instruction budget with the timers ticking every frame
+    if (frames) { instructions = frames * CHIP8_INSTRUCTIONS_PER_FRAME; }
+
+    Chip8 chip8 = chip8_create();
+    chip8_seed(&chip8, seed);
+    chip8.quirks = quirks;
+
+#ifdef CHIP8_TRACE
+    if (trace_file) {
+        chip8.trace = chip8_trace_create(TRACE_CAPACITY);
+        if (!chip8.trace) { return -3; }
+    }
+#else
+    if (trace_file) {
+        printf("ERROR: Tracing needs the core to be built with CHIP8_ENABLE_TRACE!\n");
+        return -3;
+    }
+#endif
+
+    if (profile_file || stacks_file) {
+        chip8.profile = chip8_profile_create();
+        if (!chip8.profile) { return -3; }
+    }
+
+    if (recording) {
+        if (chip8_replay_start(recording, &chip8, rom) != 0) { return -2; }
+    } else if (restore_file) {
+        if (chip8_snapshot_load(&chip8, restore_file) != 0) { return -2; }
+    } else {
+        Chip8Rom rom_data;
+        if (chip8_rom_read(&rom_data, rom) != 0 || chip8_rom_load(&chip8, &rom_data) != 0) { return -2; }
+
+        // the database only fills in what the command line left out, and only single runs have a clock
+        if (database_file) {
+            Chip8RomDatabase* database = chip8_rom_database_load(database_file);
+            if (!database) { return -2; }
+
+            const Chip8RomProfile* profile = chip8_rom_database_find(database, rom_data.hash);
+            if (profile) {
+                printf("rom: %s\n", profile->name[0] ? profile->name : "(unnamed)");
+
+                Chip8Timing profile_timing = timing;
+                uint32_t profile_rate = clock_rate;
+                Chip8Quirks profile_quirks = quirks;
+                chip8_rom_profile_apply(profile, &profile_timing, &profile_rate, &profile_quirks);
+                if (!timing_set) { timing = profile_timing; }
+                if (!clock_rate) { clock_rate = profile_rate; }
+                if (!quirks_set) { chip8.quirks = profile_quirks; }
+            }
+
+            chip8_rom_database_destroy(database);
+        }
+    }
+    if (!chip8.program_loaded) { return -2; }
+
+    // the batch lanes and the jit only know the default quirks
+    if (chip8.quirks != CHIP8_QUIRKS_DEFAULT && (batch || verify)) {
+        printf("ERROR: --batch and --verify only work with the default quirks!\n");
+        return -1;
+    }
+
+    if (batch) {
+        return run_batches(&chip8, seed, frames, instance_count, verify, per_instance);
+    }
+
+    if (instance_count) {
+        return run_pool(&chip8, engine_type, seed, frames, instance_count, thread_count, chunk_frames, per_instance, skip_idle);
+    }
+
+    Chip8Engine* engine = chip8_engine_create(engine_type);
+    if (!engine) { return -3; }
+    engine->skip_idle = (uint8_t) skip_idle;
+
+    double start_time = get_time_seconds();
+
+    uint64_t full_frames = instructions / CHIP8_INSTRUCTIONS_PER_FRAME;
+    if (recording) {
+        if (chip8_replay_run(recording, &chip8, engine) != 0) { return -5; }
+        chip8_recording_destroy(recording);
+    } else if (verify) {
+        for (uint64_t i = 0; i < full_frames; i++) {
+            if (chip8_jit_verify(engine->jit, &chip8, CHIP8_INSTRUCTIONS_PER_FRAME) != 0) { return -5; }
+            chip8_update_timers(&chip8);
+        }
+
+        if (chip8_jit_verify(engine->jit, &chip8, instructions % CHIP8_INSTRUCTIONS_PER_FRAME) != 0) { return -5; }
+    } else {
+        Chip8Clock clock = chip8_clock_create(timing, clock_rate);
+
+        // the video starts with the display as it was loaded
+        Chip8VideoWriter* video = NULL;
+        int first_row, row_count;
+        if (video_file) {
+            video = chip8_video_writer_create(video_file, 1);
+            if (!video) { return -4; }
+
+            chip8_display_take_dirty(&chip8, &first_row, &row_count);
+            chip8_video_writer_add(video, &chip8.display, 0);
+        }
+
+        // how many instructions a frame gets depends on the clock, with a profile every frame is timed
+        uint64_t run = 0;
+        uint64_t frames_run = 0;
+        for (uint64_t i = 0; frames ? i < frames : run < instructions; i++) {
+            double frame_start = chip8.profile ? get_time_seconds() : 0.0;
+
+            run += chip8_clock_run(&clock, engine, &chip8, frames ? UINT64_MAX : instructions - run);
+            if (clock.in_frame) { continue; }
+            frames_run++;
+
+            if (chip8.profile) { chip8_profile_add_frame(chip8.profile, get_time_seconds() - frame_start); }
+            if (video && chip8_display_take_dirty(&chip8, &first_row, &row_count)) { chip8_video_writer_add(video, &chip8.display, frames_run); }
+        }
+        instructions = run;
+
+        if (video) {
+            printf("video frames: %llu (%llu dropped)\n", (unsigned long long) chip8_video_writer_frames(video),
+                   (unsigned long long) chip8_video_writer_dropped(video));
+            if (chip8_video_writer_finish(video) != 0) { return -4; }
+        }
+    }
+
+    double elapsed = get_time_seconds() - start_time;
+
+    printf("engine: %s\n", chip8_engine_name(engine_type));
+    if (!replay_file && !verify) { printf("timing: %s\n", chip8_timing_name(timing)); }
+    printf("quirks: %s\n", chip8_quirks_name((Chip8Quirks) chip8.quirks));
+    printf("instructions: %llu\n", (unsigned long long) instructions);
+    printf("seconds: %.6f\n", elapsed);
+    printf("instructions/sec: %.0f\n", (elapsed > 0.0) ? (double) instructions / elapsed : 0.0);
+    printf("idle instructions skipped: %llu\n", (unsigned long long) engine->idle_instructions);
+    printf("display hash: %016llx\n", (unsigned long long) chip8_display_hash(&chip8));
+
+    chip8_engine_destroy(engine);
+
+    if (snapshot_file && chip8_snapshot_save(&chip8, snapshot_file) != 0) { return -4; }
+
+    if (chip8.profile) {
+        if (profile_file && chip8_profile_save_json(chip8.profile, &chip8, profile_file) != 0) { return -4; }
+        if (stacks_file && chip8_profile_save_stacks(chip8.profile, stacks_file) != 0) { return -4; }
+        chip8_profile_destroy(chip8.profile);
+    }
+
+#ifdef CHIP8_TRACE
+    if (chip8.trace) {
+        if (chip8_trace_save(chip8.trace, trace_file) != 0) { return -4; }
+        chip8_trace_destroy(chip8.trace);
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * chip8-trace: turns a binary trace written by chip8-run --trace into text
+ *
+ * usage: chip8-trace <trace> [--state]
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8_trace.h"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("usage: chip8-trace <trace> [--state]\n");
+        return -1;
+    }
+
+    // also print the register written and I after each instruction
+    int show_state = (argc > 2 && strcmp(argv[2], "--state") == 0);
+
+    Chip8Trace* trace = chip8_trace_load(argv[1]);
+    if (!trace) { return -2; }
+
+    char line[64];
+    for (uint32_t i = 0; i < chip8_trace_size(trace); i++) {
+        const Chip8TraceRecord* record = chip8_trace_get(trace, i);
+        chip8_trace_format(record, line, sizeof(line));
+
+        if (show_state && record->changed_register != CHIP8_TRACE_NO_REGISTER) {
+            printf("%-24s V%X=%02X I=%03X\n", line, record->changed_register, record->value, record->address_register);
+        } else if (show_state) {
+            printf("%-24s      I=%03X\n", line, record->address_register);
+        } else {
+            printf("%s\n", line);
+        }
+    }
+
+    chip8_trace_destroy(trace);
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * chip8-video: turns a video recorded with --video into png images or an animated gif
+ *
+ * usage: chip8-video <video> [--png PREFIX] [--gif FILE] [--scale N]
+ *
+ * --png writes one image per recorded frame, named PREFIX followed by the frame number,
+ * --gif writes all of them as one animation with the recorded timing, --scale makes every
+ * chip8 pixel N by N pixels (8 by default), without either it only prints what the video holds
+ *
+ * the images are as big as the largest mode the video uses, so a low resolution frame in a
+ * video that also has high resolution ones has its pixels doubled
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "chip8_video.h"
+#include "chip8_image.h"
+
+#define DEFAULT_SCALE 8
+
+// how long the last frame of a gif stays up, in hundredths of a second
+#define GIF_LAST_FRAME_DELAY 100
+
+// gif lzw codes are packed lowest bit first and written in sub-blocks of up to 255 bytes
+typedef struct GifWriter {
+    FILE* file;
+    uint32_t bits;
+    int bit_count;
+    uint8_t block[255];
+    int block_size;
+} GifWriter;
+
+static void gif_flush_block(GifWriter* gif) {
+    if (gif->block_size == 0) { return; }
+
+    fputc(gif->block_size, gif->file);
+    fwrite(gif->block, 1, (size_t) gif->block_size, gif->file);
+    gif->block_size = 0;
+}
+
+static void gif_write_code(GifWriter* gif, uint32_t code, int code_size) {
+    gif->bits |= code << gif->bit_count;
+    gif->bit_count += code_size;
+
+    while (gif->bit_count >= 8) {
+        gif->block[gif->block_size++] = (uint8_t) gif->bits;
+        gif->bits >>= 8;
+        gif->bit_count -= 8;
+        if (gif->block_size == 255) { gif_flush_block(gif); }
+    }
+}
+
+#define LZW_MAX_CODE 4095
+#define LZW_HASH_SIZE 8191
+
+// plain gif lzw with 2 bit pixels, the way giflib grows the code size and clears a full table
+static void gif_write_pixels(GifWriter* gif, const uint8_t* pixels, uint32_t count) {
+    static int32_t keys[LZW_HASH_SIZE];
+    static uint16_t codes[LZW_HASH_SIZE];
+
+    const int minimum_code_size = 2;
+    const uint32_t clear_code = 1u << minimum_code_size;
+    const uint32_t end_code = clear_code + 1;
+
+    fputc(minimum_code_size, gif->file);
+    gif->bits = 0;
+    gif->bit_count = 0;
+    gif->block_size = 0;
+
+    int code_size = minimum_code_size + 1;
+    uint32_t next_code = end_code + 1;
+    memset(keys, 0xFF, sizeof(keys));
+
+    gif_write_code(gif, clear_code, code_size);
+
+    uint32_t prefix = pixels[0];
+    for (uint32_t i = 1; i < count; i++) {
+        int32_t key = (int32_t) ((prefix << 8) | pixels[i]);
+
+        uint32_t slot = (uint32_t) key % LZW_HASH_SIZE;
+        while (keys[slot] != -1 && keys[slot] != key) { slot = (slot + 1) % LZW_HASH_SIZE; }
+        if (keys[slot] == key) {
+            prefix = codes[slot];
+            continue;
+        }
+
+        gif_write_code(gif, prefix, code_size);
+        if (next_code >= (1u << code_size) && code_size < 12) { code_size++; }
+
+        if (next_code >= LZW_MAX_CODE) {
+            gif_write_code(gif, clear_code, code_size);
+            code_size = minimum_code_size + 1;
+            next_code = end_code + 1;
+            memset(keys, 0xFF, sizeof(keys));
+        } else {
+            keys[slot] = key;
+            codes[slot] = (uint16_t) next_code++;
+        }
+
+        prefix = pixels[i];
+    }
+
+    gif_write_code(gif, prefix, code_size);
+    if (next_code >= (1u << code_size) && code_size < 12) { code_size++; }
+    gif_write_code(gif, end_code, code_size);
+    if (gif->bit_count > 0) { gif_write_code(gif, 0, 8 - gif->bit_count); }
+    gif_flush_block(gif);
+
+    fputc(0, gif->file);
+}
+
+static void gif_write_u16(FILE* file, uint32_t value) {
+    fputc((int) (value & 0xFF), file);
+    fputc((int) ((value >> 8) & 0xFF), file);
+}
+
+static void gif_begin(GifWriter* gif, const Image* image) {
+    fwrite("GIF89a", 1, 6, gif->file);
+    gif_write_u16(gif->file, image->width);
+    gif_write_u16(gif->file, image->height);
+    fputc(0x81, gif->file); // a global color table of 4 entries, one per combination of the planes
+    fputc(0, gif->file);
+    fputc(0, gif->file);
+
+    uint8_t palette[12];
+    image_display_palette(palette);
+    fwrite(palette, 1, sizeof(palette), gif->file);
+
+    // loop forever
+    static const uint8_t loop[19] = {0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0};
+    fwrite(loop, 1, sizeof(loop), gif->file);
+}
+
+static void gif_add_frame(GifWriter* gif, const Image* image, uint32_t delay) {
+    static const uint8_t control[4] = {0x21, 0xF9, 4, 0};
+    fwrite(control, 1, sizeof(control), gif->file);
+    gif_write_u16(gif->file, delay);
+    fputc(0, gif->file);
+    fputc(0, gif->file);
+
+    fputc(0x2C, gif->file);
+    gif_write_u16(gif->file, 0);
+    gif_write_u16(gif->file, 0);
+    gif_write_u16(gif->file, image->width);
+    gif_write_u16(gif->file, image->height);
+    fputc(0, gif->file);
+
+    gif_write_pixels(gif, image->pixels, image->width * image->height);
+}
+
+// hundredths of a second from the start of the video to a frame, rounded so the delays add up exactly
+static uint64_t frame_centiseconds(uint64_t frame) {
+    return (frame * 100 + 30) / 60;
+}
+
+int main(int argc, char* argv[]) {
+    const char* video_file = NULL;
+    const char* png_prefix = NULL;
+    const char* gif_file = NULL;
+    uint32_t scale = DEFAULT_SCALE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--png") == 0 && i + 1 < argc) {
+            png_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--gif") == 0 && i + 1 < argc) {
+            gif_file = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] != '-' && !video_file) {
+            video_file = argv[i];
+        } else {
+            video_file = NULL;
+            break;
+        }
+    }
+
+    if (!video_file || scale == 0 || scale > 64) {
+        printf("usage: chip8-video <video> [--png PREFIX] [--gif FILE] [--scale N]\n");
+        return -1;
+    }
+
+    Chip8VideoReader* reader = chip8_video_reader_open(video_file);
+    if (!reader) { return -2; }
+
+    // a first pass finds the largest mode, so the gif has one size throughout
+    Chip8Display display;
+    uint64_t frame = 0;
+    int hires = 0;
+    while (!hires && chip8_video_reader_next(reader, &display, &frame) == 1) { hires = display.hires; }
+    chip8_video_reader_close(reader);
+
+    reader = chip8_video_reader_open(video_file);
+    if (!reader) { return -2; }
+
+    uint32_t width = hires ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH;
+    uint32_t height = hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+    Image image = {width * scale, height * scale, NULL};
+    image.pixels = malloc((size_t) image.width * image.height);
+    if (!image.pixels) {
+        printf("ERROR: Failed to allocate image!\n");
+        return -3;
+    }
+
+    uint8_t palette[12];
+    image_display_palette(palette);
+
+    GifWriter gif = {0};
+    if (gif_file) {
+        gif.file = fopen(gif_file, "wb");
+        if (!gif.file) {
+            printf("ERROR: Failed to open gif file!\n");
+            return -4;
+        }
+        gif_begin(&gif, &image);
+    }
+
+    // a gif frame's delay is only known once the next one is read, so every frame is written one behind
+    Chip8Display pending;
+    uint64_t pending_frame = 0;
+    uint64_t first_frame = 0;
+    uint64_t count = 0;
+
+    int result;
+    while ((result = chip8_video_reader_next(reader, &display, &frame)) == 1) {
+        if (count == 0) { first_frame = frame; }
+
+        if (gif_file && count > 0) {
+            image_draw_display(&pending, &image);
+            gif_add_frame(&gif, &image, (uint32_t) (frame_centiseconds(frame) - frame_centiseconds(pending_frame)));
+        }
+        pending = display;
+        pending_frame = frame;
+
+        if (png_prefix) {
+            char file_name[4096];
+            snprintf(file_name, sizeof(file_name), "%s%06llu.png", png_prefix, (unsigned long long) frame);
+            image_draw_display(&display, &image);
+            if (image_write_png(&image, palette, file_name) != 0) { return -4; }
+        }
+
+        count++;
+    }
+    if (result < 0) { printf("ERROR: Video file is damaged after %llu frames!\n", (unsigned long long) count); }
+
+    if (gif_file) {
+        if (count > 0) {
+            image_draw_display(&pending, &image);
+            gif_add_frame(&gif, &image, GIF_LAST_FRAME_DELAY);
+        }
+
+        fputc(0x3B, gif.file);
+        if (fclose(gif.file) != 0) {
+            printf("ERROR: Failed to write gif file!\n");
+            return -4;
+        }
+    }
+
+    printf("frames: %llu\n", (unsigned long long) count);
+    if (count > 0) {
+        printf("first frame: %llu\n", (unsigned long long) first_frame);
+        printf("last frame: %llu\n", (unsigned long long) pending_frame);
+        printf("seconds: %.2f\n", (double) (pending_frame - first_frame) / 60.0);
+    }
+
+    free(image.pixels);
+    chip8_video_reader_close(reader);
+
+    return (result < 0) ? -5 : 0;
+}